@@ -63,6 +63,50 @@ PRODUCT_PACKAGES += \
     android.hardware.keymaster@3.0-impl \
     android.hardware.keymaster@3.0-service
 
+# Gatekeeper enroll/verify benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.gatekeeper@1.0-benchmark.rockchip
+
+# Gatekeeper many-uid concurrency stress test
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.gatekeeper@1.0-stress-test.rockchip
+
+# Gatekeeper failure record crash injection test
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.gatekeeper@1.0-crash-test.rockchip
+
+# Voice pre-processing cost and ERLE benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.audio.effect@4.0-preprocessing-benchmark.rockchip
+
+# BiquadCascade bit-exactness and throughput benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.audio.effect@4.0-biquad-benchmark.rockchip
+
+# Power hint-to-sysfs latency benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.power@1.0-benchmark.rockchip
+
+# Power ThermalGovernor synthetic trace test
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.power@1.0-thermal-trace-test.rockchip
+
+# memtrack meminfo sweep benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.memtrack@1.0-benchmark.rockchip
+
+# Health getDiskStats benchmark
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.health@2.0-benchmark.rockchip
+
+# Health callback dispatcher stress test
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.health@2.0-callback-stress.rockchip
+
+# Health PollScheduler virtual-clock test
+PRODUCT_PACKAGES_DEBUG += \
+    android.hardware.health@2.0-poll-scheduler-test.rockchip
+
 # Copy software config file(s)
 PRODUCT_COPY_FILES += \
     frameworks/native/data/etc/android.software.cts.xml:$(TARGET_COPY_OUT_VENDOR)/etc/permissions/android.software.cts.xml \
@@ -106,6 +150,11 @@ PRODUCT_PACKAGES += \
     tinypcminfo \
     tinymix
 
+# Audio effects
+PRODUCT_PACKAGES += librockchip_effects
+PRODUCT_COPY_FILES += \
+    $(LOCAL_PATH)/hal/audioeffect/audio_effects.xml:$(TARGET_COPY_OUT_VENDOR)/etc/audio_effects.xml
+
 # Audio policy configuration
 USE_XML_AUDIO_POLICY_CONF := 1
 PRODUCT_COPY_FILES += \
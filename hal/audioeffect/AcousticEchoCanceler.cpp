@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <audio_effects/effect_aec.h>
+
+#include "AcousticEchoCanceler.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static constexpr float kS16ToFloat = 1.0f / 32768;
+
+AcousticEchoCanceler::AcousticEchoCanceler(const effect_descriptor_t& descriptor,
+                                           std::shared_ptr<VoiceProcessor> processor)
+    : PreProcessor(descriptor, VoiceProcessor::kEchoCanceller, std::move(processor), true),
+      echo_delay_us_(0),
+      reverse_config_(),
+      reverse_channels_(1),
+      reverse_float_(false)
+{
+    reverse_config_.inputCfg.samplingRate = 16000;
+    reverse_config_.inputCfg.channels = AUDIO_CHANNEL_OUT_MONO;
+    reverse_config_.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    reverse_config_.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    reverse_config_.inputCfg.mask = EFFECT_CONFIG_ALL;
+    reverse_config_.outputCfg = reverse_config_.inputCfg;
+    reverse_config_.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+}
+
+int AcousticEchoCanceler::GetParameter(const int32_t *param, uint32_t psize, void *value,
+                                       uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case AEC_PARAM_ECHO_DELAY:
+        return Write(value, vsize, echo_delay_us_);
+
+    case AEC_PARAM_PROPERTIES: {
+        t_aec_settings settings = {};
+        settings.echoDelay = echo_delay_us_;
+        return Write(value, vsize, settings);
+    }
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int AcousticEchoCanceler::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                                       uint32_t vsize)
+{
+    int32_t id;
+    t_aec_settings settings;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case AEC_PARAM_ECHO_DELAY:
+    case AEC_PARAM_PROPERTIES:
+        if (!Read(value, vsize, 0, &settings))
+            return -EINVAL;
+        echo_delay_us_ = std::min(settings.echoDelay, kMaxEchoDelayUs);
+        processor().SetEchoDelay(echo_delay_us_);
+        return 0;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int AcousticEchoCanceler::SetReverseConfig(const effect_config_t& config)
+{
+    const buffer_config_t& in = config.inputCfg;
+    size_t channels = audio_channel_count_from_out_mask(in.channels);
+
+    /* The processor takes the far end sample for sample against capture */
+    if (in.samplingRate != this->config().inputCfg.samplingRate || channels < 1 ||
+        channels > kMaxChannels ||
+        (in.format != AUDIO_FORMAT_PCM_16_BIT && in.format != AUDIO_FORMAT_PCM_FLOAT)) {
+        ALOGE("%s: unsupported reverse rate %u, channels %#x, format %#x", __func__,
+              in.samplingRate, in.channels, in.format);
+        return -EINVAL;
+    }
+
+    reverse_config_ = config;
+    reverse_channels_.store(channels, std::memory_order_relaxed);
+    reverse_float_.store(in.format == AUDIO_FORMAT_PCM_FLOAT, std::memory_order_relaxed);
+    return 0;
+}
+
+int AcousticEchoCanceler::ExtraCommand(uint32_t code, uint32_t size, void *data,
+                                       uint32_t *reply_size, void *reply)
+{
+    switch (code) {
+    case EFFECT_CMD_SET_CONFIG_REVERSE:
+        if (data == nullptr || size != sizeof(effect_config_t) || reply == nullptr ||
+            reply_size == nullptr || *reply_size != sizeof(int))
+            return -EINVAL;
+        *static_cast<int*>(reply) =
+                SetReverseConfig(*static_cast<const effect_config_t*>(data));
+        return 0;
+
+    case EFFECT_CMD_GET_CONFIG_REVERSE:
+        if (reply == nullptr || reply_size == nullptr || *reply_size != sizeof(effect_config_t))
+            return -EINVAL;
+        memcpy(reply, &reverse_config_, sizeof(reverse_config_));
+        return 0;
+
+    default:
+        return PreProcessor::ExtraCommand(code, size, data, reply_size, reply);
+    }
+}
+
+int AcousticEchoCanceler::ProcessReverse(audio_buffer_t *in, audio_buffer_t *)
+{
+    if (in == nullptr || in->raw == nullptr)
+        return -EINVAL;
+
+    const size_t channels = reverse_channels_.load(std::memory_order_relaxed);
+    const bool is_float = reverse_float_.load(std::memory_order_relaxed);
+    const float scale = (is_float ? 1.0f : kS16ToFloat) / channels;
+
+    for (size_t offset = 0; offset < in->frameCount; offset += kBlockFrames) {
+        size_t frames = std::min(in->frameCount - offset, kBlockFrames);
+        size_t base = offset * channels;
+
+        for (size_t i = 0; i < frames; i++) {
+            float sum = 0;
+            for (size_t c = 0; c < channels; c++)
+                sum += is_float ? in->f32[base + i * channels + c]
+                                : in->s16[base + i * channels + c];
+            reverse_[i] = sum * scale;
+        }
+        processor().PushReverse(reverse_, frames);
+    }
+
+    return 0;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "EchoCanceller.h"
+#include "PreProcessor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * android.media.audiofx.AcousticEchoCanceler. The far end, what the
+ * speakers play, must be fed through process_reverse() at the capture
+ * rate, mono or stereo; it is mixed down and queued for the processor.
+ * The echo delay is how much later than the far end the echo reaches
+ * the microphone beyond the buffering, and is searched from there
+ * over the filter length.
+ */
+class AcousticEchoCanceler : public PreProcessor
+{
+public:
+    static constexpr uint32_t kMaxEchoDelayUs = EchoCanceller::kMaxDelayFrames * 10000;
+
+    AcousticEchoCanceler(const effect_descriptor_t& descriptor,
+                         std::shared_ptr<VoiceProcessor> processor);
+
+    int ProcessReverse(audio_buffer_t *in, audio_buffer_t *out) override;
+
+protected:
+    int GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize) override;
+    int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                     uint32_t vsize) override;
+    int ExtraCommand(uint32_t code, uint32_t size, void *data, uint32_t *reply_size,
+                     void *reply) override;
+
+private:
+    int SetReverseConfig(const effect_config_t& config);
+
+    /* Control side */
+    uint32_t echo_delay_us_;
+    effect_config_t reverse_config_;
+
+    /* Read by the far-end thread */
+    std::atomic<uint32_t> reverse_channels_;
+    std::atomic<bool> reverse_float_;
+
+    /* Far-end thread */
+    float reverse_[kBlockFrames];
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
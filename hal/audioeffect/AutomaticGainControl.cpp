@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include <audio_effects/effect_agc.h>
+
+#include "AutomaticGainControl.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+AutomaticGainControl::AutomaticGainControl(const effect_descriptor_t& descriptor,
+                                           std::shared_ptr<VoiceProcessor> processor)
+    : PreProcessor(descriptor, VoiceProcessor::kGainController, std::move(processor)),
+      target_level_(-300),
+      comp_gain_(900),
+      limiter_(true)
+{
+    Apply();
+}
+
+void AutomaticGainControl::Apply()
+{
+    processor().SetGain(target_level_ / 100.0f, comp_gain_ / 100.0f, limiter_);
+}
+
+int AutomaticGainControl::GetParameter(const int32_t *param, uint32_t psize, void *value,
+                                       uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case AGC_PARAM_TARGET_LEVEL:
+        return Write(value, vsize, target_level_);
+
+    case AGC_PARAM_COMP_GAIN:
+        return Write(value, vsize, comp_gain_);
+
+    case AGC_PARAM_LIMITER_ENA:
+        return Write(value, vsize, limiter_);
+
+    case AGC_PARAM_PROPERTIES: {
+        t_agc_settings settings = {};
+        settings.targetLevel = target_level_;
+        settings.compGain = comp_gain_;
+        settings.limiterEnabled = limiter_;
+        return Write(value, vsize, settings);
+    }
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int AutomaticGainControl::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                                       uint32_t vsize)
+{
+    int32_t id;
+    t_agc_settings settings;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    settings.targetLevel = target_level_;
+    settings.compGain = comp_gain_;
+    settings.limiterEnabled = limiter_;
+
+    switch (id) {
+    case AGC_PARAM_TARGET_LEVEL:
+        if (!Read(value, vsize, 0, &settings.targetLevel))
+            return -EINVAL;
+        break;
+
+    case AGC_PARAM_COMP_GAIN:
+        if (!Read(value, vsize, 0, &settings.compGain))
+            return -EINVAL;
+        break;
+
+    case AGC_PARAM_LIMITER_ENA:
+        if (!Read(value, vsize, 0, &settings.limiterEnabled))
+            return -EINVAL;
+        break;
+
+    case AGC_PARAM_PROPERTIES:
+        if (!Read(value, vsize, 0, &settings))
+            return -EINVAL;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    target_level_ = std::min(std::max(settings.targetLevel, kMinTargetLevel), (int16_t)0);
+    comp_gain_ = std::min(std::max(settings.compGain, (int16_t)0), kMaxCompGain);
+    limiter_ = settings.limiterEnabled;
+    Apply();
+    return 0;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
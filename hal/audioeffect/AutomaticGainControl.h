@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "PreProcessor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * android.media.audiofx.AutomaticGainControl: brings speech peaks to
+ * the target level, in millibels below full scale, with at most the
+ * compression gain, and optionally limits what still clips.
+ */
+class AutomaticGainControl : public PreProcessor
+{
+public:
+    static constexpr int16_t kMinTargetLevel = -3100;
+    static constexpr int16_t kMaxCompGain = 9000;
+
+    AutomaticGainControl(const effect_descriptor_t& descriptor,
+                         std::shared_ptr<VoiceProcessor> processor);
+
+protected:
+    int GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize) override;
+    int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                     uint32_t vsize) override;
+
+private:
+    void Apply();
+
+    /* Control side */
+    int16_t target_level_;
+    int16_t comp_gain_;
+    bool limiter_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <audio_effects/effect_bassboost.h>
+
+#include "BassBoost.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static constexpr double kButterworthQ = M_SQRT1_2;
+
+BassBoost::BassBoost(const effect_descriptor_t& descriptor)
+    : Effect(descriptor),
+      strength_(0)
+{
+}
+
+int BassBoost::GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case BASSBOOST_PARAM_STRENGTH_SUPPORTED:
+        return Write(value, vsize, (uint32_t)1);
+
+    case BASSBOOST_PARAM_STRENGTH:
+        return Write(value, vsize, strength_);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int BassBoost::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                            uint32_t vsize)
+{
+    int32_t id;
+    int16_t strength;
+
+    if (!Read(param, psize, 0, &id) || id != BASSBOOST_PARAM_STRENGTH ||
+        !Read(value, vsize, 0, &strength))
+        return -EINVAL;
+
+    strength_ = std::min(std::max<int16_t>(strength, 0), kMaxStrength);
+    return 0;
+}
+
+void BassBoost::Commit(uint32_t sample_rate, size_t channels)
+{
+    BiquadCoefficients sections[2];
+    size_t count = 0;
+
+    if (strength_ > 0) {
+        sections[count++] = BiquadCoefficients::LowShelf(sample_rate, kShelfHz, kButterworthQ,
+                                                         kMaxBoostDb * strength_ / kMaxStrength);
+        sections[count++] = BiquadCoefficients::HighPass(sample_rate, kSubsonicHz, kButterworthQ);
+    }
+
+    cascade_.SetChannels(channels);
+    cascade_.SetSections(sections, count);
+}
+
+void BassBoost::Reset()
+{
+    cascade_.Reset();
+}
+
+bool BassBoost::IsActive() const
+{
+    return !cascade_.IsIdentity();
+}
+
+void BassBoost::ProcessPlanar(float * const *data, size_t frames)
+{
+    cascade_.Process(data, frames);
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "BiquadCascade.h"
+#include "Effect.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * android.media.audiofx.BassBoost: a low shelf at kShelfHz raised by up
+ * to kMaxBoostDb with the strength, behind a second-order high-pass at
+ * kSubsonicHz so the boost does not go into cone excursion the speakers
+ * cannot reproduce. Strength 0 is not processed.
+ */
+class BassBoost : public Effect
+{
+public:
+    static constexpr int16_t kMaxStrength = 1000;
+    static constexpr double kShelfHz = 110;
+    static constexpr double kSubsonicHz = 35;
+    static constexpr double kMaxBoostDb = 12;
+
+    explicit BassBoost(const effect_descriptor_t& descriptor);
+
+protected:
+    int GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize) override;
+    int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                     uint32_t vsize) override;
+
+    void Commit(uint32_t sample_rate, size_t channels) override;
+    void Reset() override;
+    bool IsActive() const override;
+    void ProcessPlanar(float * const *data, size_t frames) override;
+
+private:
+    int16_t strength_;                  /* control side */
+
+    BiquadCascade cascade_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
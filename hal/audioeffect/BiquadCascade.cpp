@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "BiquadCascade.h"
+#include "Vec4.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static constexpr BiquadCoefficients kIdentity = { 1, 0, 0, 0, 0 };
+
+static BiquadCoefficients Normalise(double b0, double b1, double b2, double a0, double a1,
+                                    double a2)
+{
+    return { (float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0),
+             (float)(a2 / a0) };
+}
+
+/* Keeps f0 clear of Nyquist for the low sample rates */
+static double Omega(double fs, double f0)
+{
+    return 2 * M_PI * std::min(f0, 0.45 * fs) / fs;
+}
+
+BiquadCoefficients BiquadCoefficients::Peaking(double fs, double f0, double q, double gain_db)
+{
+    if (gain_db == 0)
+        return kIdentity;
+
+    double A = pow(10, gain_db / 40);
+    double w0 = Omega(fs, f0);
+    double alpha = sin(w0) / (2 * q);
+
+    return Normalise(1 + alpha * A, -2 * cos(w0), 1 - alpha * A,
+                     1 + alpha / A, -2 * cos(w0), 1 - alpha / A);
+}
+
+BiquadCoefficients BiquadCoefficients::LowShelf(double fs, double f0, double q, double gain_db)
+{
+    if (gain_db == 0)
+        return kIdentity;
+
+    double A = pow(10, gain_db / 40);
+    double w0 = Omega(fs, f0);
+    double c = cos(w0);
+    double beta = 2 * sqrt(A) * sin(w0) / (2 * q);
+
+    return Normalise(A * ((A + 1) - (A - 1) * c + beta), 2 * A * ((A - 1) - (A + 1) * c),
+                     A * ((A + 1) - (A - 1) * c - beta),
+                     (A + 1) + (A - 1) * c + beta, -2 * ((A - 1) + (A + 1) * c),
+                     (A + 1) + (A - 1) * c - beta);
+}
+
+BiquadCoefficients BiquadCoefficients::HighShelf(double fs, double f0, double q, double gain_db)
+{
+    if (gain_db == 0)
+        return kIdentity;
+
+    double A = pow(10, gain_db / 40);
+    double w0 = Omega(fs, f0);
+    double c = cos(w0);
+    double beta = 2 * sqrt(A) * sin(w0) / (2 * q);
+
+    return Normalise(A * ((A + 1) + (A - 1) * c + beta), -2 * A * ((A - 1) + (A + 1) * c),
+                     A * ((A + 1) + (A - 1) * c - beta),
+                     (A + 1) - (A - 1) * c + beta, 2 * ((A - 1) - (A + 1) * c),
+                     (A + 1) - (A - 1) * c - beta);
+}
+
+BiquadCoefficients BiquadCoefficients::HighPass(double fs, double f0, double q)
+{
+    double w0 = Omega(fs, f0);
+    double c = cos(w0);
+    double alpha = sin(w0) / (2 * q);
+
+    return Normalise((1 + c) / 2, -(1 + c), (1 + c) / 2, 1 + alpha, -2 * c, 1 - alpha);
+}
+
+BiquadCascade::BiquadCascade()
+    : channels_(1),
+      groups_(0)
+{
+    Reset();
+}
+
+void BiquadCascade::SetChannels(size_t channels)
+{
+    channels = std::min(std::max<size_t>(channels, 1), kMaxChannels);
+    if (channels == channels_)
+        return;
+
+    channels_ = channels;
+    Reset();
+}
+
+void BiquadCascade::SetSections(const BiquadCoefficients *sections, size_t count)
+{
+    size_t used = 0;
+
+    for (size_t i = 0; i < count && used < kMaxSections; i++) {
+        if (sections[i].IsIdentity())
+            continue;
+
+        Group& group = group_[used / kLanes];
+        size_t lane = used % kLanes;
+        group.b0[lane] = sections[i].b0;
+        group.b1[lane] = sections[i].b1;
+        group.b2[lane] = sections[i].b2;
+        group.a1[lane] = sections[i].a1;
+        group.a2[lane] = sections[i].a2;
+        used++;
+    }
+
+    /* The last group is padded with pass-through lanes */
+    for (size_t i = used; i % kLanes; i++) {
+        Group& group = group_[i / kLanes];
+        size_t lane = i % kLanes;
+        group.b0[lane] = 1;
+        group.b1[lane] = group.b2[lane] = group.a1[lane] = group.a2[lane] = 0;
+    }
+
+    size_t groups = (used + kLanes - 1) / kLanes;
+    if (groups != groups_) {
+        groups_ = groups;
+        Reset();
+    }
+}
+
+void BiquadCascade::Reset()
+{
+    memset(state_, 0, sizeof(state_));
+}
+
+/* Section @k of @group on one sample; what every lane of the vector step does */
+static inline float Step(const float *b0, const float *b1, const float *b2, const float *a1,
+                         const float *a2, float *s1, float *s2, size_t k, float x)
+{
+    float y = b0[k] * x + s1[k];
+    s1[k] = (b1[k] * x + s2[k]) - a1[k] * y;
+    s2[k] = b2[k] * x - a2[k] * y;
+    return y;
+}
+
+#define STEP(group, state, k, x) \
+    Step((group).b0, (group).b1, (group).b2, (group).a1, (group).a2, (state).s1, (state).s2, k, x)
+
+void BiquadCascade::ProcessReference(float * const *data, size_t frames)
+{
+    for (size_t c = 0; c < channels_; c++) {
+        for (size_t g = 0; g < groups_; g++) {
+            for (size_t k = 0; k < kLanes; k++) {
+                for (size_t i = 0; i < frames; i++)
+                    data[c][i] = STEP(group_[g], state_[c][g], k, data[c][i]);
+            }
+        }
+    }
+}
+
+template <size_t kChannels, size_t kFrames>
+void BiquadCascade::Run(float * const *data, size_t frames)
+{
+    const size_t n = kFrames ? kFrames : frames;
+
+    if (n < kLanes) {
+        ProcessReference(data, n);
+        return;
+    }
+
+    for (size_t g = 0; g < groups_; g++) {
+        const Group& group = group_[g];
+        const vec4 b0 = Load(group.b0), b1 = Load(group.b1), b2 = Load(group.b2);
+        const vec4 a1 = Load(group.a1), a2 = Load(group.a2);
+        vec4 in[kChannels], s1[kChannels], s2[kChannels];
+
+        /* Fill: section k takes samples 0 .. 2 - k, leaving the next input of each lane */
+        for (size_t c = 0; c < kChannels; c++) {
+            State& state = state_[c][g];
+            alignas(16) float pending[kLanes];
+
+            for (size_t t = 0; t < kLanes - 1; t++) {
+                for (size_t k = t + 1; k-- > 0;)
+                    pending[k + 1] = STEP(group, state, k, k ? pending[k] : data[c][t]);
+            }
+            pending[0] = data[c][kLanes - 1];
+
+            in[c] = Load(pending);
+            s1[c] = Load(state.s1);
+            s2[c] = Load(state.s2);
+        }
+
+        /* Steady state: step t runs section k on sample t - k, lane 3 retires sample t - 3 */
+        for (size_t t = kLanes - 1; t < n - 1; t++) {
+            for (size_t c = 0; c < kChannels; c++) {
+                vec4 x = in[c];
+                vec4 y = Add(Mul(b0, x), s1[c]);
+                s1[c] = Sub(Add(Mul(b1, x), s2[c]), Mul(a1, y));
+                s2[c] = Sub(Mul(b2, x), Mul(a2, y));
+                data[c][t - (kLanes - 1)] = Last(y);
+                in[c] = ShiftIn(data[c][t + 1], y);
+            }
+        }
+
+        for (size_t c = 0; c < kChannels; c++) {
+            State& state = state_[c][g];
+            alignas(16) float out[kLanes];
+
+            vec4 x = in[c];
+            vec4 y = Add(Mul(b0, x), s1[c]);
+            Store(state.s1, Sub(Add(Mul(b1, x), s2[c]), Mul(a1, y)));
+            Store(state.s2, Sub(Mul(b2, x), Mul(a2, y)));
+            Store(out, y);
+            data[c][n - kLanes] = out[kLanes - 1];
+
+            /* Drain: section k still owes samples n - k .. n - 1 */
+            for (size_t d = 1; d < kLanes; d++) {
+                for (size_t k = kLanes - 1; k >= d; k--) {
+                    float v = STEP(group, state, k, out[k - 1]);
+                    if (k == kLanes - 1)
+                        data[c][n - kLanes + d] = v;
+                    else
+                        out[k] = v;
+                }
+            }
+        }
+    }
+}
+
+void BiquadCascade::Process(float * const *data, size_t frames)
+{
+    if (groups_ == 0)
+        return;
+
+    float *block[kMaxChannels];
+    for (size_t c = 0; c < channels_; c++)
+        block[c] = data[c];
+
+    for (; frames >= kBlockFrames; frames -= kBlockFrames) {
+        if (channels_ == 2)
+            Run<2, kBlockFrames>(block, kBlockFrames);
+        else
+            Run<1, kBlockFrames>(block, kBlockFrames);
+
+        for (size_t c = 0; c < channels_; c++)
+            block[c] += kBlockFrames;
+    }
+
+    if (frames == 0)
+        return;
+
+    if (channels_ == 2)
+        Run<2, 0>(block, frames);
+    else
+        Run<1, 0>(block, frames);
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* Normalised so that a0 == 1 */
+struct BiquadCoefficients {
+    float b0, b1, b2, a1, a2;
+
+    bool IsIdentity() const { return b0 == 1 && b1 == 0 && b2 == 0 && a1 == 0 && a2 == 0; }
+
+    /* RBJ Audio EQ Cookbook designs, @f0 in Hz */
+    static BiquadCoefficients Peaking(double fs, double f0, double q, double gain_db);
+    static BiquadCoefficients LowShelf(double fs, double f0, double q, double gain_db);
+    static BiquadCoefficients HighShelf(double fs, double f0, double q, double gain_db);
+    static BiquadCoefficients HighPass(double fs, double f0, double q);
+};
+
+/*
+ * Up to kMaxSections biquads in series on each of up to kMaxChannels
+ * planar float channels, transposed direct form II.
+ *
+ * A cascade is a strict chain, so the sections are run four at a time
+ * as a skewed pipeline instead: lane k of a vector holds section k, and
+ * at step t it filters sample t - k, which lane k - 1 produced at step
+ * t - 1. One vector step then advances all four sections, and the
+ * output of lane 0 shifted in from the next input becomes the next
+ * step's input. The three steps at each end of a block, where the
+ * pipeline fills and drains, run lane by lane. Channels are stepped
+ * together so that their dependency chains interleave.
+ *
+ * Every lane does exactly the scalar arithmetic of ProcessReference(),
+ * in the same order, and this file is built without FP contraction, so
+ * the two are bit-identical. Identity sections are dropped, and a
+ * cascade of none does nothing.
+ *
+ * Process() works in place on blocks of any length; kBlockFrames, the
+ * block size the effects feed it, has a loop with a constant trip count.
+ */
+class BiquadCascade
+{
+public:
+    static constexpr size_t kLanes = 4;
+    static constexpr size_t kMaxSections = 8;
+    static constexpr size_t kMaxChannels = 2;
+    static constexpr size_t kBlockFrames = 128;
+
+    BiquadCascade();
+
+    /* Resets the state if the count changes */
+    void SetChannels(size_t channels);
+
+    /*
+     * Replaces the sections. The state is kept when the number of
+     * vector groups does not change, so a slider moving does not click.
+     */
+    void SetSections(const BiquadCoefficients *sections, size_t count);
+
+    void Reset();
+
+    bool IsIdentity() const { return groups_ == 0; }
+
+    void Process(float * const *data, size_t frames);
+    void ProcessReference(float * const *data, size_t frames);
+
+private:
+    /* Four sections, one per lane */
+    struct Group {
+        alignas(16) float b0[kLanes];
+        alignas(16) float b1[kLanes];
+        alignas(16) float b2[kLanes];
+        alignas(16) float a1[kLanes];
+        alignas(16) float a2[kLanes];
+    };
+
+    struct State {
+        alignas(16) float s1[kLanes];
+        alignas(16) float s2[kLanes];
+    };
+
+    template <size_t kChannels, size_t kFrames>
+    void Run(float * const *data, size_t frames);
+
+    size_t channels_;
+    size_t groups_;
+    Group group_[kMaxSections / kLanes];
+    State state_[kMaxChannels][kMaxSections / kLanes];
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "EchoCanceller.h"
+#include "Vec4.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* NLMS step size */
+static constexpr float kStep = 1.0f;
+
+/* Largest error used for an update, as a power relative to one partition of far end */
+static constexpr float kErrorClip = 16;
+
+/*
+ * Once the far end has been active this many frames the step follows
+ * how much of the error the residual echo explains, which slows
+ * adaptation in double talk. Until then it is fixed, so the filter can
+ * start from nothing.
+ */
+static constexpr unsigned kStartupFrames = 50;
+static constexpr float kStepMargin = 2;
+
+/* Frames in a row with more error than near end before the filter is dropped */
+static constexpr unsigned kDivergedFrames = 25;
+
+/* How far above the floor the far end must be for the leakage to follow it */
+static constexpr float kFarActive = 10;
+
+/* Residual echo suppression */
+static constexpr float kInitialLeakage = 1;
+static constexpr float kMinLeakage = 0.003f;
+static constexpr float kLeakageFall = 0.3f;
+static constexpr float kLeakageRise = 0.002f;
+static constexpr float kTailDecay = 0.6f;
+static constexpr float kOverSuppression = 2;
+static constexpr float kMinGain = 0.03f;
+
+EchoCanceller::EchoCanceller()
+    : frame_(0),
+      bins_(0),
+      padded_(0),
+      far_floor_(0),
+      delay_(0),
+      fft_bins_(0),
+      fft_padded_(0)
+{
+    Reset();
+}
+
+void EchoCanceller::Configure(size_t frame, size_t bins, float far_floor)
+{
+    frame_ = std::min(frame, kMaxFrame);
+    bins_ = std::min(bins, Fft::kMaxBins);
+    padded_ = (bins_ + 3) & ~3;
+    far_floor_ = far_floor;
+
+    size_t size = Fft::kMinSize;
+    while (size < 2 * frame_)
+        size *= 2;
+    fft_.Configure(size);
+    fft_bins_ = fft_.bins();
+    fft_padded_ = (fft_bins_ + 3) & ~3;
+
+    Reset();
+}
+
+void EchoCanceller::Reset()
+{
+    memset(far_time_, 0, sizeof(far_time_));
+    head_ = 0;
+    memset(far_re_, 0, sizeof(far_re_));
+    memset(far_im_, 0, sizeof(far_im_));
+    memset(weight_re_, 0, sizeof(weight_re_));
+    memset(weight_im_, 0, sizeof(weight_im_));
+    constrain_ = 0;
+    memset(echo_re_, 0, sizeof(echo_re_));
+    memset(echo_im_, 0, sizeof(echo_im_));
+    memset(power_, 0, sizeof(power_));
+    memset(error_re_, 0, sizeof(error_re_));
+    memset(error_im_, 0, sizeof(error_im_));
+    far_active_ = false;
+    far_frames_ = 0;
+    diverged_frames_ = 0;
+    memset(residual_, 0, sizeof(residual_));
+    leakage_ = kInitialLeakage;
+}
+
+void EchoCanceller::SetDelay(size_t frames)
+{
+    delay_ = std::min(frames, kMaxDelayFrames);
+}
+
+void EchoCanceller::Constrain(size_t tap)
+{
+    fft_.Inverse(weight_re_[tap], weight_im_[tap], time_);
+    memset(time_ + frame_, 0, (fft_.size() - frame_) * sizeof(float));
+    fft_.Forward(time_, weight_re_[tap], weight_im_[tap]);
+}
+
+void EchoCanceller::Process(const float *far, float *near, float *echo)
+{
+    const size_t keep = fft_.size() - frame_;
+
+    memmove(far_time_, far_time_ + frame_, keep * sizeof(float));
+    memcpy(far_time_ + keep, far, frame_ * sizeof(float));
+    head_ = (head_ + 1) % kHistory;
+    fft_.Forward(far_time_, far_re_[head_], far_im_[head_]);
+
+    size_t slot[kTaps];
+    for (size_t m = 0; m < kTaps; m++)
+        slot[m] = (head_ + 2 * kHistory - delay_ - m) % kHistory;
+
+    /* Echo estimate and the far-end power under the filter */
+    memset(echo_re_, 0, fft_padded_ * sizeof(float));
+    memset(echo_im_, 0, fft_padded_ * sizeof(float));
+    memset(power_, 0, fft_padded_ * sizeof(float));
+
+    for (size_t m = 0; m < kTaps; m++) {
+        const float *xr = far_re_[slot[m]], *xi = far_im_[slot[m]];
+        const float *wr = weight_re_[m], *wi = weight_im_[m];
+
+        for (size_t k = 0; k < fft_padded_; k += 4) {
+            vec4 a = Load(xr + k), b = Load(xi + k);
+            vec4 c = Load(wr + k), d = Load(wi + k);
+
+            Store(echo_re_ + k, Add(Load(echo_re_ + k), Sub(Mul(c, a), Mul(d, b))));
+            Store(echo_im_ + k, Add(Load(echo_im_ + k), Add(Mul(c, b), Mul(d, a))));
+            Store(power_ + k, Add(Load(power_ + k), Add(Mul(a, a), Mul(b, b))));
+        }
+    }
+
+    /* Overlap-save: the last frame_ samples are the linear convolution */
+    fft_.Inverse(echo_re_, echo_im_, time_);
+
+    float near_energy = 0, error_energy = 0, echo_energy = 0, far_energy = 0;
+    for (size_t i = 0; i < frame_; i++) {
+        float e = near[i] - time_[keep + i];
+
+        echo[i] = time_[keep + i];
+        near_energy += near[i] * near[i];
+        error_energy += e * e;
+        echo_energy += echo[i] * echo[i];
+        far_energy += far[i] * far[i];
+        time_[keep + i] = e;
+    }
+    far_active_ = far_energy > kFarActive * far_floor_ * frame_;
+    if (far_active_ && far_frames_ < kStartupFrames)
+        far_frames_++;
+
+    float step = kStep;
+    if (far_frames_ >= kStartupFrames && error_energy > 0)
+        step *= std::min(kStepMargin * leakage_ * echo_energy / error_energy, 1.0f);
+
+    /* The filter only ever takes echo out */
+    if (error_energy < near_energy)
+        memcpy(near, time_ + keep, frame_ * sizeof(float));
+
+    memset(time_, 0, keep * sizeof(float));
+    fft_.Forward(time_, error_re_, error_im_);
+
+    /* A bin's far end spans M samples in each of the partitions */
+    const float floor = kTaps * far_floor_ * fft_.size();
+    for (size_t k = 0; k < fft_bins_; k++) {
+        float scale = 0;
+        if (power_[k] > floor) {
+            float e2 = error_re_[k] * error_re_[k] + error_im_[k] * error_im_[k];
+            float limit = kErrorClip * power_[k] / kTaps;
+            scale = step / (power_[k] + floor);
+            if (e2 > limit)
+                scale *= sqrtf(limit / e2);
+        }
+        error_re_[k] *= scale;
+        error_im_[k] *= scale;
+    }
+
+    for (size_t m = 0; m < kTaps; m++) {
+        const float *xr = far_re_[slot[m]], *xi = far_im_[slot[m]];
+        float *wr = weight_re_[m], *wi = weight_im_[m];
+
+        for (size_t k = 0; k < fft_padded_; k += 4) {
+            vec4 a = Load(xr + k), b = Load(xi + k);
+            vec4 sr = Load(error_re_ + k), si = Load(error_im_ + k);
+
+            Store(wr + k, Add(Load(wr + k), Add(Mul(sr, a), Mul(si, b))));
+            Store(wi + k, Add(Load(wi + k), Sub(Mul(si, a), Mul(sr, b))));
+        }
+    }
+
+    Constrain(constrain_);
+    constrain_ = (constrain_ + 1) % kTaps;
+
+    if (near_energy > 0 && error_energy > 2 * near_energy) {
+        if (++diverged_frames_ >= kDivergedFrames) {
+            memset(weight_re_, 0, sizeof(weight_re_));
+            memset(weight_im_, 0, sizeof(weight_im_));
+            far_frames_ = 0;
+            diverged_frames_ = 0;
+        }
+    } else {
+        diverged_frames_ = 0;
+    }
+}
+
+void EchoCanceller::Suppress(const float *re, const float *im, const float *echo_re,
+                             const float *echo_im, float *gain)
+{
+    float out_energy = 0, echo_energy = 0;
+    float echo_power[kPaddedBins];
+    float out_power[kPaddedBins];
+
+    for (size_t k = 0; k < bins_; k++) {
+        out_power[k] = re[k] * re[k] + im[k] * im[k];
+        echo_power[k] = echo_re[k] * echo_re[k] + echo_im[k] * echo_im[k];
+        out_energy += out_power[k];
+        echo_energy += echo_power[k];
+    }
+
+    /*
+     * Leakage follows what is left relative to the echo estimate while
+     * the far end is active: down quickly as the filter converges, up
+     * slowly so that a spell of double talk does not raise it much.
+     */
+    if (far_active_ && echo_energy > 0) {
+        float ratio = std::min(out_energy / echo_energy, 1.0f);
+        leakage_ += (ratio - leakage_) * (ratio < leakage_ ? kLeakageFall : kLeakageRise);
+        leakage_ = std::max(leakage_, kMinLeakage);
+    }
+
+    for (size_t k = 0; k < bins_; k++) {
+        residual_[k] = std::max(leakage_ * echo_power[k], kTailDecay * residual_[k]);
+        float g = 1 - kOverSuppression * residual_[k] / (out_power[k] + 1e-20f);
+        gain[k] *= std::max(g, kMinGain);
+    }
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
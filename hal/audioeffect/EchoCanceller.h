@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Fft.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * Echo cancellation for VoiceProcessor, one 10 ms frame of N samples
+ * at a time.
+ *
+ * The linear filter is a partitioned block frequency-domain adaptive
+ * filter: kTaps partitions of N samples each, the first SetDelay()
+ * frames back, run by overlap-save on FFTs of M >= 2N points so the
+ * echo estimate is an exact linear convolution and adds no latency.
+ * Updates are NLMS normalised by the far-end power the filter sees. The
+ * step shrinks when the error is more than the residual echo explains,
+ * and the error used is clipped relative to the far-end power, so
+ * near-end speech during double talk does not throw the filter off. The update
+ * is left unconstrained except for one partition a frame, whose impulse
+ * response is cut back to N samples in turn.
+ *
+ * What the filter leaves is estimated on the short-time spectra of the
+ * processor from its echo estimate and a leakage factor that tracks the
+ * residual while the far end talks, and turned into a suppression gain
+ * per bin.
+ *
+ * Bins are processed four at a time; arrays are padded to a multiple of
+ * four and the padding stays zero.
+ */
+class EchoCanceller
+{
+public:
+    static constexpr size_t kTaps = 16;
+    static constexpr size_t kMaxDelayFrames = 30;
+    static constexpr size_t kMaxFrame = Fft::kMaxSize / 2;
+    static constexpr size_t kPaddedBins = (Fft::kMaxBins + 3) & ~3;
+
+    EchoCanceller();
+
+    /*
+     * @frame samples, at most kMaxFrame, are processed at a time and the
+     * suppression works on @bins spectra. Below @far_floor, a power per
+     * sample, the far end is taken as silent and nothing adapts.
+     */
+    void Configure(size_t frame, size_t bins, float far_floor);
+    void Reset();
+
+    void SetDelay(size_t frames);
+
+    /*
+     * One frame of @far and @near end. @near is replaced with the echo
+     * cancelled signal and the echo estimate is written to @echo.
+     */
+    void Process(const float *far, float *near, float *echo);
+
+    /*
+     * Multiplies @gain by the residual echo suppression, from the spectra
+     * of the output and the echo estimate of the last Process().
+     */
+    void Suppress(const float *re, const float *im, const float *echo_re, const float *echo_im,
+                  float *gain);
+
+private:
+    static constexpr size_t kHistory = kTaps + kMaxDelayFrames;
+
+    void Constrain(size_t tap);
+
+    size_t frame_;
+    size_t bins_;
+    size_t padded_;
+    float far_floor_;
+    size_t delay_;
+
+    Fft fft_;
+    size_t fft_bins_;
+    size_t fft_padded_;
+
+    /* The far end of the last M samples, and its spectra, newest at head_ */
+    float far_time_[Fft::kMaxSize];
+    size_t head_;
+    alignas(16) float far_re_[kHistory][kPaddedBins];
+    alignas(16) float far_im_[kHistory][kPaddedBins];
+
+    alignas(16) float weight_re_[kTaps][kPaddedBins];
+    alignas(16) float weight_im_[kTaps][kPaddedBins];
+    size_t constrain_;
+
+    /* Per frame: echo estimate, far-end power, error, scaled error */
+    alignas(16) float time_[Fft::kMaxSize];
+    alignas(16) float echo_re_[kPaddedBins];
+    alignas(16) float echo_im_[kPaddedBins];
+    alignas(16) float power_[kPaddedBins];
+    alignas(16) float error_re_[kPaddedBins];
+    alignas(16) float error_im_[kPaddedBins];
+
+    bool far_active_;
+    unsigned far_frames_;
+    unsigned diverged_frames_;
+
+    /* Suppression, on the processor's spectra */
+    float residual_[kPaddedBins];
+    float leakage_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
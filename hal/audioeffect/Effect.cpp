@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+
+#include <algorithm>
+
+#include "Effect.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static constexpr float kS16ToFloat = 1.0f / 32768;
+static constexpr float kFloatToS16 = 32768;
+
+/* Volumes of EFFECT_CMD_SET_VOLUME are 8.24 fixed point */
+static constexpr float kVolumeUnity = 1 << 24;
+
+static int32_t EffectProcess(effect_handle_t self, audio_buffer_t *in, audio_buffer_t *out)
+{
+    Effect *effect = Effect::FromHandle(self);
+    return effect ? effect->Process(in, out) : -EINVAL;
+}
+
+static int32_t EffectCommand(effect_handle_t self, uint32_t code, uint32_t size, void *data,
+                             uint32_t *reply_size, void *reply)
+{
+    Effect *effect = Effect::FromHandle(self);
+    return effect ? effect->Command(code, size, data, reply_size, reply) : -EINVAL;
+}
+
+static int32_t EffectProcessReverse(effect_handle_t self, audio_buffer_t *in,
+                                    audio_buffer_t *out)
+{
+    Effect *effect = Effect::FromHandle(self);
+    return effect ? effect->ProcessReverse(in, out) : -EINVAL;
+}
+
+static int32_t EffectGetDescriptor(effect_handle_t self, effect_descriptor_t *descriptor)
+{
+    Effect *effect = Effect::FromHandle(self);
+    if (effect == nullptr || descriptor == nullptr)
+        return -EINVAL;
+
+    *descriptor = effect->descriptor();
+    return 0;
+}
+
+static const struct effect_interface_s kInterface = {
+    EffectProcess,
+    EffectCommand,
+    EffectGetDescriptor,
+    nullptr,
+};
+
+static const struct effect_interface_s kReverseInterface = {
+    EffectProcess,
+    EffectCommand,
+    EffectGetDescriptor,
+    EffectProcessReverse,
+};
+
+static inline int16_t ToS16(float v)
+{
+    v = std::min(std::max(v, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(v < 0 ? v - 0.5f : v + 0.5f);
+}
+
+static bool IntReply(uint32_t *reply_size, void *reply)
+{
+    return reply != nullptr && reply_size != nullptr && *reply_size == sizeof(int);
+}
+
+/* Offset of the value in an effect_param_t: the parameter, padded to an int */
+static uint32_t ValueOffset(uint32_t psize)
+{
+    return ((psize - 1) / sizeof(int) + 1) * sizeof(int);
+}
+
+Effect::Effect(const effect_descriptor_t& descriptor, bool reverse)
+    : descriptor_(descriptor),
+      enabled_(false),
+      dirty_(false),
+      config_(),
+      format_(),
+      configured_(false),
+      reset_(false),
+      active_(),
+      active_configured_(false),
+      was_active_(false)
+{
+    handle_.itfe = reverse ? &kReverseInterface : &kInterface;
+    handle_.effect = this;
+}
+
+Effect *Effect::FromHandle(effect_handle_t handle)
+{
+    if (handle == nullptr)
+        return nullptr;
+
+    return reinterpret_cast<Handle*>(handle)->effect;
+}
+
+bool Effect::SetVolume(float, float)
+{
+    return false;
+}
+
+bool Effect::SupportsRate(uint32_t sample_rate) const
+{
+    return sample_rate >= 8000 && sample_rate <= 192000;
+}
+
+void Effect::OnEnable(bool)
+{
+}
+
+int Effect::ExtraCommand(uint32_t, uint32_t, void *, uint32_t *, void *)
+{
+    return -EINVAL;
+}
+
+int Effect::ProcessReverse(audio_buffer_t *, audio_buffer_t *)
+{
+    return -EINVAL;
+}
+
+bool Effect::IsPreProcessing() const
+{
+    return (descriptor_.flags & EFFECT_FLAG_TYPE_MASK) == EFFECT_FLAG_TYPE_PRE_PROC;
+}
+
+int Effect::SetConfig(const effect_config_t& config)
+{
+    const buffer_config_t& in = config.inputCfg;
+    const buffer_config_t& out = config.outputCfg;
+    size_t channels = IsPreProcessing() ? audio_channel_count_from_in_mask(in.channels)
+                                        : audio_channel_count_from_out_mask(in.channels);
+
+    if (in.samplingRate != out.samplingRate || !SupportsRate(in.samplingRate) ||
+        in.channels != out.channels || channels < 1 ||
+        channels > kMaxChannels || in.format != out.format ||
+        (in.format != AUDIO_FORMAT_PCM_16_BIT && in.format != AUDIO_FORMAT_PCM_FLOAT) ||
+        (out.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
+         out.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE)) {
+        ALOGE("%s: %s: unsupported rate %u/%u, channels %#x/%#x, format %#x/%#x, access %u",
+              __func__, descriptor_.name, in.samplingRate, out.samplingRate, in.channels,
+              out.channels, in.format, out.format, out.accessMode);
+        return -EINVAL;
+    }
+
+    config_ = config;
+    format_.sample_rate = in.samplingRate;
+    format_.channels = channels;
+    format_.is_float = in.format == AUDIO_FORMAT_PCM_FLOAT;
+    format_.accumulate = out.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE;
+    configured_ = true;
+    dirty_.store(true, std::memory_order_release);
+    return 0;
+}
+
+int Effect::Command(uint32_t code, uint32_t size, void *data, uint32_t *reply_size, void *reply)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+
+    switch (code) {
+    case EFFECT_CMD_INIT: {
+        if (!IntReply(reply_size, reply))
+            return -EINVAL;
+
+        /* Capture for voice is most often 16 kHz mono */
+        effect_config_t config = {};
+        config.inputCfg.samplingRate = IsPreProcessing() ? 16000 : 44100;
+        config.inputCfg.channels = IsPreProcessing() ? AUDIO_CHANNEL_IN_MONO
+                                                     : AUDIO_CHANNEL_OUT_STEREO;
+        config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+        config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+        config.inputCfg.mask = EFFECT_CONFIG_ALL;
+        config.outputCfg = config.inputCfg;
+        config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+        *static_cast<int*>(reply) = SetConfig(config);
+        return 0;
+    }
+
+    case EFFECT_CMD_SET_CONFIG:
+        if (data == nullptr || size != sizeof(effect_config_t) || !IntReply(reply_size, reply))
+            return -EINVAL;
+        *static_cast<int*>(reply) = SetConfig(*static_cast<const effect_config_t*>(data));
+        return 0;
+
+    case EFFECT_CMD_GET_CONFIG:
+        if (reply == nullptr || reply_size == nullptr || *reply_size != sizeof(effect_config_t))
+            return -EINVAL;
+        memcpy(reply, &config_, sizeof(config_));
+        return 0;
+
+    case EFFECT_CMD_RESET:
+        reset_ = true;
+        dirty_.store(true, std::memory_order_release);
+        return 0;
+
+    case EFFECT_CMD_ENABLE:
+    case EFFECT_CMD_DISABLE:
+        if (!IntReply(reply_size, reply))
+            return -EINVAL;
+
+        /* Filter state from before the effect was disabled is stale */
+        if (code == EFFECT_CMD_ENABLE && !enabled_.load(std::memory_order_relaxed)) {
+            reset_ = true;
+            dirty_.store(true, std::memory_order_release);
+        }
+        enabled_.store(code == EFFECT_CMD_ENABLE, std::memory_order_relaxed);
+        OnEnable(code == EFFECT_CMD_ENABLE);
+        *static_cast<int*>(reply) = 0;
+        return 0;
+
+    case EFFECT_CMD_SET_PARAM: {
+        if (data == nullptr || size < sizeof(effect_param_t) || !IntReply(reply_size, reply))
+            return -EINVAL;
+
+        const effect_param_t *param = static_cast<const effect_param_t*>(data);
+        if (param->psize < sizeof(int32_t) || param->psize > size || param->vsize > size ||
+            size < sizeof(effect_param_t) + ValueOffset(param->psize) + param->vsize)
+            return -EINVAL;
+
+        int status = SetParameter(reinterpret_cast<const int32_t*>(param->data), param->psize,
+                                  param->data + ValueOffset(param->psize), param->vsize);
+        if (status == 0)
+            dirty_.store(true, std::memory_order_release);
+        *static_cast<int*>(reply) = status;
+        return 0;
+    }
+
+    case EFFECT_CMD_GET_PARAM: {
+        if (data == nullptr || size < sizeof(effect_param_t) || reply == nullptr ||
+            reply_size == nullptr)
+            return -EINVAL;
+
+        const effect_param_t *param = static_cast<const effect_param_t*>(data);
+        if (param->psize < sizeof(int32_t) || param->psize > size ||
+            size < sizeof(effect_param_t) + param->psize ||
+            *reply_size < sizeof(effect_param_t) + ValueOffset(param->psize))
+            return -EINVAL;
+
+        effect_param_t *out = static_cast<effect_param_t*>(reply);
+        memcpy(out, param, sizeof(effect_param_t) + param->psize);
+
+        uint32_t offset = ValueOffset(out->psize);
+        uint32_t vsize = *reply_size - sizeof(effect_param_t) - offset;
+        out->status = GetParameter(reinterpret_cast<const int32_t*>(out->data), out->psize,
+                                   out->data + offset, &vsize);
+        out->vsize = out->status == 0 ? vsize : 0;
+        *reply_size = sizeof(effect_param_t) + offset + out->vsize;
+        return 0;
+    }
+
+    case EFFECT_CMD_SET_VOLUME: {
+        if (data == nullptr || size != 2 * sizeof(uint32_t))
+            return -EINVAL;
+
+        uint32_t volume[2];
+        memcpy(volume, data, sizeof(volume));
+        if (SetVolume(volume[0] / kVolumeUnity, volume[1] / kVolumeUnity))
+            dirty_.store(true, std::memory_order_release);
+
+        /* The volume is applied after the effect, unchanged */
+        if (reply != nullptr && reply_size != nullptr && *reply_size >= sizeof(volume))
+            memcpy(reply, volume, sizeof(volume));
+        return 0;
+    }
+
+    case EFFECT_CMD_SET_DEVICE:
+    case EFFECT_CMD_SET_AUDIO_MODE:
+    case EFFECT_CMD_SET_INPUT_DEVICE:
+    case EFFECT_CMD_SET_AUDIO_SOURCE:
+        return 0;
+
+    default:
+        return ExtraCommand(code, size, data, reply_size, reply);
+    }
+}
+
+void Effect::Deinterleave(const audio_buffer_t *in, size_t offset, size_t frames)
+{
+    const size_t channels = active_.channels;
+
+    if (active_.is_float) {
+        const float *src = in->f32 + offset * channels;
+        if (channels == 1) {
+            memcpy(planar_[0], src, frames * sizeof(float));
+            return;
+        }
+        for (size_t i = 0; i < frames; i++) {
+            planar_[0][i] = src[2 * i];
+            planar_[1][i] = src[2 * i + 1];
+        }
+        return;
+    }
+
+    const int16_t *src = in->s16 + offset * channels;
+    if (channels == 1) {
+        for (size_t i = 0; i < frames; i++)
+            planar_[0][i] = src[i] * kS16ToFloat;
+        return;
+    }
+    for (size_t i = 0; i < frames; i++) {
+        planar_[0][i] = src[2 * i] * kS16ToFloat;
+        planar_[1][i] = src[2 * i + 1] * kS16ToFloat;
+    }
+}
+
+void Effect::Interleave(audio_buffer_t *out, size_t offset, size_t frames)
+{
+    const size_t channels = active_.channels;
+
+    if (active_.is_float) {
+        float *dst = out->f32 + offset * channels;
+        for (size_t i = 0; i < frames; i++) {
+            for (size_t c = 0; c < channels; c++) {
+                if (active_.accumulate)
+                    dst[i * channels + c] += planar_[c][i];
+                else
+                    dst[i * channels + c] = planar_[c][i];
+            }
+        }
+        return;
+    }
+
+    int16_t *dst = out->s16 + offset * channels;
+    for (size_t i = 0; i < frames; i++) {
+        for (size_t c = 0; c < channels; c++) {
+            float v = planar_[c][i] * kFloatToS16;
+            if (active_.accumulate)
+                v += dst[i * channels + c];
+            dst[i * channels + c] = ToS16(v);
+        }
+    }
+}
+
+void Effect::Copy(const audio_buffer_t *in, audio_buffer_t *out)
+{
+    const size_t samples = in->frameCount * active_.channels;
+    const size_t bytes = samples * (active_.is_float ? sizeof(float) : sizeof(int16_t));
+
+    if (!active_.accumulate) {
+        if (in->raw != out->raw)
+            memmove(out->raw, in->raw, bytes);
+        return;
+    }
+
+    if (active_.is_float) {
+        for (size_t i = 0; i < samples; i++)
+            out->f32[i] += in->f32[i];
+        return;
+    }
+    for (size_t i = 0; i < samples; i++)
+        out->s16[i] = ToS16((float)out->s16[i] + in->s16[i]);
+}
+
+int Effect::Process(audio_buffer_t *in, audio_buffer_t *out)
+{
+    if (in == nullptr || out == nullptr || in->raw == nullptr || out->raw == nullptr ||
+        in->frameCount != out->frameCount)
+        return -EINVAL;
+
+    if (!enabled_.load(std::memory_order_relaxed))
+        return -ENODATA;
+
+    if (dirty_.load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> lock(lock_, std::try_to_lock);
+        if (lock.owns_lock()) {
+            dirty_.store(false, std::memory_order_relaxed);
+
+            bool changed = active_configured_ != configured_ ||
+                           active_.sample_rate != format_.sample_rate ||
+                           active_.channels != format_.channels;
+            active_ = format_;
+            active_configured_ = configured_;
+            if (active_configured_)
+                Commit(active_.sample_rate, active_.channels);
+            if (changed || reset_)
+                Reset();
+            reset_ = false;
+        }
+    }
+
+    if (!active_configured_)
+        return -EINVAL;
+
+    bool active = IsActive();
+    if (active && !was_active_)
+        Reset();
+    was_active_ = active;
+
+    if (!active) {
+        Copy(in, out);
+        return 0;
+    }
+
+    float *planar[kMaxChannels];
+    for (size_t c = 0; c < kMaxChannels; c++)
+        planar[c] = planar_[c];
+
+    for (size_t offset = 0; offset < in->frameCount; offset += kBlockFrames) {
+        size_t frames = std::min(kBlockFrames, in->frameCount - offset);
+        Deinterleave(in, offset, frames);
+        ProcessPlanar(planar, frames);
+        Interleave(out, offset, frames);
+    }
+
+    return 0;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+
+#include <hardware/audio_effect.h>
+
+#include "BiquadCascade.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * One effect instance behind the legacy effect_interface_s, as loaded by
+ * libeffects for the audio.effect@4.0 service.
+ *
+ * The HIDL wrapper calls process() from its own thread while commands
+ * arrive on binder threads, and nothing serialises the two. Settings
+ * and the configuration are therefore kept on the control side under
+ * lock_, and only mark the effect dirty. The audio thread applies them
+ * through Commit() at the start of a process() call, and only if it
+ * gets lock_ without waiting. If it does not, the block runs on the
+ * current coefficients and the next call applies the change.
+ *
+ * Buffers are PCM 16 or float, interleaved mono or stereo. They are
+ * converted kBlockFrames at a time into planar float scratch that is
+ * part of the object, so process() never allocates.
+ */
+class Effect
+{
+public:
+    static constexpr size_t kBlockFrames = BiquadCascade::kBlockFrames;
+    static constexpr size_t kMaxChannels = BiquadCascade::kMaxChannels;
+
+    /* With @reverse the handle offers process_reverse() */
+    explicit Effect(const effect_descriptor_t& descriptor, bool reverse = false);
+    virtual ~Effect() = default;
+
+    Effect(const Effect&) = delete;
+    Effect& operator=(const Effect&) = delete;
+
+    effect_handle_t handle() { return reinterpret_cast<effect_handle_t>(&handle_); }
+    static Effect *FromHandle(effect_handle_t handle);
+
+    const effect_descriptor_t& descriptor() const { return descriptor_; }
+
+    int Process(audio_buffer_t *in, audio_buffer_t *out);
+    int Command(uint32_t code, uint32_t size, void *data, uint32_t *reply_size, void *reply);
+
+    /* The far-end stream of a pre-processing effect */
+    virtual int ProcessReverse(audio_buffer_t *in, audio_buffer_t *out);
+
+protected:
+    /*
+     * Control side, called with lock_ held. @param is the parameter id
+     * followed by its arguments, @psize bytes in all. On entry *@vsize
+     * is the room at @value, on return the bytes written. Both return 0
+     * or a negative errno.
+     */
+    virtual int GetParameter(const int32_t *param, uint32_t psize, void *value,
+                             uint32_t *vsize) = 0;
+    virtual int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                             uint32_t vsize) = 0;
+
+    /*
+     * Volume the framework applies after the effect, for
+     * EFFECT_FLAG_VOLUME_IND effects; true if the settings changed.
+     */
+    virtual bool SetVolume(float left, float right);
+
+    /*
+     * Control side, with lock_ held: whether SET_CONFIG may pick
+     * @sample_rate, ENABLE and DISABLE, and the commands that Command()
+     * does not handle itself.
+     */
+    virtual bool SupportsRate(uint32_t sample_rate) const;
+    virtual void OnEnable(bool enabled);
+    virtual int ExtraCommand(uint32_t code, uint32_t size, void *data, uint32_t *reply_size,
+                             void *reply);
+
+    /* Control side, with lock_ held: the last configuration accepted */
+    const effect_config_t& config() const { return config_; }
+
+    /*
+     * Audio side. Commit() turns the settings into coefficients and is
+     * called with lock_ held; Reset() clears filter state. While
+     * IsActive() is false, process() copies the input unchanged.
+     */
+    virtual void Commit(uint32_t sample_rate, size_t channels) = 0;
+    virtual void Reset() = 0;
+    virtual bool IsActive() const = 0;
+    virtual void ProcessPlanar(float * const *data, size_t frames) = 0;
+
+    /* Reads an @T argument of a parameter or value, which need not be aligned */
+    template <typename T>
+    static bool Read(const void *data, uint32_t size, size_t offset, T *out);
+    template <typename T>
+    static int Write(void *data, uint32_t *size, const T& in);
+
+private:
+    struct Handle {
+        const struct effect_interface_s *itfe;
+        Effect *effect;
+    };
+
+    struct Format {
+        uint32_t sample_rate;
+        size_t channels;
+        bool is_float;
+        bool accumulate;
+    };
+
+    bool IsPreProcessing() const;
+    int SetConfig(const effect_config_t& config);
+    void Deinterleave(const audio_buffer_t *in, size_t offset, size_t frames);
+    void Interleave(audio_buffer_t *out, size_t offset, size_t frames);
+    void Copy(const audio_buffer_t *in, audio_buffer_t *out);
+
+    Handle handle_;
+    const effect_descriptor_t descriptor_;
+
+    std::atomic<bool> enabled_;
+
+    /* Control side */
+    std::mutex lock_;
+    std::atomic<bool> dirty_;
+    effect_config_t config_;
+    Format format_;
+    bool configured_;
+    bool reset_;
+
+    /* Audio side */
+    Format active_;
+    bool active_configured_;
+    bool was_active_;
+    alignas(16) float planar_[kMaxChannels][kBlockFrames];
+};
+
+template <typename T>
+bool Effect::Read(const void *data, uint32_t size, size_t offset, T *out)
+{
+    if (size < offset + sizeof(T))
+        return false;
+
+    memcpy(out, static_cast<const uint8_t*>(data) + offset, sizeof(T));
+    return true;
+}
+
+template <typename T>
+int Effect::Write(void *data, uint32_t *size, const T& in)
+{
+    if (*size < sizeof(T))
+        return -EINVAL;
+
+    memcpy(data, &in, sizeof(T));
+    *size = sizeof(T);
+    return 0;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
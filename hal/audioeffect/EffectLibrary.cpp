@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+#include <audio_effects/effect_aec.h>
+#endif
+#include <audio_effects/effect_agc.h>
+#include <audio_effects/effect_bassboost.h>
+#include <audio_effects/effect_equalizer.h>
+#include <audio_effects/effect_ns.h>
+#include <audio_effects/effect_virtualizer.h>
+#include <hardware/audio_effect.h>
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+#include "AcousticEchoCanceler.h"
+#endif
+#include "AutomaticGainControl.h"
+#include "BassBoost.h"
+#include "Equalizer.h"
+#include "Loudness.h"
+#include "NoiseSuppressor.h"
+#include "Virtualizer.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static const effect_uuid_t kLoudnessType =
+        { 0x94506109, 0xe722, 0x4408, 0x8144, { 0xf1, 0xea, 0xfb, 0xa7, 0x22, 0x89 } };
+
+/*
+ * cpuLoad is in 0.1 MIPS and memoryUsage in KiB, estimated for a 48 kHz
+ * stereo stream with every section in use. The pre-processing effects
+ * share one VoiceProcessor per stream, which the echo canceller's
+ * figures include.
+ */
+static const effect_descriptor_t kEqualizerDescriptor = {
+    *SL_IID_EQUALIZER,
+    { 0x84fa453e, 0x35d0, 0x4496, 0xa060, { 0x37, 0xbe, 0x42, 0x48, 0x88, 0xc2 } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST,
+    30,
+    2,
+    "Equalizer",
+    "Rockchip",
+};
+
+static const effect_descriptor_t kBassBoostDescriptor = {
+    *SL_IID_BASSBOOST,
+    { 0xd96d3871, 0xb9be, 0x42e5, 0x9a88, { 0x8a, 0x39, 0x3d, 0xa8, 0xae, 0x04 } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST | EFFECT_FLAG_DEVICE_IND,
+    15,
+    2,
+    "Bass Boost",
+    "Rockchip",
+};
+
+static const effect_descriptor_t kVirtualizerDescriptor = {
+    *SL_IID_VIRTUALIZER,
+    { 0xa5cfebe9, 0x8d2d, 0x40bf, 0x8865, { 0x08, 0xaf, 0x5c, 0x0f, 0xd6, 0x2e } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_LAST | EFFECT_FLAG_DEVICE_IND,
+    15,
+    3,
+    "Virtualizer",
+    "Rockchip",
+};
+
+static const effect_descriptor_t kLoudnessDescriptor = {
+    kLoudnessType,
+    { 0x858092a8, 0x96aa, 0x42d6, 0x95ed, { 0x08, 0xce, 0x5d, 0x48, 0xa8, 0xa3 } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_LAST | EFFECT_FLAG_VOLUME_IND,
+    15,
+    2,
+    "Loudness Compensation",
+    "Rockchip",
+};
+
+/*
+ * The echo canceller needs the far end through process_reverse(), which
+ * only the audio HAL can feed with what it plays; nothing in this tree
+ * does yet. Until then it is built into the pre-processing benchmark
+ * only, and the library does not offer it.
+ */
+#if defined(ROCKCHIP_EFFECTS_AEC)
+static const effect_descriptor_t kEchoCancellerDescriptor = {
+    *FX_IID_AEC,
+    { 0x6949063e, 0xe627, 0x466f, 0x85e3, { 0x5c, 0x62, 0x73, 0xb1, 0x3e, 0x06 } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_PRE_PROC | EFFECT_FLAG_DEVICE_IND,
+    300,
+    365,
+    "Acoustic Echo Canceler",
+    "Rockchip",
+};
+#endif
+
+static const effect_descriptor_t kNoiseSuppressorDescriptor = {
+    *FX_IID_NS,
+    { 0x9e5295e3, 0xc835, 0x48f3, 0x8648, { 0x94, 0x4d, 0xea, 0x9c, 0x8e, 0xde } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_PRE_PROC | EFFECT_FLAG_DEVICE_IND,
+    60,
+    2,
+    "Noise Suppressor",
+    "Rockchip",
+};
+
+static const effect_descriptor_t kGainControlDescriptor = {
+    *FX_IID_AGC,
+    { 0xe1ccadb8, 0x393a, 0x40ae, 0xa892, { 0xb0, 0xf9, 0xed, 0x11, 0x91, 0xe2 } },
+    EFFECT_CONTROL_API_VERSION,
+    EFFECT_FLAG_TYPE_PRE_PROC | EFFECT_FLAG_DEVICE_IND,
+    5,
+    2,
+    "Automatic Gain Control",
+    "Rockchip",
+};
+
+static const effect_descriptor_t * const kDescriptors[] = {
+    &kEqualizerDescriptor,
+    &kBassBoostDescriptor,
+    &kVirtualizerDescriptor,
+    &kLoudnessDescriptor,
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    &kEchoCancellerDescriptor,
+#endif
+    &kNoiseSuppressorDescriptor,
+    &kGainControlDescriptor,
+};
+
+/* The VoiceProcessor of each capture stream, by session and input */
+static std::mutex sSessionLock;
+static std::map<std::pair<int32_t, int32_t>, std::weak_ptr<VoiceProcessor>> sSessions;
+
+static const effect_descriptor_t *FindDescriptor(const effect_uuid_t *uuid)
+{
+    if (uuid == nullptr)
+        return nullptr;
+
+    for (const effect_descriptor_t *descriptor : kDescriptors) {
+        if (memcmp(&descriptor->uuid, uuid, sizeof(*uuid)) == 0)
+            return descriptor;
+    }
+    return nullptr;
+}
+
+static std::shared_ptr<VoiceProcessor> GetVoiceProcessor(int32_t session_id, int32_t io_id)
+{
+    std::lock_guard<std::mutex> lock(sSessionLock);
+
+    for (auto it = sSessions.begin(); it != sSessions.end();) {
+        if (it->second.expired())
+            it = sSessions.erase(it);
+        else
+            ++it;
+    }
+
+    std::weak_ptr<VoiceProcessor>& slot = sSessions[std::make_pair(session_id, io_id)];
+    std::shared_ptr<VoiceProcessor> processor = slot.lock();
+    if (processor == nullptr) {
+        processor.reset(new (std::nothrow) VoiceProcessor());
+        slot = processor;
+    }
+    return processor;
+}
+
+static int32_t CreateEffect(const effect_uuid_t *uuid, int32_t session_id, int32_t io_id,
+                            effect_handle_t *handle)
+{
+    const effect_descriptor_t *descriptor = FindDescriptor(uuid);
+    Effect *effect = nullptr;
+
+    if (descriptor == nullptr || handle == nullptr)
+        return -EINVAL;
+
+    if (descriptor == &kEqualizerDescriptor)
+        effect = new (std::nothrow) Equalizer(*descriptor);
+    else if (descriptor == &kBassBoostDescriptor)
+        effect = new (std::nothrow) BassBoost(*descriptor);
+    else if (descriptor == &kVirtualizerDescriptor)
+        effect = new (std::nothrow) Virtualizer(*descriptor);
+    else if (descriptor == &kLoudnessDescriptor)
+        effect = new (std::nothrow) Loudness(*descriptor);
+    else {
+        std::shared_ptr<VoiceProcessor> processor = GetVoiceProcessor(session_id, io_id);
+        if (processor == nullptr)
+            return -ENOMEM;
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+        if (descriptor == &kEchoCancellerDescriptor)
+            effect = new (std::nothrow) AcousticEchoCanceler(*descriptor, std::move(processor));
+        else
+#endif
+        if (descriptor == &kNoiseSuppressorDescriptor)
+            effect = new (std::nothrow) NoiseSuppressor(*descriptor, std::move(processor));
+        else
+            effect = new (std::nothrow) AutomaticGainControl(*descriptor, std::move(processor));
+    }
+
+    if (effect == nullptr)
+        return -ENOMEM;
+
+    ALOGV("%s: %s for session %d on io %d", __func__, descriptor->name, session_id, io_id);
+    *handle = effect->handle();
+    return 0;
+}
+
+static int32_t ReleaseEffect(effect_handle_t handle)
+{
+    Effect *effect = Effect::FromHandle(handle);
+    if (effect == nullptr)
+        return -EINVAL;
+
+    delete effect;
+    return 0;
+}
+
+static int32_t GetDescriptor(const effect_uuid_t *uuid, effect_descriptor_t *descriptor)
+{
+    const effect_descriptor_t *found = FindDescriptor(uuid);
+    if (found == nullptr || descriptor == nullptr)
+        return -EINVAL;
+
+    *descriptor = *found;
+    return 0;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
+
+extern "C" {
+
+__attribute__((visibility("default")))
+audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM = {
+    .tag = AUDIO_EFFECT_LIBRARY_TAG,
+    .version = EFFECT_LIBRARY_API_VERSION,
+    .name = "Rockchip Effects Library",
+    .implementor = "Rockchip",
+    .create_effect = android::hardware::rockchip::effects::CreateEffect,
+    .release_effect = android::hardware::rockchip::effects::ReleaseEffect,
+    .get_descriptor = android::hardware::rockchip::effects::GetDescriptor,
+};
+
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <audio_effects/effect_equalizer.h>
+
+#include "Equalizer.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* Roughly two octaves per band */
+static constexpr double kBandQ = 0.8;
+
+struct Band {
+    uint32_t centre;                    /* Hz */
+    int32_t min_mhz;
+    int32_t max_mhz;
+};
+
+static constexpr Band kBandTable[Equalizer::kBands] = {
+    { 60, 30000, 120000 },
+    { 230, 120001, 460000 },
+    { 910, 460001, 1800000 },
+    { 3600, 1800001, 7000000 },
+    { 14000, 7000001, 20000000 },
+};
+
+struct Preset {
+    const char *name;
+    int8_t db[Equalizer::kBands];
+};
+
+static constexpr Preset kPresets[] = {
+    { "Normal", { 3, 0, 0, 0, 3 } },
+    { "Classical", { 5, 3, -2, 4, 4 } },
+    { "Dance", { 6, 0, 2, 4, 1 } },
+    { "Flat", { 0, 0, 0, 0, 0 } },
+    { "Folk", { 3, 0, 0, 2, -1 } },
+    { "Heavy Metal", { 4, 1, 9, 3, 0 } },
+    { "Hip Hop", { 5, 3, 0, 1, 3 } },
+    { "Jazz", { 4, 2, -2, 2, 5 } },
+    { "Pop", { -1, 2, 5, 1, -2 } },
+    { "Rock", { 5, 3, -1, 3, 5 } },
+};
+
+static constexpr int kPresetCount = sizeof(kPresets) / sizeof(kPresets[0]);
+
+Equalizer::Equalizer(const effect_descriptor_t& descriptor)
+    : Effect(descriptor),
+      levels_(),
+      preset_(kPresetCustom)
+{
+}
+
+void Equalizer::UsePreset(int preset)
+{
+    for (size_t i = 0; i < kBands; i++)
+        levels_[i] = kPresets[preset].db[i] * 100;
+    preset_ = preset;
+}
+
+int Equalizer::GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize)
+{
+    int32_t id, arg;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case EQ_PARAM_NUM_BANDS:
+        return Write(value, vsize, (uint16_t)kBands);
+
+    case EQ_PARAM_LEVEL_RANGE: {
+        int16_t range[2] = { kMinLevel, kMaxLevel };
+        return Write(value, vsize, range);
+    }
+
+    case EQ_PARAM_BAND_LEVEL:
+        if (!Read(param, psize, sizeof(id), &arg) || arg < 0 || arg >= (int32_t)kBands)
+            return -EINVAL;
+        return Write(value, vsize, levels_[arg]);
+
+    case EQ_PARAM_CENTER_FREQ:
+        if (!Read(param, psize, sizeof(id), &arg) || arg < 0 || arg >= (int32_t)kBands)
+            return -EINVAL;
+        return Write(value, vsize, (int32_t)(kBandTable[arg].centre * 1000));
+
+    case EQ_PARAM_BAND_FREQ_RANGE: {
+        if (!Read(param, psize, sizeof(id), &arg) || arg < 0 || arg >= (int32_t)kBands)
+            return -EINVAL;
+        int32_t range[2] = { kBandTable[arg].min_mhz, kBandTable[arg].max_mhz };
+        return Write(value, vsize, range);
+    }
+
+    case EQ_PARAM_GET_BAND: {
+        if (!Read(param, psize, sizeof(id), &arg))
+            return -EINVAL;
+        uint16_t band = kBands - 1;
+        for (size_t i = 0; i < kBands; i++) {
+            if (arg <= kBandTable[i].max_mhz) {
+                band = i;
+                break;
+            }
+        }
+        return Write(value, vsize, band);
+    }
+
+    case EQ_PARAM_CUR_PRESET:
+        return Write(value, vsize, (uint16_t)preset_);
+
+    case EQ_PARAM_GET_NUM_OF_PRESETS:
+        return Write(value, vsize, (uint16_t)kPresetCount);
+
+    case EQ_PARAM_GET_PRESET_NAME: {
+        if (!Read(param, psize, sizeof(id), &arg) || arg < 0 || arg >= kPresetCount ||
+            *vsize == 0)
+            return -EINVAL;
+        char *name = static_cast<char*>(value);
+        strncpy(name, kPresets[arg].name, *vsize - 1);
+        name[*vsize - 1] = '\0';
+        *vsize = strlen(name) + 1;
+        return 0;
+    }
+
+    case EQ_PARAM_PROPERTIES: {
+        uint16_t settings[2 + kBands] = { (uint16_t)preset_, (uint16_t)kBands };
+        for (size_t i = 0; i < kBands; i++)
+            settings[2 + i] = levels_[i];
+        return Write(value, vsize, settings);
+    }
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int Equalizer::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                            uint32_t vsize)
+{
+    int32_t id, arg;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case EQ_PARAM_BAND_LEVEL: {
+        int16_t level;
+        if (!Read(param, psize, sizeof(id), &arg) || arg < 0 || arg >= (int32_t)kBands ||
+            !Read(value, vsize, 0, &level))
+            return -EINVAL;
+        levels_[arg] = std::min(std::max(level, kMinLevel), kMaxLevel);
+        preset_ = kPresetCustom;
+        return 0;
+    }
+
+    case EQ_PARAM_CUR_PRESET: {
+        uint16_t preset;
+        if (!Read(value, vsize, 0, &preset) || preset >= kPresetCount)
+            return -EINVAL;
+        UsePreset(preset);
+        return 0;
+    }
+
+    case EQ_PARAM_PROPERTIES: {
+        int16_t settings[2 + kBands];
+        if (!Read(value, vsize, 0, &settings) || settings[1] != (int16_t)kBands)
+            return -EINVAL;
+        if (settings[0] >= 0 && settings[0] < kPresetCount) {
+            UsePreset(settings[0]);
+            return 0;
+        }
+        for (size_t i = 0; i < kBands; i++)
+            levels_[i] = std::min(std::max(settings[2 + i], kMinLevel), kMaxLevel);
+        preset_ = kPresetCustom;
+        return 0;
+    }
+
+    default:
+        return -EINVAL;
+    }
+}
+
+void Equalizer::Commit(uint32_t sample_rate, size_t channels)
+{
+    BiquadCoefficients sections[kBands];
+
+    for (size_t i = 0; i < kBands; i++)
+        sections[i] = BiquadCoefficients::Peaking(sample_rate, kBandTable[i].centre, kBandQ,
+                                                  levels_[i] / 100.0);
+
+    cascade_.SetChannels(channels);
+    cascade_.SetSections(sections, kBands);
+}
+
+void Equalizer::Reset()
+{
+    cascade_.Reset();
+}
+
+bool Equalizer::IsActive() const
+{
+    return !cascade_.IsIdentity();
+}
+
+void Equalizer::ProcessPlanar(float * const *data, size_t frames)
+{
+    cascade_.Process(data, frames);
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
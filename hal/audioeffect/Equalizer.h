@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "BiquadCascade.h"
+#include "Effect.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * android.media.audiofx.Equalizer: five peaking bands at the centre
+ * frequencies and with the presets of the stock bundle, so settings
+ * saved by apps carry over. Bands at 0 dB are left out of the cascade,
+ * and a flat EQ is not processed at all.
+ */
+class Equalizer : public Effect
+{
+public:
+    static constexpr size_t kBands = 5;
+    static constexpr int16_t kMinLevel = -1500;     /* mB */
+    static constexpr int16_t kMaxLevel = 1500;
+    static constexpr int kPresetCustom = -1;
+
+    explicit Equalizer(const effect_descriptor_t& descriptor);
+
+protected:
+    int GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize) override;
+    int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                     uint32_t vsize) override;
+
+    void Commit(uint32_t sample_rate, size_t channels) override;
+    void Reset() override;
+    bool IsActive() const override;
+    void ProcessPlanar(float * const *data, size_t frames) override;
+
+private:
+    void UsePreset(int preset);
+
+    /* Control side */
+    int16_t levels_[kBands];
+    int preset_;                        /* kPresetCustom once a band is moved */
+
+    BiquadCascade cascade_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
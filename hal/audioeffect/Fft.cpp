@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Fft.h"
+#include "Vec4.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+Fft::Fft()
+    : size_(0),
+      half_(0)
+{
+}
+
+bool Fft::Configure(size_t size)
+{
+    if (size < kMinSize || size > kMaxSize || (size & (size - 1)) != 0)
+        return false;
+
+    if (size == size_)
+        return true;
+
+    size_ = size;
+    half_ = size / 2;
+
+    size_t twiddle = 0;
+    for (size_t span = half_ / 2; span >= 4; span /= 2) {
+        for (size_t j = 0; j < span; j++) {
+            stage_re_[twiddle + j] = cos(M_PI * j / span);
+            stage_im_[twiddle + j] = -sin(M_PI * j / span);
+        }
+        twiddle += span;
+    }
+
+    for (size_t k = 0; k < half_; k++) {
+        split_re_[k] = cos(2 * M_PI * k / size);
+        split_im_[k] = -sin(2 * M_PI * k / size);
+    }
+
+    size_t bits = 0;
+    while (((size_t)1 << bits) < half_)
+        bits++;
+    for (size_t i = 0; i < half_; i++) {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        reverse_[i] = r;
+    }
+
+    return true;
+}
+
+void Fft::Transform(float *re, float *im)
+{
+    const size_t n = half_;
+    size_t twiddle = 0;
+
+    for (size_t span = n / 2; span >= 4; span /= 2) {
+        const float *wr = stage_re_ + twiddle;
+        const float *wi = stage_im_ + twiddle;
+
+        for (size_t base = 0; base < n; base += 2 * span) {
+            float *ar = re + base, *ai = im + base;
+            float *br = ar + span, *bi = ai + span;
+
+            for (size_t j = 0; j < span; j += 4) {
+                vec4 xr = Load(ar + j), xi = Load(ai + j);
+                vec4 yr = Load(br + j), yi = Load(bi + j);
+                vec4 dr = Sub(xr, yr), di = Sub(xi, yi);
+                vec4 cr = Load(wr + j), ci = Load(wi + j);
+
+                Store(ar + j, Add(xr, yr));
+                Store(ai + j, Add(xi, yi));
+                Store(br + j, Sub(Mul(dr, cr), Mul(di, ci)));
+                Store(bi + j, Add(Mul(dr, ci), Mul(di, cr)));
+            }
+        }
+        twiddle += span;
+    }
+
+    /* Spans two and one together; the twiddles are 1 and -i */
+    for (size_t base = 0; base < n; base += 4) {
+        float *r = re + base, *i = im + base;
+
+        float r0 = r[0] + r[2], i0 = i[0] + i[2];
+        float r2 = r[0] - r[2], i2 = i[0] - i[2];
+        float r1 = r[1] + r[3], i1 = i[1] + i[3];
+        float r3 = i[1] - i[3], i3 = r[3] - r[1];
+
+        r[0] = r0 + r1;
+        i[0] = i0 + i1;
+        r[1] = r0 - r1;
+        i[1] = i0 - i1;
+        r[2] = r2 + r3;
+        i[2] = i2 + i3;
+        r[3] = r2 - r3;
+        i[3] = i2 - i3;
+    }
+
+    for (size_t j = 0; j < n; j++) {
+        size_t k = reverse_[j];
+        if (j < k) {
+            std::swap(re[j], re[k]);
+            std::swap(im[j], im[k]);
+        }
+    }
+}
+
+void Fft::Forward(const float *in, float *re, float *im)
+{
+    const size_t n = half_;
+    float *zr = work_re_, *zi = work_im_;
+
+    for (size_t j = 0; j < n; j++) {
+        zr[j] = in[2 * j];
+        zi[j] = in[2 * j + 1];
+    }
+
+    Transform(zr, zi);
+
+    /* Split the spectra of the even and odd samples, then merge them */
+    re[0] = zr[0] + zi[0];
+    im[0] = 0;
+    re[n] = zr[0] - zi[0];
+    im[n] = 0;
+
+    for (size_t k = 1; k < n; k++) {
+        float ar = zr[k], ai = zi[k];
+        float br = zr[n - k], bi = -zi[n - k];
+        float er = (ar + br) * 0.5f, ei = (ai + bi) * 0.5f;
+        float odd_r = (ai - bi) * 0.5f, odd_i = (br - ar) * 0.5f;
+        float c = split_re_[k], s = split_im_[k];
+
+        re[k] = er + (c * odd_r - s * odd_i);
+        im[k] = ei + (c * odd_i + s * odd_r);
+    }
+}
+
+void Fft::Inverse(const float *re, const float *im, float *out)
+{
+    const size_t n = half_;
+    float *zr = work_re_, *zi = work_im_;
+
+    for (size_t k = 0; k < n; k++) {
+        float ar = re[k], ai = im[k];
+        float br = re[n - k], bi = -im[n - k];
+        float er = (ar + br) * 0.5f, ei = (ai + bi) * 0.5f;
+        float dr = (ar - br) * 0.5f, di = (ai - bi) * 0.5f;
+        float c = split_re_[k], s = split_im_[k];
+
+        zr[k] = er - (di * c - dr * s);
+        zi[k] = ei + (dr * c + di * s);
+    }
+
+    /* With real and imaginary swapped the forward transform runs backwards */
+    Transform(zi, zr);
+
+    const float scale = 1.0f / n;
+    for (size_t j = 0; j < n; j++) {
+        out[2 * j] = zr[j] * scale;
+        out[2 * j + 1] = zi[j] * scale;
+    }
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * Real FFT of a power of two size up to kMaxSize, through a complex FFT
+ * of half the size. Spectra are split into real and imaginary arrays of
+ * bins() values, DC to Nyquist, which suits vector code working on four
+ * bins at a time.
+ *
+ * The complex FFT is radix 2 and decimates in frequency. Every stage
+ * with a butterfly span of four or more runs on vec4, the last two run
+ * together in scalar code, and a table undoes the bit reversal. All
+ * tables live in the object, so nothing allocates after Configure().
+ */
+class Fft
+{
+public:
+    static constexpr size_t kMinSize = 32;
+    static constexpr size_t kMaxSize = 1024;
+    static constexpr size_t kMaxBins = kMaxSize / 2 + 1;
+
+    Fft();
+
+    /* @size is a power of two from kMinSize to kMaxSize */
+    bool Configure(size_t size);
+
+    size_t size() const { return size_; }
+    size_t bins() const { return size_ / 2 + 1; }
+
+    /* @in holds size() samples; unscaled */
+    void Forward(const float *in, float *re, float *im);
+
+    /* The inverse of Forward(), including the 1 / size() scaling */
+    void Inverse(const float *re, const float *im, float *out);
+
+private:
+    /* In place on split complex data of half_ points, @re and @im aligned */
+    void Transform(float *re, float *im);
+
+    size_t size_;
+    size_t half_;
+
+    /* Twiddles of the vector stages, one run per stage, longest first */
+    alignas(16) float stage_re_[kMaxSize / 2];
+    alignas(16) float stage_im_[kMaxSize / 2];
+
+    /* exp(-2 pi i k / size) for the real split and merge */
+    float split_re_[kMaxSize / 2];
+    float split_im_[kMaxSize / 2];
+
+    uint16_t reverse_[kMaxSize / 2];
+
+    alignas(16) float work_re_[kMaxSize / 2];
+    alignas(16) float work_im_[kMaxSize / 2];
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
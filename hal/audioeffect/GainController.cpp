@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "GainController.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+static constexpr float kSilenceDb = -70;
+
+/* Speech stands this far above the noise floor, which rises at most this much a frame */
+static constexpr float kSpeechMarginDb = 10;
+static constexpr float kFloorRiseDb = 0.05f;
+
+/* Peak level tracking, per speech frame */
+static constexpr float kLevelAttack = 0.2f;
+static constexpr float kLevelRelease = 0.02f;
+
+/* Gain slew per frame, and the most it cuts loud speech by */
+static constexpr float kGainFallDb = 0.5f;
+static constexpr float kGainRiseDb = 0.05f;
+static constexpr float kMaxCutDb = 12;
+
+GainController::GainController()
+    : target_db_(-3),
+      max_gain_db_(9),
+      limiter_(true)
+{
+    Reset();
+}
+
+void GainController::Reset()
+{
+    floor_db_ = -60;
+    level_db_ = target_db_;
+    gain_db_ = 0;
+    gain_ = 1;
+}
+
+void GainController::Set(float target_db, float max_gain_db, bool limiter)
+{
+    target_db_ = target_db;
+    max_gain_db_ = max_gain_db;
+    limiter_ = limiter;
+}
+
+void GainController::Process(float *data, size_t frames)
+{
+    if (frames == 0)
+        return;
+
+    float peak = 0, energy = 0;
+    for (size_t i = 0; i < frames; i++) {
+        peak = std::max(peak, fabsf(data[i]));
+        energy += data[i] * data[i];
+    }
+
+    float rms_db = 10 * log10f(energy / frames + 1e-12f);
+    float peak_db = 20 * log10f(peak + 1e-9f);
+
+    if (rms_db < floor_db_)
+        floor_db_ = rms_db;
+    else
+        floor_db_ += kFloorRiseDb;
+
+    if (rms_db > kSilenceDb && rms_db > floor_db_ + kSpeechMarginDb) {
+        level_db_ += (peak_db - level_db_) * (peak_db > level_db_ ? kLevelAttack : kLevelRelease);
+
+        float desired = std::min(std::max(target_db_ - level_db_, -kMaxCutDb), max_gain_db_);
+        if (desired < gain_db_)
+            gain_db_ = std::max(desired, gain_db_ - kGainFallDb);
+        else
+            gain_db_ = std::min(desired, gain_db_ + kGainRiseDb);
+    }
+
+    float start = gain_;
+    float end = powf(10, gain_db_ / 20);
+    if (limiter_ && peak > 0) {
+        float limit = powf(10, kLimitDb / 20) / peak;
+        start = std::min(start, limit);
+        end = std::min(end, limit);
+    }
+
+    float step = (end - start) / frames;
+    for (size_t i = 0; i < frames; i++)
+        data[i] *= start + step * (i + 1);
+
+    gain_ = end;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * Automatic gain control on the finished frames of VoiceProcessor.
+ *
+ * Frames are classed as speech when their level stands clear of a
+ * tracked noise floor, and only speech moves the estimate of the speech
+ * peak level. The gain heads for the one that puts those peaks at the
+ * target, limited to the compression gain, falling fast and rising
+ * slowly; it ramps across each frame. With the limiter on, a frame whose
+ * peak would pass kLimitDb is brought down to it at once.
+ */
+class GainController
+{
+public:
+    static constexpr float kLimitDb = -1;
+
+    GainController();
+
+    void Reset();
+
+    void Set(float target_db, float max_gain_db, bool limiter);
+
+    void Process(float *data, size_t frames);
+
+private:
+    float target_db_;
+    float max_gain_db_;
+    bool limiter_;
+
+    float floor_db_;
+    float level_db_;
+    float gain_db_;
+    float gain_;            /* linear, as applied at the end of the last frame */
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Loudness.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+Loudness::Loudness(const effect_descriptor_t& descriptor)
+    : Effect(descriptor),
+      strength_(kDefaultStrength),
+      attenuation_db_(0)
+{
+}
+
+int Loudness::GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id) || id != LOUDNESS_PARAM_STRENGTH)
+        return -EINVAL;
+
+    return Write(value, vsize, strength_);
+}
+
+int Loudness::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                           uint32_t vsize)
+{
+    int32_t id;
+    int16_t strength;
+
+    if (!Read(param, psize, 0, &id) || id != LOUDNESS_PARAM_STRENGTH ||
+        !Read(value, vsize, 0, &strength))
+        return -EINVAL;
+
+    strength_ = std::min(std::max<int16_t>(strength, 0), kMaxStrength);
+    return 0;
+}
+
+bool Loudness::SetVolume(float left, float right)
+{
+    float volume = std::max(left, right);
+    double attenuation = volume > 0 ? -20 * log10(volume) : kMaxAttenuationDb;
+
+    attenuation = std::min(std::max(attenuation, 0.0), kMaxAttenuationDb);
+    attenuation = round(attenuation * 2) / 2;
+    if (attenuation == attenuation_db_)
+        return false;
+
+    attenuation_db_ = attenuation;
+    return true;
+}
+
+void Loudness::Commit(uint32_t sample_rate, size_t channels)
+{
+    double amount = (double)strength_ / kMaxStrength * attenuation_db_ / kMaxAttenuationDb;
+    BiquadCoefficients sections[2] = {
+        BiquadCoefficients::LowShelf(sample_rate, kBassHz, M_SQRT1_2, kMaxBassDb * amount),
+        BiquadCoefficients::HighShelf(sample_rate, kTrebleHz, M_SQRT1_2, kMaxTrebleDb * amount),
+    };
+
+    cascade_.SetChannels(channels);
+    cascade_.SetSections(sections, 2);
+}
+
+void Loudness::Reset()
+{
+    cascade_.Reset();
+}
+
+bool Loudness::IsActive() const
+{
+    return !cascade_.IsIdentity();
+}
+
+void Loudness::ProcessPlanar(float * const *data, size_t frames)
+{
+    cascade_.Process(data, frames);
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
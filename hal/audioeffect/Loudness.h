@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "BiquadCascade.h"
+#include "Effect.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* Parameters of the loudness effect, vendor type 94506109-e722-4408-8144-f1eafba72289 */
+enum {
+    LOUDNESS_PARAM_STRENGTH = 0,        /* int16_t, 0 .. 1000 */
+};
+
+/*
+ * Loudness compensation: the ear loses bass, and to a lesser degree
+ * treble, faster than midrange as the level drops. The volume the
+ * framework applies after the effect (EFFECT_FLAG_VOLUME_IND) sets how
+ * far below full scale playback is. Over the first kMaxAttenuationDb
+ * of it a low shelf at kBassHz and a high shelf at kTrebleHz rise
+ * towards kMaxBassDb and kMaxTrebleDb, scaled by the strength. At full
+ * volume, or at strength 0, nothing is processed. The attenuation is
+ * taken in 0.5 dB steps, so a volume ramp does not rebuild the
+ * coefficients on every buffer.
+ */
+class Loudness : public Effect
+{
+public:
+    static constexpr int16_t kMaxStrength = 1000;
+    static constexpr int16_t kDefaultStrength = 500;
+    static constexpr double kBassHz = 100;
+    static constexpr double kTrebleHz = 10000;
+    static constexpr double kMaxBassDb = 10;
+    static constexpr double kMaxTrebleDb = 4;
+    static constexpr double kMaxAttenuationDb = 40;
+
+    explicit Loudness(const effect_descriptor_t& descriptor);
+
+protected:
+    int GetParameter(const int32_t *param, uint32_t psize, void *value, uint32_t *vsize) override;
+    int SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                     uint32_t vsize) override;
+    bool SetVolume(float left, float right) override;
+
+    void Commit(uint32_t sample_rate, size_t channels) override;
+    void Reset() override;
+    bool IsActive() const override;
+    void ProcessPlanar(float * const *data, size_t frames) override;
+
+private:
+    /* Control side */
+    int16_t strength_;
+    double attenuation_db_;
+
+    BiquadCascade cascade_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
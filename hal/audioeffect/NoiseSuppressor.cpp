@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utility>
+
+#include <audio_effects/effect_ns.h>
+
+#include "NoiseSuppressor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* Gain floor of each NS_LEVEL_* */
+static constexpr float kLevelFloors[] = {
+    0.5f,                               /* -6 dB */
+    0.25f,                              /* -12 dB */
+    0.125f,                             /* -18 dB */
+};
+
+NoiseSuppressor::NoiseSuppressor(const effect_descriptor_t& descriptor,
+                                 std::shared_ptr<VoiceProcessor> processor)
+    : PreProcessor(descriptor, VoiceProcessor::kNoiseSuppressor, std::move(processor)),
+      level_(NS_LEVEL_MEDIUM)
+{
+    this->processor().SetNoiseFloor(kLevelFloors[level_]);
+}
+
+int NoiseSuppressor::GetParameter(const int32_t *param, uint32_t psize, void *value,
+                                  uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case NS_PARAM_LEVEL:
+        return Write(value, vsize, level_);
+
+    case NS_PARAM_TYPE:
+        return Write(value, vsize, (uint32_t)NS_TYPE_SINGLE_CHANNEL);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int NoiseSuppressor::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                                  uint32_t vsize)
+{
+    int32_t id;
+    uint32_t arg;
+
+    if (!Read(param, psize, 0, &id) || !Read(value, vsize, 0, &arg))
+        return -EINVAL;
+
+    switch (id) {
+    case NS_PARAM_LEVEL:
+        if (arg > NS_LEVEL_HIGH)
+            return -EINVAL;
+        level_ = arg;
+        processor().SetNoiseFloor(kLevelFloors[level_]);
+        return 0;
+
+    case NS_PARAM_TYPE:
+        return arg == NS_TYPE_SINGLE_CHANNEL ? 0 : -EINVAL;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
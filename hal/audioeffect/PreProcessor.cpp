@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <utility>
+
+#include "PreProcessor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+PreProcessor::PreProcessor(const effect_descriptor_t& descriptor, VoiceProcessor::Stage stage,
+                           std::shared_ptr<VoiceProcessor> processor, bool reverse)
+    : Effect(descriptor, reverse),
+      stage_(stage),
+      processor_(std::move(processor)),
+      channels_(1)
+{
+}
+
+PreProcessor::~PreProcessor()
+{
+    processor_->SetEnabled(stage_, false);
+}
+
+bool PreProcessor::SupportsRate(uint32_t sample_rate) const
+{
+    return VoiceProcessor::SupportsRate(sample_rate);
+}
+
+void PreProcessor::OnEnable(bool enabled)
+{
+    processor_->SetEnabled(stage_, enabled);
+}
+
+void PreProcessor::Commit(uint32_t sample_rate, size_t channels)
+{
+    processor_->SetSampleRate(sample_rate);
+    channels_ = channels;
+}
+
+void PreProcessor::Reset()
+{
+    processor_->RequestReset(stage_);
+}
+
+bool PreProcessor::IsActive() const
+{
+    return processor_->IsLead(stage_);
+}
+
+void PreProcessor::ProcessPlanar(float * const *data, size_t frames)
+{
+    if (channels_ == 2) {
+        for (size_t i = 0; i < frames; i++)
+            data[0][i] = (data[0][i] + data[1][i]) * 0.5f;
+    }
+
+    processor_->Process(data[0], frames);
+
+    if (channels_ == 2)
+        memcpy(data[1], data[0], frames * sizeof(float));
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
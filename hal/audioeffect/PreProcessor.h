@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "Effect.h"
+#include "VoiceProcessor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * One stage of the VoiceProcessor of a capture stream, as an effect.
+ * The effects of a stream share the processor; each keeps its stage
+ * enabled while it is, and hands its settings over as they are set.
+ * The lead stage runs the processor on the mix of the channels and
+ * writes the result to all of them; the others copy.
+ */
+class PreProcessor : public Effect
+{
+public:
+    PreProcessor(const effect_descriptor_t& descriptor, VoiceProcessor::Stage stage,
+                 std::shared_ptr<VoiceProcessor> processor, bool reverse = false);
+    ~PreProcessor() override;
+
+protected:
+    bool SupportsRate(uint32_t sample_rate) const override;
+    void OnEnable(bool enabled) override;
+
+    void Commit(uint32_t sample_rate, size_t channels) override;
+    void Reset() override;
+    bool IsActive() const override;
+    void ProcessPlanar(float * const *data, size_t frames) override;
+
+    VoiceProcessor& processor() { return *processor_; }
+
+private:
+    const VoiceProcessor::Stage stage_;
+    const std::shared_ptr<VoiceProcessor> processor_;
+
+    size_t channels_;                   /* audio side */
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
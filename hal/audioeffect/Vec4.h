@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * Four float lanes for the kernels of this library. Load() and Store()
+ * take 16-byte aligned pointers. ShiftIn(x, v) is { x, v[0], v[1], v[2] }.
+ * Only plain multiplies and adds are offered, so with FP contraction off
+ * a kernel computes exactly what its scalar form does.
+ */
+#if defined(__ARM_NEON)
+typedef float32x4_t vec4;
+
+static inline vec4 Load(const float *p) { return vld1q_f32(p); }
+static inline void Store(float *p, vec4 v) { vst1q_f32(p, v); }
+static inline vec4 Dup(float x) { return vdupq_n_f32(x); }
+static inline vec4 Add(vec4 a, vec4 b) { return vaddq_f32(a, b); }
+static inline vec4 Sub(vec4 a, vec4 b) { return vsubq_f32(a, b); }
+static inline vec4 Mul(vec4 a, vec4 b) { return vmulq_f32(a, b); }
+static inline vec4 ShiftIn(float x, vec4 v) { return vextq_f32(vdupq_n_f32(x), v, 3); }
+static inline float Last(vec4 v) { return vgetq_lane_f32(v, 3); }
+#elif defined(__SSE2__)
+typedef __m128 vec4;
+
+static inline vec4 Load(const float *p) { return _mm_load_ps(p); }
+static inline void Store(float *p, vec4 v) { _mm_store_ps(p, v); }
+static inline vec4 Dup(float x) { return _mm_set1_ps(x); }
+static inline vec4 Add(vec4 a, vec4 b) { return _mm_add_ps(a, b); }
+static inline vec4 Sub(vec4 a, vec4 b) { return _mm_sub_ps(a, b); }
+static inline vec4 Mul(vec4 a, vec4 b) { return _mm_mul_ps(a, b); }
+static inline vec4 ShiftIn(float x, vec4 v)
+{
+    return _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), _mm_set_ss(x));
+}
+static inline float Last(vec4 v)
+{
+    return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+#else
+struct vec4 { float f[4]; };
+
+static inline vec4 Load(const float *p) { vec4 v; memcpy(v.f, p, sizeof(v.f)); return v; }
+static inline void Store(float *p, vec4 v) { memcpy(p, v.f, sizeof(v.f)); }
+static inline vec4 Dup(float x) { return { { x, x, x, x } }; }
+static inline vec4 Add(vec4 a, vec4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.f[i] += b.f[i];
+    return a;
+}
+static inline vec4 Sub(vec4 a, vec4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.f[i] -= b.f[i];
+    return a;
+}
+static inline vec4 Mul(vec4 a, vec4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.f[i] *= b.f[i];
+    return a;
+}
+static inline vec4 ShiftIn(float x, vec4 v) { return { { x, v.f[0], v.f[1], v.f[2] } }; }
+static inline float Last(vec4 v) { return v.f[3]; }
+#endif
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
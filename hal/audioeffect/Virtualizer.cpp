@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include <audio_effects/effect_virtualizer.h>
+
+#include "Virtualizer.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+Virtualizer::Virtualizer(const effect_descriptor_t& descriptor)
+    : Effect(descriptor),
+      strength_(0),
+      channels_(0)
+{
+}
+
+int Virtualizer::GetParameter(const int32_t *param, uint32_t psize, void *value,
+                              uint32_t *vsize)
+{
+    int32_t id;
+
+    if (!Read(param, psize, 0, &id))
+        return -EINVAL;
+
+    switch (id) {
+    case VIRTUALIZER_PARAM_STRENGTH_SUPPORTED:
+        return Write(value, vsize, (uint32_t)1);
+
+    case VIRTUALIZER_PARAM_STRENGTH:
+        return Write(value, vsize, strength_);
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int Virtualizer::SetParameter(const int32_t *param, uint32_t psize, const void *value,
+                              uint32_t vsize)
+{
+    int32_t id;
+    int16_t strength;
+
+    if (!Read(param, psize, 0, &id) || id != VIRTUALIZER_PARAM_STRENGTH ||
+        !Read(value, vsize, 0, &strength))
+        return -EINVAL;
+
+    strength_ = std::min(std::max<int16_t>(strength, 0), kMaxStrength);
+    return 0;
+}
+
+void Virtualizer::Commit(uint32_t sample_rate, size_t channels)
+{
+    double gain_db = kMaxWideningDb * strength_ / kMaxStrength;
+    BiquadCoefficients shelf = BiquadCoefficients::HighShelf(sample_rate, kShelfHz, M_SQRT1_2,
+                                                             gain_db);
+
+    channels_ = channels;
+    side_cascade_.SetSections(&shelf, 1);
+}
+
+void Virtualizer::Reset()
+{
+    side_cascade_.Reset();
+}
+
+bool Virtualizer::IsActive() const
+{
+    return channels_ == 2 && !side_cascade_.IsIdentity();
+}
+
+void Virtualizer::ProcessPlanar(float * const *data, size_t frames)
+{
+    float *left = data[0];
+    float *right = data[1];
+    float *side = side_;
+
+    /* Mid into the left channel, side into the scratch */
+    for (size_t i = 0; i < frames; i++) {
+        float l = left[i], r = right[i];
+        left[i] = 0.5f * (l + r);
+        side[i] = 0.5f * (l - r);
+    }
+
+    side_cascade_.Process(&side, frames);
+
+    for (size_t i = 0; i < frames; i++) {
+        float mid = left[i];
+        left[i] = mid + side[i];
+        right[i] = mid - side[i];
+    }
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "Vec4.h"
+#include "VoiceProcessor.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+/* Far-end power per sample below which the echo canceller does not adapt, -70 dBFS */
+static constexpr float kFarFloor = 1e-7f;
+#endif
+
+bool VoiceProcessor::SupportsRate(uint32_t sample_rate)
+{
+    return sample_rate >= kMinRate && sample_rate <= kMaxRate && sample_rate % 100 == 0;
+}
+
+size_t VoiceProcessor::Latency(uint32_t sample_rate)
+{
+    size_t frame = sample_rate / 100;
+    return frame + frame * 3 / 5;
+}
+
+VoiceProcessor::VoiceProcessor()
+    : enabled_(0),
+      sample_rate_(0),
+#if defined(ROCKCHIP_EFFECTS_AEC)
+      echo_delay_us_(0),
+#endif
+      noise_floor_(1),
+      target_db_(-3),
+      max_gain_db_(9),
+      limiter_(true),
+      reset_(0),
+#if defined(ROCKCHIP_EFFECTS_AEC)
+      reverse_write_(0),
+      reverse_read_(0),
+#endif
+      rate_(0),
+      frame_(0),
+      overlap_(0),
+      bins_(0),
+      fill_(0)
+{
+    memset(near_re_, 0, sizeof(near_re_));
+    memset(near_im_, 0, sizeof(near_im_));
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    memset(echo_re_, 0, sizeof(echo_re_));
+    memset(echo_im_, 0, sizeof(echo_im_));
+#endif
+    memset(gain_, 0, sizeof(gain_));
+}
+
+void VoiceProcessor::SetEnabled(Stage stage, bool enabled)
+{
+    if (enabled)
+        enabled_.fetch_or(1u << stage, std::memory_order_relaxed);
+    else
+        enabled_.fetch_and(~(1u << stage), std::memory_order_relaxed);
+}
+
+bool VoiceProcessor::IsLead(Stage stage) const
+{
+    uint32_t enabled = enabled_.load(std::memory_order_relaxed);
+    return (enabled & (1u << stage)) != 0 && (enabled & ((1u << stage) - 1)) == 0;
+}
+
+void VoiceProcessor::SetSampleRate(uint32_t sample_rate)
+{
+    sample_rate_.store(sample_rate, std::memory_order_relaxed);
+}
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+void VoiceProcessor::SetEchoDelay(uint32_t delay_us)
+{
+    echo_delay_us_.store(delay_us, std::memory_order_relaxed);
+}
+#endif
+
+void VoiceProcessor::SetNoiseFloor(float floor)
+{
+    noise_floor_.store(floor, std::memory_order_relaxed);
+}
+
+void VoiceProcessor::SetGain(float target_db, float max_gain_db, bool limiter)
+{
+    target_db_.store(target_db, std::memory_order_relaxed);
+    max_gain_db_.store(max_gain_db, std::memory_order_relaxed);
+    limiter_.store(limiter, std::memory_order_relaxed);
+}
+
+void VoiceProcessor::RequestReset(Stage stage)
+{
+    reset_.fetch_or(1u << stage, std::memory_order_relaxed);
+}
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+void VoiceProcessor::PushReverse(const float *data, size_t frames)
+{
+    size_t write = reverse_write_.load(std::memory_order_relaxed);
+    size_t read = reverse_read_.load(std::memory_order_acquire);
+
+    /* When the ring is full the newest samples are the ones lost */
+    frames = std::min(frames, kReverseCapacity - (write - read));
+
+    size_t start = write % kReverseCapacity;
+    size_t first = std::min(frames, kReverseCapacity - start);
+    memcpy(reverse_ + start, data, first * sizeof(float));
+    memcpy(reverse_, data + first, (frames - first) * sizeof(float));
+
+    reverse_write_.store(write + frames, std::memory_order_release);
+}
+
+void VoiceProcessor::PullReverse()
+{
+    size_t write = reverse_write_.load(std::memory_order_acquire);
+    size_t read = reverse_read_.load(std::memory_order_relaxed);
+    float *dst = far_;
+
+    /*
+     * The far end should lead capture by no more than the host's
+     * buffering. If it has piled up, say because capture started late,
+     * keep only the newest frame so the echo path stays within the taps.
+     */
+    if (write - read > (kReverseSlackFrames + 1) * frame_)
+        read = write - frame_;
+
+    size_t frames = std::min(write - read, frame_);
+    size_t start = read % kReverseCapacity;
+    size_t first = std::min(frames, kReverseCapacity - start);
+    memcpy(dst, reverse_ + start, first * sizeof(float));
+    memcpy(dst + first, reverse_, (frames - first) * sizeof(float));
+    memset(dst + frames, 0, (frame_ - frames) * sizeof(float));
+
+    reverse_read_.store(read + frames, std::memory_order_release);
+}
+#endif
+
+void VoiceProcessor::Configure(uint32_t sample_rate)
+{
+    rate_ = SupportsRate(sample_rate) ? sample_rate : 0;
+    if (rate_ == 0)
+        return;
+
+    frame_ = rate_ / 100;
+    overlap_ = frame_ * 3 / 5;
+
+    size_t size = Fft::kMinSize;
+    while (size < frame_ + overlap_)
+        size *= 2;
+    fft_.Configure(size);
+    bins_ = fft_.bins();
+
+    for (size_t i = 0; i < overlap_; i++) {
+        window_[i] = sin(M_PI * (i + 0.5) / (2 * overlap_));
+        window_[frame_ + i] = cos(M_PI * (i + 0.5) / (2 * overlap_));
+    }
+    for (size_t i = overlap_; i < frame_; i++)
+        window_[i] = 1;
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    echo_.Configure(frame_, bins_, kFarFloor);
+#endif
+    noise_.Configure(bins_);
+    agc_.Reset();
+
+    fill_ = 0;
+    memset(near_, 0, sizeof(near_));
+    memset(out_, 0, sizeof(out_));
+    memset(tail_, 0, sizeof(tail_));
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    memset(estimate_, 0, sizeof(estimate_));
+    memset(far_, 0, sizeof(far_));
+    reverse_read_.store(reverse_write_.load(std::memory_order_acquire),
+                        std::memory_order_release);
+#endif
+}
+
+void VoiceProcessor::Analyse(const float *input, float *re, float *im)
+{
+    const size_t length = frame_ + overlap_;
+
+    for (size_t i = 0; i < length; i++)
+        time_[i] = input[i] * window_[i];
+    memset(time_ + length, 0, (fft_.size() - length) * sizeof(float));
+
+    fft_.Forward(time_, re, im);
+}
+
+void VoiceProcessor::RunFrame()
+{
+    const uint32_t enabled = enabled_.load(std::memory_order_relaxed);
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    const bool echo = (enabled & (1u << kEchoCanceller)) != 0;
+#else
+    const bool echo = false;
+#endif
+    const bool noise = (enabled & (1u << kNoiseSuppressor)) != 0;
+    const bool agc = (enabled & (1u << kGainController)) != 0;
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    PullReverse();
+
+    if (echo)
+        echo_.Process(far_, near_ + overlap_, estimate_ + overlap_);
+    else
+        memset(estimate_ + overlap_, 0, frame_ * sizeof(float));
+#endif
+
+    if (echo || noise) {
+        Analyse(near_, near_re_, near_im_);
+        std::fill(gain_, gain_ + bins_, 1.0f);
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+        if (echo) {
+            Analyse(estimate_, echo_re_, echo_im_);
+            echo_.Suppress(near_re_, near_im_, echo_re_, echo_im_, gain_);
+        }
+#endif
+        if (noise)
+            noise_.Process(near_re_, near_im_, gain_);
+
+        for (size_t k = 0; k < bins_; k += 4) {
+            vec4 g = Load(gain_ + k);
+            Store(near_re_ + k, Mul(Load(near_re_ + k), g));
+            Store(near_im_ + k, Mul(Load(near_im_ + k), g));
+        }
+
+        fft_.Inverse(near_re_, near_im_, time_);
+        for (size_t i = 0; i < frame_; i++)
+            out_[i] = time_[i] * window_[i];
+        for (size_t i = 0; i < overlap_; i++) {
+            out_[i] += tail_[i];
+            tail_[i] = time_[frame_ + i] * window_[frame_ + i];
+        }
+    } else {
+        /* What the transforms give with unit gains */
+        for (size_t i = 0; i < frame_; i++)
+            out_[i] = near_[i] * window_[i] * window_[i];
+        for (size_t i = 0; i < overlap_; i++) {
+            out_[i] += tail_[i];
+            tail_[i] = near_[frame_ + i] * window_[frame_ + i] * window_[frame_ + i];
+        }
+    }
+
+    if (agc)
+        agc_.Process(out_, frame_);
+
+    memmove(near_, near_ + frame_, overlap_ * sizeof(float));
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    memmove(estimate_, estimate_ + frame_, overlap_ * sizeof(float));
+#endif
+}
+
+bool VoiceProcessor::Process(float *data, size_t frames)
+{
+    std::unique_lock<std::mutex> lock(lock_, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    uint32_t sample_rate = sample_rate_.load(std::memory_order_relaxed);
+    if (sample_rate != rate_)
+        Configure(sample_rate);
+    if (rate_ == 0)
+        return false;
+
+    uint32_t reset = reset_.exchange(0, std::memory_order_relaxed);
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    if (reset & (1u << kEchoCanceller))
+        echo_.Reset();
+#endif
+    if (reset & (1u << kNoiseSuppressor))
+        noise_.Reset();
+    if (reset & (1u << kGainController))
+        agc_.Reset();
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    echo_.SetDelay(echo_delay_us_.load(std::memory_order_relaxed) / 10000);
+#endif
+    noise_.SetFloor(noise_floor_.load(std::memory_order_relaxed));
+    agc_.Set(target_db_.load(std::memory_order_relaxed),
+             max_gain_db_.load(std::memory_order_relaxed),
+             limiter_.load(std::memory_order_relaxed));
+
+    for (size_t done = 0; done < frames;) {
+        size_t n = std::min(frames - done, frame_ - fill_);
+
+        /* Input first: @data is also the output */
+        memcpy(near_ + overlap_ + fill_, data + done, n * sizeof(float));
+        memcpy(data + done, out_ + fill_, n * sizeof(float));
+
+        fill_ += n;
+        done += n;
+        if (fill_ == frame_) {
+            RunFrame();
+            fill_ = 0;
+        }
+    }
+
+    return true;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <mutex>
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+#include "EchoCanceller.h"
+#endif
+#include "Fft.h"
+#include "GainController.h"
+#include "WienerFilter.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * The voice pre-processing of one capture stream, shared by its echo
+ * canceller, noise suppressor and AGC effects.
+ *
+ * Capture is cut into 10 ms frames of N samples. Each frame is analysed
+ * together with the last L = 3N/5 samples of the one before, under a
+ * window that rises over L samples, stays flat and falls over L, so the
+ * squared windows of neighbouring frames add up to one. The echo
+ * canceller takes its estimate out of each frame as it arrives, and
+ * residual echo and noise suppression work on the spectrum; the frame
+ * is resynthesised, overlap-added, and AGC runs on the N finished
+ * samples. Output lags input by exactly N + L samples, 16 ms, however
+ * the host sizes its buffers, and whichever stages are on.
+ *
+ * Only one effect of the stream, the lead, processes: the first enabled
+ * stage in Stage order. The others pass audio through, so the chain
+ * runs every stage once whatever order the framework calls it in.
+ *
+ * Settings are atomics that any thread may set, and the processing
+ * thread picks them up at each frame. The far end comes from another
+ * thread through a single-producer ring. All buffers are part of the
+ * object, sized for 48 kHz, so nothing allocates once it exists.
+ *
+ * The echo canceller stage, with its far end and filter state, is only
+ * built with ROCKCHIP_EFFECTS_AEC; without it a processor is NS and AGC.
+ */
+class VoiceProcessor
+{
+public:
+    enum Stage {
+        kEchoCanceller,
+        kNoiseSuppressor,
+        kGainController,
+        kStageCount,
+    };
+
+    static constexpr uint32_t kMinRate = 8000;
+    static constexpr uint32_t kMaxRate = 48000;
+    static constexpr size_t kMaxFrame = kMaxRate / 100;
+    static constexpr size_t kMaxOverlap = kMaxFrame * 3 / 5;
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    /* Far end held beyond the frame being processed before the oldest is dropped */
+    static constexpr size_t kReverseSlackFrames = 4;
+#endif
+
+    /* 10 ms must be whole samples */
+    static bool SupportsRate(uint32_t sample_rate);
+    static size_t Latency(uint32_t sample_rate);
+
+    VoiceProcessor();
+
+    /* Control side, any thread */
+    void SetEnabled(Stage stage, bool enabled);
+    bool IsLead(Stage stage) const;
+    void SetSampleRate(uint32_t sample_rate);
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    void SetEchoDelay(uint32_t delay_us);
+#endif
+    void SetNoiseFloor(float floor);
+    void SetGain(float target_db, float max_gain_db, bool limiter);
+    void RequestReset(Stage stage);
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    /* Far-end thread: mono, at the capture rate */
+    void PushReverse(const float *data, size_t frames);
+#endif
+
+    /*
+     * Lead's thread: mono, in place. Returns false, leaving @data alone,
+     * when not configured or while another thread is processing.
+     */
+    bool Process(float *data, size_t frames);
+
+private:
+    static constexpr size_t kMaxWindow = kMaxFrame + kMaxOverlap;
+    static constexpr size_t kPaddedBins = (Fft::kMaxBins + 3) & ~3;
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    static constexpr size_t kReverseCapacity = 8192;
+    static_assert(kReverseCapacity >= (kReverseSlackFrames + 2) * kMaxFrame,
+                  "the reverse ring does not hold the slack");
+    static_assert(kMaxFrame <= EchoCanceller::kMaxFrame, "frames too long for the echo canceller");
+    static_assert(kPaddedBins <= EchoCanceller::kPaddedBins, "spectra too long for the echo canceller");
+#endif
+
+    void Configure(uint32_t sample_rate);
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    void PullReverse();
+#endif
+    void Analyse(const float *input, float *re, float *im);
+    void RunFrame();
+
+    /* Control side */
+    std::atomic<uint32_t> enabled_;
+    std::atomic<uint32_t> sample_rate_;
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    std::atomic<uint32_t> echo_delay_us_;
+#endif
+    std::atomic<float> noise_floor_;
+    std::atomic<float> target_db_;
+    std::atomic<float> max_gain_db_;
+    std::atomic<bool> limiter_;
+    std::atomic<uint32_t> reset_;
+
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    /* Far end, written by PushReverse() */
+    std::atomic<size_t> reverse_write_;
+    std::atomic<size_t> reverse_read_;
+    float reverse_[kReverseCapacity];
+#endif
+
+    /* Processing side */
+    std::mutex lock_;
+    uint32_t rate_;
+    size_t frame_;
+    size_t overlap_;
+    size_t bins_;
+    size_t fill_;
+
+    float window_[kMaxWindow];
+    float near_[kMaxWindow];
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    float estimate_[kMaxWindow];        /* echo estimate, windowed as near_ */
+    float far_[kMaxFrame];
+#endif
+    float out_[kMaxFrame];
+    float tail_[kMaxOverlap];
+
+    alignas(16) float time_[Fft::kMaxSize];
+    alignas(16) float near_re_[kPaddedBins];
+    alignas(16) float near_im_[kPaddedBins];
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    alignas(16) float echo_re_[kPaddedBins];
+    alignas(16) float echo_im_[kPaddedBins];
+#endif
+    alignas(16) float gain_[kPaddedBins];
+
+    Fft fft_;
+#if defined(ROCKCHIP_EFFECTS_AEC)
+    EchoCanceller echo_;
+#endif
+    WienerFilter noise_;
+    GainController agc_;
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
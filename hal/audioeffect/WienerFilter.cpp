@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "WienerFilter.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/* Recursive smoothing of the power spectrum */
+static constexpr float kSmoothing = 0.7f;
+
+/* Minimum tracking after Doblinger: how fast the estimate may rise */
+static constexpr float kRise = 0.998f;
+static constexpr float kLag = 0.96f;
+
+/* A minimum sits below the mean of the noise */
+static constexpr float kBias = 1.2f;
+
+/* Weight of the last frame in the a priori SNR */
+static constexpr float kDecisionDirected = 0.98f;
+
+WienerFilter::WienerFilter()
+    : bins_(0),
+      floor_(1)
+{
+    Reset();
+}
+
+void WienerFilter::Configure(size_t bins)
+{
+    bins_ = std::min(bins, Fft::kMaxBins);
+    Reset();
+}
+
+void WienerFilter::Reset()
+{
+    frames_ = 0;
+    memset(smoothed_, 0, sizeof(smoothed_));
+    memset(noise_, 0, sizeof(noise_));
+    memset(previous_, 0, sizeof(previous_));
+}
+
+void WienerFilter::Process(const float *re, const float *im, float *gain)
+{
+    const bool learning = frames_ < kLearnFrames;
+
+    for (size_t k = 0; k < bins_; k++) {
+        float power = re[k] * re[k] + im[k] * im[k];
+        float last = smoothed_[k];
+        float smoothed = learning && frames_ == 0 ? power
+                                                  : kSmoothing * last + (1 - kSmoothing) * power;
+
+        if (learning)
+            noise_[k] += (power - noise_[k]) / (frames_ + 1);
+        else if (noise_[k] < smoothed)
+            noise_[k] = kRise * noise_[k] + (1 - kRise) / (1 - kLag) * (smoothed - kLag * last);
+        else
+            noise_[k] = smoothed;
+        smoothed_[k] = smoothed;
+
+        float noise = kBias * noise_[k] + 1e-20f;
+        float posterior = power / noise;
+        float prior = kDecisionDirected * previous_[k] / noise +
+                      (1 - kDecisionDirected) * std::max(posterior - 1, 0.0f);
+        float g = std::max(prior / (1 + prior), floor_);
+
+        previous_[k] = g * g * power;
+        gain[k] *= g;
+    }
+
+    if (learning)
+        frames_++;
+}
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
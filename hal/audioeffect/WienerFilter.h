@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Fft.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+namespace effects {
+
+/*
+ * Stationary noise suppression on the short-time spectra of
+ * VoiceProcessor: a Wiener gain per bin from the decision-directed a
+ * priori SNR, over a noise estimate that follows the minimum of the
+ * smoothed power. The first kLearnFrames average the noise instead, so
+ * the estimate is usable from the start. Gains do not go below the
+ * floor, which keeps what is left of the noise natural.
+ */
+class WienerFilter
+{
+public:
+    static constexpr size_t kLearnFrames = 20;
+
+    WienerFilter();
+
+    void Configure(size_t bins);
+    void Reset();
+
+    /* Linear, 0 to 1 */
+    void SetFloor(float floor) { floor_ = floor; }
+
+    /* Multiplies @gain by the suppression for the spectrum @re, @im */
+    void Process(const float *re, const float *im, float *gain);
+
+private:
+    size_t bins_;
+    float floor_;
+    size_t frames_;
+
+    float smoothed_[Fft::kMaxBins];
+    float noise_[Fft::kMaxBins];
+    float previous_[Fft::kMaxBins];   /* clean power estimate of the last frame */
+};
+
+}  // namespace effects
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
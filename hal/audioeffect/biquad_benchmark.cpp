@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Bit-exactness and throughput of BiquadCascade::Process() against
+ * ProcessReference():
+ *
+ *   android.hardware.audio.effect@4.0-biquad-benchmark.rockchip [-n cascades] [-b blocks] [-s seed]
+ *
+ * First @cascades random cascades of 0 to kMaxSections sections, mono
+ * and stereo, are run through both paths side by side on blocks of
+ * random length, including 0, the lengths around the pipeline fill and
+ * drain and around kBlockFrames. Halfway through, the sections are
+ * replaced, with the same count and then with a different one, as a
+ * slider moving does. Every output sample and the sample past the block
+ * must match bit for bit. Then @blocks blocks of kBlockFrames are timed
+ * through each path for a range of section counts. Exits non-zero on
+ * any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "BiquadCascade.h"
+
+using namespace android::hardware::rockchip::effects;
+
+static constexpr double kSampleRate = 48000;
+static constexpr size_t kCallsPerCascade = 24;
+static constexpr size_t kBlockLengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 127, 128, 129, 256, 300, 480, 960 };
+static constexpr size_t kResetInterval = 256;
+
+static BiquadCoefficients RandomSection(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> freq(30, 15000), gain(-15, 15), q(0.5, 2.5);
+
+    switch (rng() % 5) {
+    case 0:
+        return BiquadCoefficients::LowShelf(kSampleRate, freq(rng), 0.707, gain(rng));
+    case 1:
+        return BiquadCoefficients::HighShelf(kSampleRate, freq(rng), 0.707, gain(rng));
+    case 2:
+        return BiquadCoefficients::HighPass(kSampleRate, freq(rng) / 10, 0.707);
+    case 3:
+        /* Identity sections are dropped; keep some to exercise that */
+        return { 1, 0, 0, 0, 0 };
+    default:
+        return BiquadCoefficients::Peaking(kSampleRate, freq(rng), q(rng), gain(rng));
+    }
+}
+
+static void RandomSections(std::mt19937& rng, BiquadCoefficients *sections, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        sections[i] = RandomSection(rng);
+}
+
+/* Returns the number of blocks whose output differed */
+static unsigned CheckCascade(std::mt19937& rng, size_t channels, size_t count, uint64_t *samples)
+{
+    std::uniform_real_distribution<float> signal(-1, 1);
+    BiquadCoefficients sections[BiquadCascade::kMaxSections];
+    BiquadCascade fast, reference;
+    unsigned mismatches = 0;
+
+    RandomSections(rng, sections, count);
+    for (BiquadCascade *cascade : { &fast, &reference }) {
+        cascade->SetChannels(channels);
+        cascade->SetSections(sections, count);
+    }
+
+    for (size_t call = 0; call < kCallsPerCascade; call++) {
+        if (call == kCallsPerCascade / 2) {
+            RandomSections(rng, sections, count);
+        } else if (call == kCallsPerCascade * 3 / 4) {
+            count = rng() % (BiquadCascade::kMaxSections + 1);
+            RandomSections(rng, sections, count);
+        }
+        if (call == kCallsPerCascade / 2 || call == kCallsPerCascade * 3 / 4) {
+            fast.SetSections(sections, count);
+            reference.SetSections(sections, count);
+        }
+
+        const size_t frames = kBlockLengths[rng() % (sizeof(kBlockLengths) / sizeof(kBlockLengths[0]))];
+        std::vector<float> a[BiquadCascade::kMaxChannels], b[BiquadCascade::kMaxChannels];
+        float *pa[BiquadCascade::kMaxChannels] = {}, *pb[BiquadCascade::kMaxChannels] = {};
+
+        /* One sample past the block must be left alone */
+        for (size_t c = 0; c < channels; c++) {
+            a[c].resize(frames + 1);
+            for (float& v : a[c])
+                v = signal(rng);
+            b[c] = a[c];
+            pa[c] = a[c].data();
+            pb[c] = b[c].data();
+        }
+
+        fast.Process(pa, frames);
+        reference.ProcessReference(pb, frames);
+
+        for (size_t c = 0; c < channels; c++) {
+            if (memcmp(a[c].data(), b[c].data(), (frames + 1) * sizeof(float)) != 0) {
+                printf("mismatch: %zu channels, %zu sections, call %zu, %zu frames\n", channels,
+                       count, call, frames);
+                mismatches++;
+            }
+            *samples += frames;
+        }
+    }
+
+    return mismatches;
+}
+
+static void BenchThroughput(unsigned blocks)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> signal(-1, 1);
+
+    for (size_t channels = 1; channels <= BiquadCascade::kMaxChannels; channels++) {
+        for (size_t count : { 1, 2, 4, 5, 8 }) {
+            BiquadCoefficients sections[BiquadCascade::kMaxSections];
+            for (size_t i = 0; i < count; i++)
+                sections[i] = BiquadCoefficients::Peaking(kSampleRate, 100.0 * (i + 1), 1, 6);
+
+            BiquadCascade cascade;
+            cascade.SetChannels(channels);
+            cascade.SetSections(sections, count);
+
+            static float buffer[BiquadCascade::kMaxChannels][BiquadCascade::kBlockFrames];
+            float *data[BiquadCascade::kMaxChannels];
+            for (size_t c = 0; c < channels; c++) {
+                for (float& v : buffer[c])
+                    v = signal(rng);
+                data[c] = buffer[c];
+            }
+
+            double ns[2];
+            for (int reference = 0; reference < 2; reference++) {
+                cascade.Reset();
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned i = 0; i < blocks; i++) {
+                    if (reference)
+                        cascade.ProcessReference(data, BiquadCascade::kBlockFrames);
+                    else
+                        cascade.Process(data, BiquadCascade::kBlockFrames);
+                    /* Feeding the output back in decays to denormals; start over now and then */
+                    if (i % kResetInterval == 0)
+                        cascade.Reset();
+                }
+                ns[reference] = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start).count() /
+                        (double(blocks) * BiquadCascade::kBlockFrames);
+            }
+
+            printf("%zu ch, %zu sections: %7.2f ns/frame, reference %7.2f ns/frame, %4.1fx, "
+                   "%6.0fx realtime at 48 kHz\n", channels, count, ns[0], ns[1], ns[1] / ns[0],
+                   1e9 / kSampleRate / ns[0]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned cascades = 200, blocks = 100000, seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            cascades = strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            blocks = strtoul(optarg, nullptr, 10);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n cascades] [-b blocks] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (blocks == 0)
+        blocks = 1;
+
+    std::mt19937 rng(seed);
+    unsigned mismatches = 0;
+    uint64_t samples = 0;
+
+    for (unsigned i = 0; i < cascades; i++) {
+        size_t channels = 1 + i % BiquadCascade::kMaxChannels;
+        size_t count = rng() % (BiquadCascade::kMaxSections + 1);
+        mismatches += CheckCascade(rng, channels, count, &samples);
+    }
+    printf("bit-exact: %u cascades, %llu samples compared, %u mismatching blocks\n", cascades,
+           (unsigned long long)samples, mismatches);
+
+    BenchThroughput(blocks);
+
+    printf("%s\n", mismatches == 0 ? "PASS" : "FAIL");
+    return mismatches == 0 ? 0 : 1;
+}
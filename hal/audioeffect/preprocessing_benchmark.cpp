@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cost and echo return loss enhancement of the voice pre-processing
+ * effects, run from WAV files through the effect library interface,
+ * without audio hardware:
+ *
+ *   android.hardware.audio.effect@4.0-preprocessing-benchmark.rockchip
+ *           [-e aec,ns,agc] [-d delay_ms] [-c near.wav] [-w warmup_s] [-o out.wav]
+ *           mic.wav [ref.wav]
+ *
+ * mic.wav is what the microphone picked up and ref.wav what the
+ * speakers played, 16-bit PCM at the same rate, mono or stereo. The
+ * effects are created on one session and fed 10 ms at a time, the far
+ * end first, and every process() and process_reverse() call is timed.
+ * The echo canceller is built into this binary only; the library leaves
+ * it out until the audio HAL feeds it the far end.
+ *
+ * ERLE is the power taken out of the microphone signal over the frames
+ * where only the far end talks: the reference is active and, given the
+ * near-end talker alone as near.wav, that is quiet. Without near.wav
+ * every frame with the reference active counts. It is reported over the
+ * whole file and after the first warmup_s seconds, by when the echo
+ * canceller should have converged. AGC gain counts against it, so leave
+ * agc out when measuring ERLE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <audio_effects/effect_aec.h>
+#include <hardware/audio_effect.h>
+
+#include "BenchUtil.h"
+#include "VoiceProcessor.h"
+
+using android::hardware::rockchip::Report;
+using android::hardware::rockchip::TimeUs;
+using android::hardware::rockchip::effects::VoiceProcessor;
+
+extern "C" audio_effect_library_t AUDIO_EFFECT_LIBRARY_INFO_SYM;
+
+/* Activity thresholds of the ERLE frames, in dBFS */
+static constexpr double kFarActiveDb = -50;
+static constexpr double kNearQuietDb = -55;
+
+struct EffectEntry {
+    const char *name;
+    effect_uuid_t uuid;
+};
+
+/* In processing order, as the VoiceProcessor stages */
+static const EffectEntry kEffects[] = {
+    { "aec", { 0x6949063e, 0xe627, 0x466f, 0x85e3, { 0x5c, 0x62, 0x73, 0xb1, 0x3e, 0x06 } } },
+    { "ns", { 0x9e5295e3, 0xc835, 0x48f3, 0x8648, { 0x94, 0x4d, 0xea, 0x9c, 0x8e, 0xde } } },
+    { "agc", { 0xe1ccadb8, 0x393a, 0x40ae, 0xa892, { 0xb0, 0xf9, 0xed, 0x11, 0x91, 0xe2 } } },
+};
+
+struct Wav {
+    uint32_t sample_rate;
+    uint32_t channels;
+    std::vector<int16_t> samples;
+
+    size_t frames() const { return channels ? samples.size() / channels : 0; }
+};
+
+static uint32_t Le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t Le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static bool ReadWav(const char *path, Wav *wav)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(file);
+
+    if (bytes.size() < 12 || memcmp(&bytes[0], "RIFF", 4) || memcmp(&bytes[8], "WAVE", 4)) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        return false;
+    }
+
+    bool have_format = false;
+    for (size_t pos = 12; pos + 8 <= bytes.size();) {
+        uint32_t size = Le32(&bytes[pos + 4]);
+        const uint8_t *body = &bytes[pos + 8];
+        size = std::min<size_t>(size, bytes.size() - pos - 8);
+
+        if (!memcmp(&bytes[pos], "fmt ", 4) && size >= 16) {
+            if (Le16(body) != 1 || Le16(body + 14) != 16) {
+                fprintf(stderr, "%s: only 16-bit PCM is supported\n", path);
+                return false;
+            }
+            wav->channels = Le16(body + 2);
+            wav->sample_rate = Le32(body + 4);
+            have_format = true;
+        } else if (!memcmp(&bytes[pos], "data", 4) && have_format) {
+            wav->samples.resize(size / sizeof(int16_t));
+            for (size_t i = 0; i < wav->samples.size(); i++)
+                wav->samples[i] = Le16(body + 2 * i);
+            return wav->channels == 1 || wav->channels == 2;
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    fprintf(stderr, "%s: no PCM data\n", path);
+    return false;
+}
+
+static bool WriteWav(const char *path, const Wav& wav)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    uint32_t data = wav.samples.size() * sizeof(int16_t);
+    uint32_t riff = 36 + data;
+    uint32_t fmt_size = 16;
+    uint16_t pcm = 1, bits = 16, align = wav.channels * sizeof(int16_t);
+    uint16_t channels = wav.channels;
+    uint32_t byte_rate = wav.sample_rate * align;
+
+    /* Little endian, as every target is */
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riff, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmt_size, 4, 1, file);
+    fwrite(&pcm, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&wav.sample_rate, 4, 1, file);
+    fwrite(&byte_rate, 4, 1, file);
+    fwrite(&align, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&data, 4, 1, file);
+    fwrite(wav.samples.data(), sizeof(int16_t), wav.samples.size(), file);
+
+    return fclose(file) == 0;
+}
+
+static int Command(effect_handle_t handle, uint32_t code, uint32_t size, void *data)
+{
+    int reply = 0;
+    uint32_t reply_size = sizeof(reply);
+    int status = (*handle)->command(handle, code, size, data, &reply_size, &reply);
+    return status ? status : reply;
+}
+
+template <typename T>
+static int SetParameter(effect_handle_t handle, int32_t id, const T& value)
+{
+    uint32_t buffer[(sizeof(effect_param_t) + sizeof(int32_t) + sizeof(T)) / sizeof(uint32_t) + 1];
+    effect_param_t *param = reinterpret_cast<effect_param_t*>(buffer);
+
+    param->psize = sizeof(int32_t);
+    param->vsize = sizeof(T);
+    memcpy(param->data, &id, sizeof(id));
+    memcpy(param->data + sizeof(int32_t), &value, sizeof(T));
+    return Command(handle, EFFECT_CMD_SET_PARAM, sizeof(effect_param_t) + sizeof(int32_t) +
+                   sizeof(T), param);
+}
+
+static effect_config_t Config(uint32_t sample_rate, audio_channel_mask_t channels)
+{
+    effect_config_t config = {};
+
+    config.inputCfg.samplingRate = sample_rate;
+    config.inputCfg.channels = channels;
+    config.inputCfg.format = AUDIO_FORMAT_PCM_16_BIT;
+    config.inputCfg.accessMode = EFFECT_BUFFER_ACCESS_READ;
+    config.inputCfg.mask = EFFECT_CONFIG_ALL;
+    config.outputCfg = config.inputCfg;
+    config.outputCfg.accessMode = EFFECT_BUFFER_ACCESS_WRITE;
+    return config;
+}
+
+/* Mean power in dBFS of @frames frames from @frame, all channels */
+static double PowerDb(const Wav& wav, size_t frame, size_t frames)
+{
+    double sum = 0;
+    size_t begin = frame * wav.channels;
+    size_t end = std::min(wav.samples.size(), (frame + frames) * wav.channels);
+
+    for (size_t i = begin; i < end; i++)
+        sum += (double)wav.samples[i] * wav.samples[i];
+    return 10 * log10(sum / (32768.0 * 32768.0) / std::max<size_t>(end - begin, 1) + 1e-12);
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-e aec,ns,agc] [-d delay_ms] [-c near.wav] [-w warmup_s] "
+            "[-o out.wav] mic.wav [ref.wav]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    std::string effects = "aec,ns,agc";
+    uint32_t delay_ms = 0;
+    double warmup_s = 2;
+    const char *near_path = nullptr;
+    const char *out_path = nullptr;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:d:c:w:o:")) != -1) {
+        switch (opt) {
+        case 'e':
+            effects = optarg;
+            break;
+        case 'd':
+            delay_ms = strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            near_path = optarg;
+            break;
+        case 'w':
+            warmup_s = strtod(optarg, nullptr);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            Usage(argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    Wav mic = {}, ref = {}, near = {};
+    if (!ReadWav(argv[optind], &mic) ||
+        (optind + 1 < argc && !ReadWav(argv[optind + 1], &ref)) ||
+        (near_path != nullptr && !ReadWav(near_path, &near)))
+        return 1;
+    if (!VoiceProcessor::SupportsRate(mic.sample_rate) ||
+        (ref.channels && ref.sample_rate != mic.sample_rate) ||
+        (near.channels && near.sample_rate != mic.sample_rate)) {
+        fprintf(stderr, "rates must match and be a multiple of 100 Hz from 8 to 48 kHz\n");
+        return 1;
+    }
+
+    const audio_effect_library_t& library = AUDIO_EFFECT_LIBRARY_INFO_SYM;
+    const int32_t session = 1, io = 1;
+    std::vector<effect_handle_t> handles;
+    effect_handle_t aec = nullptr;
+
+    for (const EffectEntry& entry : kEffects) {
+        if (("," + effects + ",").find(std::string(",") + entry.name + ",") == std::string::npos)
+            continue;
+
+        effect_handle_t handle;
+        int status = library.create_effect(&entry.uuid, session, io, &handle);
+        if (status != 0) {
+            fprintf(stderr, "%s: create_effect failed: %d\n", entry.name, status);
+            return 1;
+        }
+
+        effect_config_t config = Config(mic.sample_rate, mic.channels == 2 ?
+                                        AUDIO_CHANNEL_IN_STEREO : AUDIO_CHANNEL_IN_MONO);
+        status = Command(handle, EFFECT_CMD_INIT, 0, nullptr);
+        if (status == 0)
+            status = Command(handle, EFFECT_CMD_SET_CONFIG, sizeof(config), &config);
+        if (status == 0 && !strcmp(entry.name, "aec")) {
+            effect_config_t reverse = Config(mic.sample_rate, ref.channels == 2 ?
+                                             AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_OUT_MONO);
+            status = Command(handle, EFFECT_CMD_SET_CONFIG_REVERSE, sizeof(reverse), &reverse);
+            if (status == 0)
+                status = SetParameter(handle, AEC_PARAM_ECHO_DELAY, delay_ms * 1000);
+            aec = handle;
+        }
+        if (status == 0)
+            status = Command(handle, EFFECT_CMD_ENABLE, 0, nullptr);
+        if (status != 0) {
+            fprintf(stderr, "%s: setup failed: %d\n", entry.name, status);
+            return 1;
+        }
+        handles.push_back(handle);
+    }
+    if (handles.empty()) {
+        fprintf(stderr, "no effects in '%s'\n", effects.c_str());
+        return 2;
+    }
+
+    const size_t period = mic.sample_rate / 100;
+    const double period_us = 10000;
+    std::vector<double> process_us, reverse_us;
+    std::vector<int16_t> silence(period * 2);
+    Wav out = mic;
+
+    for (size_t frame = 0; frame < mic.frames(); frame += period) {
+        size_t frames = std::min(period, mic.frames() - frame);
+
+        if (aec != nullptr) {
+            audio_buffer_t far;
+            far.frameCount = frames;
+            far.s16 = frame + frames <= ref.frames() ? &ref.samples[frame * ref.channels]
+                                                     : silence.data();
+
+            reverse_us.push_back(TimeUs([&] { (*aec)->process_reverse(aec, &far, nullptr); }));
+        }
+
+        audio_buffer_t buffer;
+        buffer.frameCount = frames;
+        buffer.s16 = &out.samples[frame * out.channels];
+
+        process_us.push_back(TimeUs([&] {
+            for (effect_handle_t handle : handles)
+                (*handle)->process(handle, &buffer, &buffer);
+        }));
+    }
+
+    printf("%s, %u Hz, %u channel(s), %.1f s, latency %zu samples\n", effects.c_str(),
+           mic.sample_rate, mic.channels, (double)mic.frames() / mic.sample_rate,
+           VoiceProcessor::Latency(mic.sample_rate));
+    Report("process", process_us, "us", period_us);
+    Report("process_reverse", reverse_us, "us", period_us);
+
+    if (ref.channels) {
+        const size_t latency = VoiceProcessor::Latency(mic.sample_rate);
+        const size_t warmup = warmup_s * mic.sample_rate;
+        double in_all = 0, out_all = 0, in_late = 0, out_late = 0;
+        size_t counted = 0;
+
+        for (size_t frame = 0; frame + period + latency <= mic.frames(); frame += period) {
+            if (PowerDb(ref, frame, period) < kFarActiveDb)
+                continue;
+            if (near.channels && PowerDb(near, frame, period) > kNearQuietDb)
+                continue;
+
+            double in = pow(10, PowerDb(mic, frame, period) / 10);
+            double processed = pow(10, PowerDb(out, frame + latency, period) / 10);
+            in_all += in;
+            out_all += processed;
+            if (frame >= warmup) {
+                in_late += in;
+                out_late += processed;
+            }
+            counted++;
+        }
+
+        if (counted == 0)
+            printf("ERLE: no far-end single-talk frames\n");
+        else
+            printf("ERLE over %zu far-end frames: %.1f dB, after %.1f s: %.1f dB\n", counted,
+                   10 * log10(in_all / out_all), warmup_s,
+                   out_late > 0 ? 10 * log10(in_late / out_late) : 0.0);
+    }
+
+    for (effect_handle_t handle : handles)
+        library.release_effect(handle);
+
+    if (out_path != nullptr && !WriteWav(out_path, out))
+        return 1;
+    return 0;
+}
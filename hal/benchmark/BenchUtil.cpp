@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+
+#include "BenchUtil.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+
+static const char *kScratchDir = "/data/local/tmp";
+
+void Report(const char *name, std::vector<double> samples, const char *unit, double period)
+{
+    if (samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) {
+        return samples[std::min<size_t>(samples.size() * q, samples.size() - 1)];
+    };
+    double sum = 0;
+    for (double v : samples)
+        sum += v;
+    double mean = sum / samples.size();
+
+    printf("%-24s n=%-5zu min %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f  mean %8.3f %s",
+           name, samples.size(), samples.front(), at(0.5), at(0.9), at(0.99), samples.back(), mean,
+           unit);
+    if (period > 0)
+        printf("  %5.2f%% of real time", 100 * mean / period);
+    printf("\n");
+}
+
+bool MakeDirs(const std::string& path, mode_t mode)
+{
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        if (mkdir(path.substr(0, pos).c_str(), mode) != 0 && errno != EEXIST)
+            return false;
+    }
+    return mkdir(path.c_str(), mode) == 0 || errno == EEXIST;
+}
+
+std::string ScratchRoot(const char *name)
+{
+    return std::string(kScratchDir) + "/" + name;
+}
+
+bool WriteScratchFile(const std::string& path, const std::string& contents)
+{
+    size_t slash = path.rfind('/');
+    if (slash != std::string::npos && slash != 0 && !MakeDirs(path.substr(0, slash)))
+        return false;
+    return android::base::WriteStringToFile(contents, path);
+}
+
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
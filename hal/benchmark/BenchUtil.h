@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_ROCKCHIP_BENCHUTIL_H
+#define ANDROID_HARDWARE_ROCKCHIP_BENCHUTIL_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+
+/*
+ * Helpers shared by the HAL benchmarks and debug tests, which run in
+ * process against the HAL's classes and fake the nodes those read in a
+ * scratch tree under /data/local/tmp.
+ */
+
+/*
+ * One line of min, p50, p90, p99, max and mean of @samples, in @unit.
+ * With a @period in the same unit the mean is also given as a share of
+ * it, for work that has to keep up with real time.
+ */
+void Report(const char *name, std::vector<double> samples, const char *unit, double period = 0);
+
+template <typename F>
+double TimeUs(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename F>
+double TimeMs(F f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Creates directory @path and any of its parents that are missing */
+bool MakeDirs(const std::string& path, mode_t mode = 0755);
+
+/* /data/local/tmp/@name, the root of one tool's scratch tree */
+std::string ScratchRoot(const char *name);
+
+/* Writes @contents to @path, creating the directories leading to it */
+bool WriteScratchFile(const std::string& path, const std::string& contents);
+
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_ROCKCHIP_BENCHUTIL_H
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+#include <string.h>
+
+extern "C" {
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+}
+
+#include "EntropyPool.h"
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+EntropyPool::EntropyPool()
+    : available_(0),
+      refills_(0)
+{
+}
+
+EntropyPool::~EntropyPool()
+{
+    OPENSSL_cleanse(pool_, sizeof(pool_));
+}
+
+bool EntropyPool::Refill()
+{
+    if (RAND_bytes(pool_, sizeof(pool_)) != 1) {
+        ALOGE("%s: RAND_bytes failed", __func__);
+        available_ = 0;
+        return false;
+    }
+
+    available_ = sizeof(pool_);
+    refills_++;
+    return true;
+}
+
+bool EntropyPool::Get(void *out, size_t length)
+{
+    if (length > kPoolSize / 2) {
+        if (RAND_bytes(static_cast<uint8_t*>(out), length) == 1)
+            return true;
+        ALOGE("%s: RAND_bytes failed", __func__);
+        memset(out, 0, length);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (available_ < length && !Refill()) {
+        memset(out, 0, length);
+        return false;
+    }
+
+    uint8_t *bytes = pool_ + available_ - length;
+    memcpy(out, bytes, length);
+    OPENSSL_cleanse(bytes, length);
+    available_ -= length;
+    return true;
+}
+
+uint64_t EntropyPool::refills()
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    return refills_;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <mutex>
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Random bytes handed out from a buffer that is filled kPoolSize bytes
+ * at a time. An enroll asks for two 8-byte values and a verify for
+ * one, so most requests are a memcpy instead of a trip through the
+ * DRBG and its locking. Bytes are wiped from the pool as they are
+ * taken; requests larger than half the pool bypass it.
+ */
+class EntropyPool
+{
+public:
+    static constexpr size_t kPoolSize = 256;
+
+    EntropyPool();
+    ~EntropyPool();
+
+    EntropyPool(const EntropyPool&) = delete;
+    EntropyPool& operator=(const EntropyPool&) = delete;
+
+    /* False if the DRBG failed, @out is then zeroed */
+    bool Get(void *out, size_t length);
+
+    uint64_t refills();
+
+private:
+    bool Refill();
+
+    std::mutex lock_;
+    uint8_t pool_[kPoolSize];
+    size_t available_;                  /* unused bytes at the end of pool_ */
+    uint64_t refills_;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <vector>
+
+#include "FailureRecordStore.h"
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+static constexpr uint32_t kHeaderMagic = 0x52464b47;   /* "GKFR" */
+static constexpr uint32_t kEntryMagic = 0x45464b47;    /* "GKFE" */
+static constexpr uint32_t kVersion = 1;
+
+/* Rewrite once the file holds kCompactRatio entries per live record, but not for a handful */
+static constexpr uint64_t kCompactMinEntries = 256;
+static constexpr uint64_t kCompactRatio = 4;
+
+static uint32_t Checksum(const void *data, size_t length)
+{
+    return crc32(0, reinterpret_cast<const Bytef*>(data), length);
+}
+
+static bool PwriteFully(int fd, const void *data, size_t length, off_t offset)
+{
+    const uint8_t *p = reinterpret_cast<const uint8_t*>(data);
+
+    while (length > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(pwrite(fd, p, length, offset));
+        if (n <= 0)
+            return false;
+        p += n;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+FailureRecordStore::FailureRecordStore(const std::string& path)
+    : path_(path),
+      fd_(-1),
+      size_(0),
+      entries_(0),
+      unsynced_(false),
+      compact_(false),
+      exit_(false),
+      syncs_(0),
+      compactions_(0),
+      write_errors_(0)
+{
+    Open();
+
+    if (fd_ >= 0)
+        thread_ = std::thread(&FailureRecordStore::ThreadLoop, this);
+}
+
+FailureRecordStore::~FailureRecordStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(file_lock_);
+        exit_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void FailureRecordStore::Open()
+{
+    struct stat st;
+
+    /* Left behind by a compaction that did not get to the rename; the log is still whole */
+    unlink((path_ + ".tmp").c_str());
+
+    int fd = TEMP_FAILURE_RETRY(open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        ALOGE("%s: Error opening %s, failure records are not persistent: %s", __func__,
+              path_.c_str(), strerror(errno));
+        return;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(Header)) {
+        if (!Reset(fd)) {
+            close(fd);
+            return;
+        }
+        fd_ = fd;
+        return;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: Error mapping %s: %s", __func__, path_.c_str(), strerror(errno));
+        close(fd);
+        return;
+    }
+
+    size_t valid = 0;
+    bool replayed = Replay(reinterpret_cast<const uint8_t*>(data), st.st_size, &valid);
+    munmap(data, st.st_size);
+
+    if (!replayed) {
+        ALOGE("%s: %s has a bad header, starting over", __func__, path_.c_str());
+        if (!Reset(fd)) {
+            close(fd);
+            return;
+        }
+    } else if (valid < (size_t)st.st_size) {
+        ALOGW("%s: Dropping %zu bytes of torn or corrupt entries from %s", __func__,
+              (size_t)st.st_size - valid, path_.c_str());
+        if (ftruncate(fd, valid) < 0 || fdatasync(fd) < 0)
+            ALOGE("%s: Error truncating %s: %s", __func__, path_.c_str(), strerror(errno));
+    }
+
+    fd_ = fd;
+    size_ = valid > 0 ? valid : sizeof(Header);
+    entries_ = (size_ - sizeof(Header)) / sizeof(Entry);
+    ALOGI("%s: %zu failure records from %llu entries", __func__, index_.size(),
+          (unsigned long long)entries_);
+}
+
+bool FailureRecordStore::Replay(const uint8_t *data, size_t size, size_t *valid)
+{
+    Header header;
+
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != kHeaderMagic || header.version != kVersion ||
+        header.entry_size != sizeof(Entry) || header.crc != Checksum(&header, offsetof(Header, crc)))
+        return false;
+
+    size_t offset = sizeof(Header);
+    for (; offset + sizeof(Entry) <= size; offset += sizeof(Entry)) {
+        Entry entry;
+
+        memcpy(&entry, data + offset, sizeof(entry));
+        if (entry.magic != kEntryMagic || entry.crc != Checksum(&entry, offsetof(Entry, crc)))
+            break;
+        Apply(entry);
+    }
+
+    *valid = offset;
+    return true;
+}
+
+void FailureRecordStore::Apply(const Entry& entry)
+{
+    switch (entry.op) {
+    case OP_WRITE: {
+        ::gatekeeper::failure_record_t& record = index_[Key(entry.uid, entry.secure)];
+        record.secure_user_id = entry.secure_user_id;
+        record.last_checked_timestamp = entry.last_checked_timestamp;
+        record.failure_counter = entry.failure_counter;
+        break;
+    }
+    case OP_REMOVE:
+        index_.erase(Key(entry.uid, false));
+        index_.erase(Key(entry.uid, true));
+        break;
+    case OP_REMOVE_ALL:
+        index_.clear();
+        break;
+    default:
+        ALOGW("%s: Skipping entry with unknown op %u", __func__, entry.op);
+        break;
+    }
+}
+
+bool FailureRecordStore::Reset(int fd)
+{
+    Header header = {};
+
+    header.magic = kHeaderMagic;
+    header.version = kVersion;
+    header.entry_size = sizeof(Entry);
+    header.crc = Checksum(&header, offsetof(Header, crc));
+
+    if (ftruncate(fd, 0) < 0 || !PwriteFully(fd, &header, sizeof(header), 0) || fdatasync(fd) < 0) {
+        ALOGE("%s: Error initialising %s: %s", __func__, path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    size_ = sizeof(header);
+    entries_ = 0;
+    if (!SyncDir())
+        ALOGW("%s: Error syncing the directory of %s", __func__, path_.c_str());
+    return true;
+}
+
+bool FailureRecordStore::SyncDir()
+{
+    std::string dir = path_.substr(0, path_.rfind('/') + 1);
+    int fd = TEMP_FAILURE_RETRY(open(dir.empty() ? "." : dir.c_str(),
+                                     O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd < 0)
+        return false;
+
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+bool FailureRecordStore::Get(uint32_t uid, bool secure, ::gatekeeper::failure_record_t *record)
+{
+    std::lock_guard<std::mutex> lock(index_lock_);
+
+    auto it = index_.find(Key(uid, secure));
+    if (it == index_.end())
+        return false;
+
+    *record = it->second;
+    return true;
+}
+
+bool FailureRecordStore::Write(uint32_t uid, bool secure,
+                               const ::gatekeeper::failure_record_t& record, bool sync)
+{
+    Entry entry = {};
+
+    entry.uid = uid;
+    entry.secure_user_id = record.secure_user_id;
+    entry.last_checked_timestamp = record.last_checked_timestamp;
+    entry.failure_counter = record.failure_counter;
+    entry.op = OP_WRITE;
+    entry.secure = secure;
+
+    std::lock_guard<std::mutex> lock(file_lock_);
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        index_[Key(uid, secure)] = record;
+    }
+
+    /*
+     * A record that did not reach the disk is still enforced until the
+     * next restart. Failing the call instead would fail every verify
+     * with a full /data, locking the user out for good.
+     */
+    Append(&entry, sync);
+    return true;
+}
+
+bool FailureRecordStore::Remove(uint32_t uid)
+{
+    Entry entry = {};
+
+    entry.uid = uid;
+    entry.op = OP_REMOVE;
+
+    std::lock_guard<std::mutex> lock(file_lock_);
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        Apply(entry);
+    }
+    return Append(&entry, true) || fd_ < 0;
+}
+
+bool FailureRecordStore::RemoveAll()
+{
+    Entry entry = {};
+
+    entry.op = OP_REMOVE_ALL;
+
+    std::lock_guard<std::mutex> lock(file_lock_);
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        Apply(entry);
+    }
+    if (fd_ >= 0)
+        compact_ = true;
+    return Append(&entry, true) || fd_ < 0;
+}
+
+bool FailureRecordStore::Append(Entry *entry, bool sync)
+{
+    if (fd_ < 0)
+        return false;
+
+    entry->magic = kEntryMagic;
+    entry->crc = Checksum(entry, offsetof(Entry, crc));
+
+    if (!PwriteFully(fd_, entry, sizeof(*entry), size_)) {
+        ALOGE("%s: Error writing %s: %s", __func__, path_.c_str(), strerror(errno));
+        /* Do not leave a partial entry for the next one to land behind */
+        (void)ftruncate(fd_, size_);
+        write_errors_++;
+        return false;
+    }
+    size_ += sizeof(*entry);
+    entries_++;
+
+    bool notify = false;
+    if (sync) {
+        /* Also covers every batched write before this one */
+        if (fdatasync(fd_) < 0) {
+            ALOGE("%s: Error syncing %s: %s", __func__, path_.c_str(), strerror(errno));
+            write_errors_++;
+            return false;
+        }
+        syncs_++;
+        unsynced_ = false;
+    } else if (!unsynced_) {
+        unsynced_ = true;
+        sync_deadline_ = std::chrono::steady_clock::now() + kSyncDelay;
+        notify = true;
+    }
+
+    size_t live;
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        live = index_.size();
+    }
+    if (entries_ >= kCompactMinEntries && entries_ > kCompactRatio * live)
+        compact_ = true;
+
+    if (notify || compact_)
+        cond_.notify_one();
+    return true;
+}
+
+void FailureRecordStore::Compact()
+{
+    const std::string tmp = path_ + ".tmp";
+    std::vector<Entry> entries;
+    Header header = {};
+
+    header.magic = kHeaderMagic;
+    header.version = kVersion;
+    header.entry_size = sizeof(Entry);
+    header.crc = Checksum(&header, offsetof(Header, crc));
+
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        entries.reserve(index_.size());
+        for (const auto& it : index_) {
+            Entry entry = {};
+            entry.magic = kEntryMagic;
+            entry.uid = it.first >> 1;
+            entry.secure = it.first & 1;
+            entry.secure_user_id = it.second.secure_user_id;
+            entry.last_checked_timestamp = it.second.last_checked_timestamp;
+            entry.failure_counter = it.second.failure_counter;
+            entry.op = OP_WRITE;
+            entry.crc = Checksum(&entry, offsetof(Entry, crc));
+            entries.push_back(entry);
+        }
+    }
+
+    int fd = TEMP_FAILURE_RETRY(open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        ALOGE("%s: Error creating %s: %s", __func__, tmp.c_str(), strerror(errno));
+        return;
+    }
+
+    /* The new file must be complete on disk before it replaces the log */
+    size_t size = sizeof(header) + entries.size() * sizeof(Entry);
+    if (!PwriteFully(fd, &header, sizeof(header), 0) ||
+        !PwriteFully(fd, entries.data(), entries.size() * sizeof(Entry), sizeof(header)) ||
+        fdatasync(fd) < 0 || rename(tmp.c_str(), path_.c_str()) < 0) {
+        ALOGE("%s: Error writing %s: %s", __func__, tmp.c_str(), strerror(errno));
+        close(fd);
+        unlink(tmp.c_str());
+        return;
+    }
+    if (!SyncDir())
+        ALOGW("%s: Error syncing the directory of %s", __func__, path_.c_str());
+
+    close(fd_);
+    fd_ = fd;
+    size_ = size;
+    entries_ = entries.size();
+    unsynced_ = false;
+    compactions_++;
+}
+
+void FailureRecordStore::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(file_lock_);
+
+    while (!exit_) {
+        if (compact_) {
+            compact_ = false;
+            Compact();
+        } else if (unsynced_) {
+            /* Let more clears pile up behind the first one */
+            if (cond_.wait_until(lock, sync_deadline_, [this] { return exit_ || compact_; }))
+                continue;
+            if (fdatasync(fd_) == 0)
+                syncs_++;
+            unsynced_ = false;
+        } else {
+            cond_.wait(lock, [this] { return exit_ || compact_ || unsynced_; });
+        }
+    }
+
+    if (unsynced_)
+        fdatasync(fd_);
+}
+
+void FailureRecordStore::Dump(int fd)
+{
+    size_t live;
+    {
+        std::lock_guard<std::mutex> index_lock(index_lock_);
+        live = index_.size();
+    }
+
+    std::lock_guard<std::mutex> lock(file_lock_);
+    dprintf(fd, "\nfailure records: %s%s, %zu live, %llu entries, %llu bytes\n",
+            path_.c_str(), fd_ < 0 ? " (not open, memory only)" : "", live,
+            (unsigned long long)entries_, (unsigned long long)size_);
+    dprintf(fd, "  syncs %llu, compactions %llu, write errors %llu\n",
+            (unsigned long long)syncs_, (unsigned long long)compactions_,
+            (unsigned long long)write_errors_);
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
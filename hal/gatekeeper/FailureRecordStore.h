@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <gatekeeper/gatekeeper.h>
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Failure records that survive a restart of the HAL, so that killing
+ * the service does not reset the throttling of password guesses.
+ *
+ * The file is a header followed by fixed-size entries, each closed by a
+ * CRC32. It is only ever appended to: an entry stores a whole record,
+ * or deletes one user's records or everybody's. At start the file is
+ * mapped and replayed into an in-memory index, which then serves every
+ * lookup; replay stops at the first entry that fails its checksum, and
+ * the torn tail left by a crash or power loss is cut off.
+ *
+ * Writes that can only raise throttling (@sync) reach the disk before
+ * Write() returns. Writes that lower it, the clear after a successful
+ * verify, are synced by the background thread within kSyncDelay, batched
+ * with any others: losing one in a crash leaves the user throttled a
+ * little longer, never less. The same thread rewrites the file once
+ * superseded entries outnumber the live ones.
+ *
+ * Records are keyed by uid and the GateKeeper @secure flag, so secure and
+ * insecure throttling never share a counter. If the file cannot be
+ * opened the store still works, in memory only, as the HAL used to.
+ */
+class FailureRecordStore
+{
+public:
+    static constexpr std::chrono::milliseconds kSyncDelay = std::chrono::seconds(1);
+
+    explicit FailureRecordStore(const std::string& path);
+    ~FailureRecordStore();
+
+    FailureRecordStore(const FailureRecordStore&) = delete;
+    FailureRecordStore& operator=(const FailureRecordStore&) = delete;
+
+    /* False if nothing is stored for @uid */
+    bool Get(uint32_t uid, bool secure, ::gatekeeper::failure_record_t *record);
+
+    /* False only if the record could not be kept at all, not even in memory */
+    bool Write(uint32_t uid, bool secure, const ::gatekeeper::failure_record_t& record, bool sync);
+
+    /* Drop the secure and insecure records of @uid */
+    bool Remove(uint32_t uid);
+    bool RemoveAll();
+
+    void Dump(int fd);
+
+private:
+    enum EntryOp : uint16_t {
+        OP_WRITE = 1,
+        OP_REMOVE,
+        OP_REMOVE_ALL,
+    };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entry_size;
+        uint32_t crc;
+    };
+
+    struct Entry {
+        uint32_t magic;
+        uint32_t uid;
+        uint64_t secure_user_id;
+        uint64_t last_checked_timestamp;
+        uint32_t failure_counter;
+        uint16_t op;
+        uint16_t secure;
+        uint32_t reserved;
+        uint32_t crc;                   /* CRC32 of everything above */
+    };
+
+    typedef std::unordered_map<uint64_t, ::gatekeeper::failure_record_t> Index;
+
+    static uint64_t Key(uint32_t uid, bool secure) { return (uint64_t)uid << 1 | secure; }
+
+    void Open();
+    bool Replay(const uint8_t *data, size_t size, size_t *valid);
+    void Apply(const Entry& entry);
+    bool Append(Entry *entry, bool sync);
+    bool Reset(int fd);
+    bool SyncDir();
+    void Compact();
+    void ThreadLoop();
+
+    const std::string path_;
+
+    std::mutex index_lock_;             /* index_ only; never held across I/O */
+    Index index_;
+
+    std::mutex file_lock_;              /* fd_ and the counters below; orders the log like the index */
+    std::condition_variable cond_;
+    int fd_;
+    uint64_t size_;
+    uint64_t entries_;                  /* entries in the file, live or superseded */
+    bool unsynced_;
+    std::chrono::steady_clock::time_point sync_deadline_;
+    bool compact_;
+    bool exit_;
+
+    /* Statistics for debug(), under file_lock_ */
+    uint64_t syncs_;
+    uint64_t compactions_;
+    uint64_t write_errors_;
+
+    std::thread thread_;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
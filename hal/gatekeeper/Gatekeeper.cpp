@@ -23,12 +23,51 @@ namespace gatekeeper {
 namespace V1_0 {
 namespace implementation {
 
+inline ::gatekeeper::SizedBuffer hidl_vec2sized_buffer(const hidl_vec<uint8_t>& vec, size_t length)
+{
+    if (length == 0 || length > vec.size() || length > std::numeric_limits<uint32_t>::max()) return {};
+    auto dummy = new uint8_t[length];
+    std::copy(vec.begin(), vec.begin() + length, dummy);
+    return {dummy, static_cast<uint32_t>(length)};
+}
+
 inline ::gatekeeper::SizedBuffer hidl_vec2sized_buffer(const hidl_vec<uint8_t>& vec)
 {
-    if (vec.size() == 0 || vec.size() > std::numeric_limits<uint32_t>::max()) return {};
-    auto dummy = new uint8_t[vec.size()];
-    std::copy(vec.begin(), vec.end(), dummy);
-    return {dummy, static_cast<uint32_t>(vec.size())};
+    return hidl_vec2sized_buffer(vec, vec.size());
+}
+
+/*
+ * libgatekeeper's messages own their buffers and release them with
+ * delete[], so each input still needs the one copy above. It is wiped
+ * before it goes back to the heap: the password copies are plaintext.
+ */
+static void wipe_sized_buffer(::gatekeeper::SizedBuffer& buffer)
+{
+    if (buffer.size() > 0)
+        OPENSSL_cleanse(buffer.Data<uint8_t>(), buffer.size());
+}
+
+/*
+ * Lends @buffer to the response instead of copying it into a new
+ * hidl_vec. The callback is synchronous, so the view only has to
+ * outlive the _hidl_cb() call, and the message owning @buffer does.
+ */
+static void lend_sized_buffer(GatekeeperResponse& rsp, ::gatekeeper::SizedBuffer& buffer)
+{
+    rsp.data.setToExternal(buffer.Data<uint8_t>(), buffer.size(), false /* shouldOwn */);
+}
+
+static const char * const kMetricNames[METRIC_COUNT] = {
+    "enroll",
+    "verify",
+    "deleteUser",
+    "deleteAllUsers",
+};
+
+Gatekeeper::Gatekeeper()
+    : metrics_(kMetricNames, METRIC_COUNT)
+{
+    impl_.reset(new implementation::GatekeeperDevice());
 }
 
 // Methods from ::android::hardware::gatekeeper::V1_0::IGatekeeper follow.
@@ -38,27 +77,45 @@ Return<void> Gatekeeper::enroll(uint32_t uid __attribute__((unused)),
         const hidl_vec<uint8_t>& desiredPassword,
         enroll_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(metrics_, METRIC_ENROLL);
+
     if (desiredPassword.size() == 0) {
         _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
         return Void();
     }
 
-    ::gatekeeper::EnrollRequest request(uid, hidl_vec2sized_buffer(currentPasswordHandle),
+    /* libgatekeeper only sees its own part of the handle, the scrypt cost stays here */
+    scrypt_params_t current, enrolled;
+    size_t handle_length = impl_->SplitHandle(currentPasswordHandle.data(),
+                                               currentPasswordHandle.size(), &current);
+    if (currentPasswordHandle.size() > 0 && handle_length == 0) {
+        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        return Void();
+    }
+
+    ::gatekeeper::EnrollRequest request(uid, hidl_vec2sized_buffer(currentPasswordHandle, handle_length),
                           hidl_vec2sized_buffer(desiredPassword),
                           hidl_vec2sized_buffer(currentPassword));
     ::gatekeeper::EnrollResponse response;
-    impl_->Enroll(request, &response);
+    impl_->Enroll(request, &response, current, &enrolled);
+
+    wipe_sized_buffer(request.provided_password);
+    wipe_sized_buffer(request.enrolled_password);
 
+    GatekeeperResponse rsp;
+    uint8_t handle[GatekeeperDevice::kMaxHandleLength];
+    rsp.timeout = response.retry_timeout;
     if (response.error == ::gatekeeper::ERROR_RETRY) {
-        _hidl_cb({GatekeeperStatusCode::ERROR_RETRY_TIMEOUT, response.retry_timeout, {}});
+        rsp.code = GatekeeperStatusCode::ERROR_RETRY_TIMEOUT;
     } else if (response.error != ::gatekeeper::ERROR_NONE) {
-        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        rsp.code = GatekeeperStatusCode::ERROR_GENERAL_FAILURE;
+        rsp.timeout = 0;
     } else {
-        hidl_vec<uint8_t> new_handle(response.enrolled_password_handle.Data<uint8_t>(),
-                                     response.enrolled_password_handle.Data<uint8_t>() +
-                                             response.enrolled_password_handle.size());
-        _hidl_cb({GatekeeperStatusCode::STATUS_OK, response.retry_timeout, new_handle});
+        rsp.code = GatekeeperStatusCode::STATUS_OK;
+        rsp.data.setToExternal(handle, GatekeeperDevice::JoinHandle(
+                response.enrolled_password_handle, enrolled, handle));
     }
+    _hidl_cb(rsp);
 
     return Void();
 }
@@ -69,41 +126,89 @@ Return<void> Gatekeeper::verify(uint32_t uid __attribute__((unused)),
                                 const hidl_vec<uint8_t>& providedPassword,
                                 verify_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(metrics_, METRIC_VERIFY);
+
     if (enrolledPasswordHandle.size() == 0) {
         _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
         return Void();
     }
 
-    ::gatekeeper::VerifyRequest request(uid, challenge, hidl_vec2sized_buffer(enrolledPasswordHandle),
+    scrypt_params_t params;
+    size_t handle_length = impl_->SplitHandle(enrolledPasswordHandle.data(),
+                                               enrolledPasswordHandle.size(), &params);
+    if (handle_length == 0) {
+        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        return Void();
+    }
+
+    ::gatekeeper::VerifyRequest request(uid, challenge,
+                          hidl_vec2sized_buffer(enrolledPasswordHandle, handle_length),
                           hidl_vec2sized_buffer(providedPassword));
     ::gatekeeper::VerifyResponse response;
-    impl_->Verify(request, &response);
+    impl_->Verify(request, &response, params);
+
+    wipe_sized_buffer(request.provided_password);
 
+    GatekeeperResponse rsp;
+    rsp.timeout = response.retry_timeout;
     if (response.error == ::gatekeeper::ERROR_RETRY) {
-        _hidl_cb({GatekeeperStatusCode::ERROR_RETRY_TIMEOUT, response.retry_timeout, {}});
+        rsp.code = GatekeeperStatusCode::ERROR_RETRY_TIMEOUT;
     } else if (response.error != ::gatekeeper::ERROR_NONE) {
-        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        rsp.code = GatekeeperStatusCode::ERROR_GENERAL_FAILURE;
+        rsp.timeout = 0;
     } else {
-        hidl_vec<uint8_t> auth_token(
-                response.auth_token.Data<uint8_t>(),
-                response.auth_token.Data<uint8_t>() + response.auth_token.size());
-
-        _hidl_cb({response.request_reenroll ? GatekeeperStatusCode::STATUS_REENROLL
-                                            : GatekeeperStatusCode::STATUS_OK,
-                  response.retry_timeout, auth_token});
+        rsp.code = response.request_reenroll ? GatekeeperStatusCode::STATUS_REENROLL
+                                             : GatekeeperStatusCode::STATUS_OK;
+        lend_sized_buffer(rsp, response.auth_token);
     }
+    _hidl_cb(rsp);
+
+    /* The token is only good for the challenge it was minted for, but do not leave it around */
+    wipe_sized_buffer(response.auth_token);
     return Void();
 }
 
-Return<void> Gatekeeper::deleteUser(uint32_t uid __attribute__((unused)), deleteUser_cb _hidl_cb)
+Return<void> Gatekeeper::deleteUser(uint32_t uid, deleteUser_cb _hidl_cb)
 {
-    _hidl_cb({GatekeeperStatusCode::ERROR_NOT_IMPLEMENTED, 0, {}});
+    HalMetrics::Scope scope(metrics_, METRIC_DELETE_USER);
+
+    /* Handles live in the framework; only the throttling state is kept here */
+    if (!impl_->ForgetUser(uid)) {
+        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        return Void();
+    }
+
+    _hidl_cb({GatekeeperStatusCode::STATUS_OK, 0, {}});
     return Void();
 }
 
 Return<void> Gatekeeper::deleteAllUsers(deleteAllUsers_cb _hidl_cb)
 {
-    _hidl_cb({GatekeeperStatusCode::ERROR_NOT_IMPLEMENTED, 0, {}});
+    HalMetrics::Scope scope(metrics_, METRIC_DELETE_ALL_USERS);
+
+    if (!impl_->ForgetAllUsers()) {
+        _hidl_cb({GatekeeperStatusCode::ERROR_GENERAL_FAILURE, 0, {}});
+        return Void();
+    }
+
+    _hidl_cb({GatekeeperStatusCode::STATUS_OK, 0, {}});
+    return Void();
+}
+
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> Gatekeeper::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args)
+{
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1)
+        return Void();
+
+    bool reset = false;
+    for (const auto& arg : args) {
+        if (arg == "--reset")
+            reset = true;
+    }
+
+    metrics_.Dump(fd->data[0], reset);
+    impl_->Dump(fd->data[0]);
     return Void();
 }
 
@@ -24,6 +24,8 @@
 #include <hardware/hardware.h>
 #include <hardware/gatekeeper.h>
 
+#include <HalMetrics.h>
+
 namespace android {
 namespace hardware {
 namespace gatekeeper {
@@ -36,13 +38,21 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::hardware::hidl_vec;
 using ::android::hardware::hidl_string;
+using ::android::hardware::hidl_handle;
+using ::android::hardware::rockchip::HalMetrics;
 using ::android::sp;
 
+enum GatekeeperMetric {
+    METRIC_ENROLL = 0,
+    METRIC_VERIFY,
+    METRIC_DELETE_USER,
+    METRIC_DELETE_ALL_USERS,
+    METRIC_COUNT,
+};
+
 class Gatekeeper : public IGatekeeper {
 public:
-    Gatekeeper() {
-        impl_.reset(new implementation::GatekeeperDevice());
-    }
+    Gatekeeper();
 
     ~Gatekeeper() = default;
 
@@ -60,7 +70,11 @@ public:
     Return<void> deleteUser(uint32_t uid, deleteUser_cb _hidl_cb)  override;
     Return<void> deleteAllUsers(deleteAllUsers_cb _hidl_cb)  override;
 
+    // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override;
+
 private:
+    HalMetrics metrics_;
     std::unique_ptr<implementation::GatekeeperDevice> impl_;
 };
 
@@ -15,8 +15,13 @@
  */
 
 #include <log/log.h>
-#include <android-base/memory.h>
+#include <stdio.h>
+#include <android-base/properties.h>
 #include <gatekeeper/gatekeeper.h>
+#include <openssl/hmac.h>
+
+#include <algorithm>
+#include <chrono>
 
 #include "GatekeeperDevice.h"
 
@@ -27,11 +32,206 @@ namespace V1_0 {
 namespace implementation {
 
 static constexpr uint32_t SIGNATURE_LENGTH_BYTES = 32;
+static constexpr size_t HMAC_BLOCK_BYTES = SHA256_CBLOCK;
+
+/* The defaults, and the cost of every handle without a scrypt_params_t */
+static constexpr uint64_t kScryptN = 16384;
+static constexpr uint32_t kScryptR = 8;
+static constexpr uint32_t kScryptP = 1;
+
+static constexpr uint32_t kScryptParamsMagic = 0x31505347;     /* "GSP1" */
+static constexpr scrypt_params_t kDefaultScryptParams = { kScryptParamsMagic, 14, kScryptR, kScryptP, 0 };
+
+/*
+ * Calibration keeps N within 2^12..2^20 and within the scrypt budget,
+ * and never changes r, so a handle asking for anything outside that was
+ * not enrolled here and is refused before its cost is allocated.
+ */
+static constexpr uint8_t kMinLog2N = 12;
+static constexpr uint8_t kMaxLog2N = 20;
+static constexpr uint8_t kMaxScryptR = kScryptR;
+
+static const char *kScryptTargetProperty = "ro.vendor.gatekeeper.scrypt_target_ms";
+static const char *kScryptBudgetProperty = "ro.vendor.gatekeeper.scrypt_budget_kib";
+static constexpr size_t kDefaultScryptBudgetKib = 128 * kScryptR * kScryptN / 1024;
+
+static const char *kFailureRecordPath = "/data/vendor/gatekeeper/failure_records";
+
+/*
+ * libgatekeeper hands ComputePasswordSignature() only the password and
+ * the salt, and DoVerify() only the handle. Enroll() and Verify() leave
+ * the uid and the parameters of the call in progress here, and
+ * DoVerify() switches to the handle's own while it checks a password.
+ */
+struct ScryptCall {
+    uint32_t uid;
+    scrypt_params_t enroll;
+    scrypt_params_t verify;
+    bool verifying;
+    bool failed;                        /* scrypt could not be run for the call */
+};
+
+static thread_local ScryptCall tls_scrypt_call = { 0, kDefaultScryptParams, kDefaultScryptParams,
+                                                   false, false };
+
+static bool IsDefault(const scrypt_params_t &params)
+{
+    return params.log2_n == kDefaultScryptParams.log2_n && params.r == kDefaultScryptParams.r &&
+           params.p == kDefaultScryptParams.p;
+}
+
+/* Entries are per boot and live this long after the scrypt verify that made them */
+static constexpr uint64_t kFastHashLifetimeMs = 60 * 60 * 1000;
 
 GatekeeperDevice::GatekeeperDevice()
+    : GatekeeperDevice(kFailureRecordPath,
+                       ::android::base::GetUintProperty<uint32_t>(kScryptTargetProperty, 0),
+                       ::android::base::GetUintProperty<size_t>(kScryptBudgetProperty,
+                                                                kDefaultScryptBudgetKib) * 1024)
 {
-    key_.reset(new uint8_t[SIGNATURE_LENGTH_BYTES]);
-    memset(key_.get(), 0, SIGNATURE_LENGTH_BYTES);
+}
+
+GatekeeperDevice::GatekeeperDevice(const std::string& failure_record_path,
+                                   uint32_t scrypt_target_ms, size_t scrypt_budget)
+    : scrypt_target_ms_(scrypt_target_ms),
+      scrypt_budget_(scrypt_budget),
+      scrypt_max_log2_n_(kDefaultScryptParams.log2_n),
+      enroll_params_(kDefaultScryptParams)
+{
+    /* Room for the largest calibrated N, and still for the default one of older handles */
+    if (scrypt_target_ms_ > 0) {
+        for (uint8_t log2_n = kMinLog2N; log2_n <= kMaxLog2N; log2_n++) {
+            if ((128ULL * kScryptR << log2_n) <= scrypt_budget_)
+                scrypt_max_log2_n_ = std::max(scrypt_max_log2_n_, log2_n);
+        }
+    }
+    const uint64_t max_n = 1ULL << scrypt_max_log2_n_;
+
+    entropy_.reset(new EntropyPool());
+
+    /* scrypt ignores the password key, but handles on disk were enrolled with this one */
+    password_key_.reset(new uint8_t[SIGNATURE_LENGTH_BYTES]);
+    memset(password_key_.get(), 0, SIGNATURE_LENGTH_BYTES);
+
+    auth_token_key_.reset(new uint8_t[SIGNATURE_LENGTH_BYTES]);
+    if (RAND_bytes(auth_token_key_.get(), SIGNATURE_LENGTH_BYTES) != 1)
+        ALOGE("%s: No random auth token key, tokens will not verify", __func__);
+    HmacKeySchedule(auth_token_key_.get(), SIGNATURE_LENGTH_BYTES, &auth_token_inner_,
+                    &auth_token_outer_);
+
+    scrypt_.reset(new ScryptPool(max_n, kScryptR));
+    failure_store_.reset(new FailureRecordStore(failure_record_path));
+}
+
+GatekeeperDevice::~GatekeeperDevice()
+{
+    OPENSSL_cleanse(auth_token_key_.get(), SIGNATURE_LENGTH_BYTES);
+    OPENSSL_cleanse(&auth_token_inner_, sizeof(auth_token_inner_));
+    OPENSSL_cleanse(&auth_token_outer_, sizeof(auth_token_outer_));
+}
+
+void GatekeeperDevice::Enroll(const ::gatekeeper::EnrollRequest &request,
+                              ::gatekeeper::EnrollResponse *response,
+                              const scrypt_params_t &current, scrypt_params_t *enrolled)
+{
+    *enrolled = EnrollParams();
+
+    std::lock_guard<std::mutex> lock(UserLock(request.user_id));
+    tls_scrypt_call = { request.user_id, *enrolled, current, false, false };
+    ::gatekeeper::GateKeeper::Enroll(request, response);
+
+    /* The handle carries a random signature no password matches; do not hand it out */
+    if (tls_scrypt_call.failed && response->error == ::gatekeeper::ERROR_NONE)
+        response->error = ::gatekeeper::ERROR_UNKNOWN;
+}
+
+void GatekeeperDevice::Verify(const ::gatekeeper::VerifyRequest &request,
+                              ::gatekeeper::VerifyResponse *response,
+                              const scrypt_params_t &params)
+{
+    std::lock_guard<std::mutex> lock(UserLock(request.user_id));
+    tls_scrypt_call = { request.user_id, kDefaultScryptParams, params, false, false };
+    ::gatekeeper::GateKeeper::Verify(request, response);
+
+    /* The password was never checked: report an error rather than a wrong guess */
+    if (tls_scrypt_call.failed && response->error == ::gatekeeper::ERROR_INVALID)
+        response->error = ::gatekeeper::ERROR_UNKNOWN;
+}
+
+size_t GatekeeperDevice::SplitHandle(const uint8_t *handle, size_t length,
+                                     scrypt_params_t *params) const
+{
+    *params = kDefaultScryptParams;
+    if (length != kMaxHandleLength)
+        return length;
+
+    memcpy(params, handle + sizeof(::gatekeeper::password_handle_t), sizeof(*params));
+    if (params->magic != kScryptParamsMagic) {
+        *params = kDefaultScryptParams;
+        return length;
+    }
+
+    if (params->log2_n < kMinLog2N || params->log2_n > scrypt_max_log2_n_ || params->r == 0 ||
+        params->r > kMaxScryptR || params->p == 0 || params->p > ScryptWorker::kMaxParallel) {
+        ALOGE("%s: Handle asks for scrypt N=2^%u r=%u p=%u", __func__, params->log2_n, params->r,
+              params->p);
+        return 0;
+    }
+    return sizeof(::gatekeeper::password_handle_t);
+}
+
+size_t GatekeeperDevice::JoinHandle(const ::gatekeeper::SizedBuffer &handle,
+                                    const scrypt_params_t &params, uint8_t *out)
+{
+    size_t length = std::min<size_t>(handle.size(), sizeof(::gatekeeper::password_handle_t));
+
+    memcpy(out, handle.Data<uint8_t>(), length);
+    if (IsDefault(params))
+        return length;
+
+    memcpy(out + length, &params, sizeof(params));
+    return length + sizeof(params);
+}
+
+scrypt_params_t GatekeeperDevice::EnrollParams()
+{
+    std::call_once(calibrate_once_, &GatekeeperDevice::CalibrateScrypt, this);
+    return enroll_params_;
+}
+
+void GatekeeperDevice::CalibrateScrypt()
+{
+    static const uint8_t kProbe[] = "calibration";
+    const uint64_t target_us = scrypt_target_ms_ * 1000ULL;
+    uint64_t probe_us = UINT64_MAX;
+    uint64_t salt = 0;
+    uint8_t out[SIGNATURE_LENGTH_BYTES];
+
+    if (scrypt_target_ms_ == 0)
+        return;
+
+    /* scrypt is linear in N: time the smallest N, keep the better of two runs, and scale */
+    for (int i = 0; i < 2; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (scrypt_->Compute(kProbe, sizeof(kProbe), reinterpret_cast<uint8_t*>(&salt),
+                             sizeof(salt), 1ULL << kMinLog2N, kScryptR, kScryptP, out,
+                             sizeof(out)) != 0) {
+            ALOGW("%s: No scrypt worker, keeping the default cost", __func__);
+            return;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        probe_us = std::min<uint64_t>(probe_us,
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+    uint8_t log2_n = kMinLog2N;
+    while (log2_n < kMaxLog2N && (128ULL * kScryptR << (log2_n + 1)) <= scrypt_budget_ &&
+           (probe_us << (log2_n + 1 - kMinLog2N)) <= target_us)
+        log2_n++;
+
+    enroll_params_.log2_n = log2_n;
+    ALOGI("%s: N=2^%u (N=2^%u took %llu us, target %u ms, budget %zu KiB)", __func__, log2_n,
+          kMinLog2N, (unsigned long long)probe_us, scrypt_target_ms_, scrypt_budget_ / 1024);
 }
 
 bool GatekeeperDevice::GetAuthTokenKey(const uint8_t **auth_token_key, uint32_t *length) const
@@ -41,7 +241,7 @@ bool GatekeeperDevice::GetAuthTokenKey(const uint8_t **auth_token_key, uint32_t
     if (nullptr == auth_token_key || nullptr == length)
         return false;
 
-    *auth_token_key = key_.get();
+    *auth_token_key = auth_token_key_.get();
     *length = SIGNATURE_LENGTH_BYTES;
     return true;
 }
@@ -53,7 +253,7 @@ void GatekeeperDevice::GetPasswordKey(const uint8_t **password_key, uint32_t *le
     if (nullptr == password_key || nullptr == length)
         return;
 
-    *password_key = key_.get();
+    *password_key = password_key_.get();
     *length = SIGNATURE_LENGTH_BYTES;
 }
 
@@ -66,12 +266,22 @@ void GatekeeperDevice::ComputePasswordSignature(uint8_t* signature, uint32_t sig
     if (nullptr == signature)
         return;
 
-    const uint64_t N = 16384;
-    const uint32_t r = 8;
-    const uint32_t p = 1;
+    const scrypt_params_t &params =
+            tls_scrypt_call.verifying ? tls_scrypt_call.verify : tls_scrypt_call.enroll;
+    const uint64_t N = 1ULL << params.log2_n;
+
+    if (scrypt_->Compute(password, password_length, reinterpret_cast<uint8_t*>(&salt),
+                         sizeof(salt), N, params.r, params.p, signature, signature_length) == 0)
+        return;
+
+    if (crypto_scrypt(password, password_length, reinterpret_cast<uint8_t*>(&salt), sizeof(salt),
+                      N, params.r, params.p, signature, signature_length) == 0)
+        return;
 
-    crypto_scrypt(password, password_length, reinterpret_cast<uint8_t*>(&salt), sizeof(salt), N,
-                      r, p, signature, signature_length);
+    /* Never leave a signature that a later failure could reproduce, such as zeros */
+    ALOGE("%s: scrypt N=2^%u r=%u p=%u failed", __func__, params.log2_n, params.r, params.p);
+    GetRandom(signature, signature_length);
+    tls_scrypt_call.failed = true;
 }
 
 void GatekeeperDevice::GetRandom(void *random, uint32_t requested_size) const
@@ -81,18 +291,60 @@ void GatekeeperDevice::GetRandom(void *random, uint32_t requested_size) const
     if (nullptr == random)
         return;
 
-    RAND_pseudo_bytes((uint8_t*)random, requested_size);
+    entropy_->Get(random, requested_size);
 }
 
-void GatekeeperDevice::ComputeSignature(uint8_t* signature, uint32_t signature_length, const uint8_t*,
-                                  uint32_t, const uint8_t*, const uint32_t) const
+void GatekeeperDevice::ComputeSignature(uint8_t* signature, uint32_t signature_length,
+                                        const uint8_t* key, uint32_t key_length,
+                                        const uint8_t* message, const uint32_t length) const
 {
     ALOGV("%s:", __func__);
 
     if (nullptr == signature)
         return;
 
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+    /* libgatekeeper only signs auth tokens, always with GetAuthTokenKey() */
+    if (key == auth_token_key_.get() && key_length == SIGNATURE_LENGTH_BYTES) {
+        SHA256_CTX ctx = auth_token_inner_;
+        SHA256_Update(&ctx, message, length);
+        SHA256_Final(digest, &ctx);
+
+        ctx = auth_token_outer_;
+        SHA256_Update(&ctx, digest, sizeof(digest));
+        SHA256_Final(digest, &ctx);
+        OPENSSL_cleanse(&ctx, sizeof(ctx));
+    } else {
+        unsigned int digest_length = sizeof(digest);
+        if (HMAC(EVP_sha256(), key, key_length, message, length, digest, &digest_length) == nullptr)
+            memset(digest, 0, sizeof(digest));
+    }
+
     memset(signature, 0, signature_length);
+    memcpy(signature, digest, std::min<size_t>(signature_length, sizeof(digest)));
+    OPENSSL_cleanse(digest, sizeof(digest));
+}
+
+void GatekeeperDevice::HmacKeySchedule(const uint8_t *key, size_t length, SHA256_CTX *inner,
+                                       SHA256_CTX *outer)
+{
+    uint8_t block[HMAC_BLOCK_BYTES] = {};
+
+    /* RFC 2104; keys are never longer than a block here, so no pre-hash */
+    memcpy(block, key, std::min(length, sizeof(block)));
+
+    for (size_t i = 0; i < sizeof(block); i++)
+        block[i] ^= 0x36;
+    SHA256_Init(inner);
+    SHA256_Update(inner, block, sizeof(block));
+
+    for (size_t i = 0; i < sizeof(block); i++)
+        block[i] ^= 0x36 ^ 0x5c;
+    SHA256_Init(outer);
+    SHA256_Update(outer, block, sizeof(block));
+
+    OPENSSL_cleanse(block, sizeof(block));
 }
 
 uint64_t GatekeeperDevice::GetMillisecondsSinceBoot() const
@@ -108,16 +360,13 @@ bool GatekeeperDevice::GetFailureRecord(uint32_t uid, ::gatekeeper::secure_id_t
 {
     ALOGV("%s: secure=%d", __func__, secure);
 
-    ::gatekeeper::failure_record_t* stored = &failure_map_[uid];
-
-    if (user_id != stored->secure_user_id) {
-        stored->secure_user_id = user_id;
-        stored->last_checked_timestamp = 0;
-        stored->failure_counter = 0;
+    /* A record left over from a previous enrollment of the uid does not count */
+    if (!failure_store_->Get(uid, secure, record) || user_id != record->secure_user_id) {
+        record->secure_user_id = user_id;
+        record->last_checked_timestamp = 0;
+        record->failure_counter = 0;
     }
 
-    memcpy(record, stored, sizeof(*record));
-
     return true;
 }
 
@@ -125,20 +374,158 @@ bool GatekeeperDevice::ClearFailureRecord(uint32_t uid, ::gatekeeper::secure_id_
 {
     ALOGV("%s: secure=%d", __func__, secure);
 
-    ::gatekeeper::failure_record_t* stored = &failure_map_[uid];
+    ::gatekeeper::failure_record_t stored;
 
-    stored->secure_user_id = user_id;
-    stored->last_checked_timestamp = 0;
-    stored->failure_counter = 0;
+    /* Nothing to clear is the common case, do not grow the log for it */
+    if (!failure_store_->Get(uid, secure, &stored) ||
+        (stored.secure_user_id == user_id && stored.failure_counter == 0 &&
+         stored.last_checked_timestamp == 0))
+        return true;
 
-    return true;
+    stored.secure_user_id = user_id;
+    stored.last_checked_timestamp = 0;
+    stored.failure_counter = 0;
+
+    /* Lowers throttling, so it can wait for the next batched sync */
+    return failure_store_->Write(uid, secure, stored, false);
 }
 
 bool GatekeeperDevice::WriteFailureRecord(uint32_t uid, ::gatekeeper::failure_record_t *record, bool secure)
 {
     ALOGV("%s: secure=%d", __func__, secure);
 
-    failure_map_[uid] = *record;
+    /* Must be on disk before the failed attempt is reported */
+    return failure_store_->Write(uid, secure, *record, true);
+}
+
+bool GatekeeperDevice::ForgetUser(uint32_t uid)
+{
+    std::lock_guard<std::mutex> lock(UserLock(uid));
+
+    {
+        std::lock_guard<std::mutex> fast_hash_lock(fast_hash_lock_);
+        auto it = fast_hash_map_.find(uid);
+        if (it != fast_hash_map_.end()) {
+            OPENSSL_cleanse(&it->second, sizeof(it->second));
+            fast_hash_map_.erase(it);
+        }
+    }
+
+    return failure_store_->Remove(uid);
+}
+
+bool GatekeeperDevice::ForgetAllUsers()
+{
+    /* Always in shard order, the only place that holds more than one */
+    std::array<std::unique_lock<std::mutex>, kUserLockShards> locks;
+    for (size_t i = 0; i < kUserLockShards; i++)
+        locks[i] = std::unique_lock<std::mutex>(user_locks_[i]);
+
+    {
+        std::lock_guard<std::mutex> fast_hash_lock(fast_hash_lock_);
+        for (auto& it : fast_hash_map_)
+            OPENSSL_cleanse(&it.second, sizeof(it.second));
+        fast_hash_map_.clear();
+    }
+
+    return failure_store_->RemoveAll();
+}
+
+void GatekeeperDevice::Dump(int fd)
+{
+    size_t entries;
+    {
+        std::lock_guard<std::mutex> fast_hash_lock(fast_hash_lock_);
+        entries = fast_hash_map_.size();
+    }
+
+    dprintf(fd, "\nscrypt workers: %zu, target %u ms, budget %zu KiB\n", scrypt_->size(),
+            scrypt_target_ms_, scrypt_budget_ / 1024);
+    scrypt_params_t params = EnrollParams();
+    dprintf(fd, "scrypt cost for new handles: N=2^%u r=%u p=%u\n", params.log2_n, params.r,
+            params.p);
+    dprintf(fd, "fast hash cache: %zu entries\n", entries);
+    dprintf(fd, "entropy pool: %llu refills of %zu bytes\n",
+            (unsigned long long)entropy_->refills(), EntropyPool::kPoolSize);
+    failure_store_->Dump(fd);
+}
+
+void GatekeeperDevice::ComputeFastHash(const ::gatekeeper::password_handle_t *handle,
+                                       const ::gatekeeper::SizedBuffer &password, uint64_t salt,
+                                       uint8_t *digest) const
+{
+    SHA256_CTX ctx;
+
+    /* Streamed, so no copy of the password is left behind in a scratch buffer */
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, &salt, sizeof(salt));
+    SHA256_Update(&ctx, handle->signature, sizeof(handle->signature));
+    SHA256_Update(&ctx, password.Data<uint8_t>(), password.size());
+    SHA256_Final(digest, &ctx);
+    OPENSSL_cleanse(&ctx, sizeof(ctx));
+}
+
+bool GatekeeperDevice::VerifyFast(const fast_hash_t &fast_hash,
+                                  const ::gatekeeper::password_handle_t *handle,
+                                  const ::gatekeeper::SizedBuffer &password) const
+{
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+
+    ComputeFastHash(handle, password, fast_hash.salt, digest);
+    bool match = CRYPTO_memcmp(digest, fast_hash.digest, sizeof(digest)) == 0;
+    OPENSSL_cleanse(digest, sizeof(digest));
+    return match;
+}
+
+bool GatekeeperDevice::DoVerify(const ::gatekeeper::password_handle_t *expected_handle,
+                                const ::gatekeeper::SizedBuffer &password)
+{
+    const uint32_t uid = tls_scrypt_call.uid;
+    uint64_t now = GetMillisecondsSinceBoot();
+
+    /*
+     * A mismatch falls through to scrypt and keeps the entry: a typo
+     * must not cost the next attempt its fast path. Guessing is
+     * throttled by GateKeeper::Verify() before either path runs.
+     */
+    fast_hash_t cached;
+    bool have_cached = false;
+    {
+        std::lock_guard<std::mutex> lock(fast_hash_lock_);
+        auto it = fast_hash_map_.find(uid);
+        if (it != fast_hash_map_.end()) {
+            if (now - it->second.timestamp >= kFastHashLifetimeMs) {
+                OPENSSL_cleanse(&it->second, sizeof(it->second));
+                fast_hash_map_.erase(it);
+            } else {
+                cached = it->second;
+                have_cached = true;
+            }
+        }
+    }
+
+    if (have_cached) {
+        bool match = VerifyFast(cached, expected_handle, password);
+        OPENSSL_cleanse(&cached, sizeof(cached));
+        if (match)
+            return true;
+    }
+
+    tls_scrypt_call.verifying = true;
+    bool verified = ::gatekeeper::GateKeeper::DoVerify(expected_handle, password);
+    tls_scrypt_call.verifying = false;
+    if (!verified)
+        return false;
+
+    fast_hash_t fast_hash;
+    GetRandom(&fast_hash.salt, sizeof(fast_hash.salt));
+    ComputeFastHash(expected_handle, password, fast_hash.salt, fast_hash.digest);
+    fast_hash.timestamp = now;
+    {
+        std::lock_guard<std::mutex> lock(fast_hash_lock_);
+        fast_hash_map_[uid] = fast_hash;
+    }
+    OPENSSL_cleanse(&fast_hash, sizeof(fast_hash));
     return true;
 }
 
@@ -17,16 +17,25 @@
 #pragma once
 
 extern "C" {
+#include <openssl/mem.h>
 #include <openssl/rand.h>
 #include <openssl/sha.h>
 
 #include <crypto_scrypt.h>
 }
 
+#include <array>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
 
 #include <gatekeeper/gatekeeper.h>
+#include <gatekeeper/password_handle.h>
+
+#include "EntropyPool.h"
+#include "FailureRecordStore.h"
+#include "ScryptPool.h"
 
 namespace android {
 namespace hardware {
@@ -34,21 +43,90 @@ namespace gatekeeper {
 namespace V1_0 {
 namespace implementation {
 
+/*
+ * SHA-256 over salt, the handle's signature and the password, kept
+ * after a successful scrypt verify so that repeat unlocks within
+ * kFastHashLifetimeMs skip scrypt. Hashing the signature in ties the
+ * entry to the handle it was verified against: once the password is
+ * changed the new handle never matches an old entry.
+ *
+ * Entries are keyed by the Android uid the verify was made for, so
+ * ForgetUser() finds them whether or not the uid has a failure record.
+ */
 typedef
 struct fast_hash_s
 {
     uint64_t salt;
     uint8_t digest[SHA256_DIGEST_LENGTH];
+    uint64_t timestamp;                 /* GetMillisecondsSinceBoot() of the scrypt verify */
 } fast_hash_t;
 
-typedef std::unordered_map<uint32_t, ::gatekeeper::failure_record_t> FailureRecordMap;
-typedef std::unordered_map<uint64_t, fast_hash_t> FastHashMap;
+/*
+ * scrypt cost of a password handle. Handles enrolled with anything but
+ * the default N=16384, r=8, p=1 carry their parameters after the
+ * libgatekeeper handle; a handle without them predates calibration and
+ * uses the defaults. Tampering with the trailer only makes the handle
+ * fail to verify, since the signature was computed with the real cost.
+ */
+typedef
+struct __attribute__((packed)) scrypt_params_s
+{
+    uint32_t magic;
+    uint8_t log2_n;
+    uint8_t r;
+    uint8_t p;
+    uint8_t reserved;
+} scrypt_params_t;
+
+typedef std::unordered_map<uint32_t, fast_hash_t> FastHashMap;
 
 class GatekeeperDevice : public ::gatekeeper::GateKeeper {
 public:
+    /* Calls for uids that share a shard are serialised */
+    static constexpr size_t kUserLockShards = 16;
+
+    static constexpr size_t kMaxHandleLength =
+            sizeof(::gatekeeper::password_handle_t) + sizeof(scrypt_params_t);
+
+    /* Configured from ro.vendor.gatekeeper.scrypt_target_ms and scrypt_budget_kib */
     GatekeeperDevice();
-    ~GatekeeperDevice() = default;
 
+    /*
+     * With a @scrypt_target_ms the first enrollment picks the largest N
+     * whose scrypt takes no longer than that, and whose work area
+     * (128 * r * N bytes) fits @scrypt_budget; 0 keeps the defaults.
+     */
+    GatekeeperDevice(const std::string& failure_record_path, uint32_t scrypt_target_ms,
+                     size_t scrypt_budget);
+    ~GatekeeperDevice();
+
+    /*
+     * GateKeeper::Enroll() and Verify() under the lock of the request's
+     * uid. Verify() reads the failure record, checks the throttle, runs
+     * scrypt and then writes the record back; two guesses for one uid
+     * must not both pass the throttle on the same record.
+     *
+     * The request handles are libgatekeeper's part only; @current and
+     * @params are what SplitHandle() found after it. Enroll() returns
+     * the parameters of the new handle in @enrolled.
+     */
+    void Enroll(const ::gatekeeper::EnrollRequest &request, ::gatekeeper::EnrollResponse *response,
+                const scrypt_params_t &current, scrypt_params_t *enrolled);
+    void Verify(const ::gatekeeper::VerifyRequest &request, ::gatekeeper::VerifyResponse *response,
+                const scrypt_params_t &params);
+
+    /*
+     * Length of the libgatekeeper part of @handle and its scrypt cost; 0
+     * if the cost is more than this device could have enrolled with.
+     */
+    size_t SplitHandle(const uint8_t *handle, size_t length, scrypt_params_t *params) const;
+
+    /* @handle, then @params unless they are the defaults, into @out of kMaxHandleLength bytes */
+    static size_t JoinHandle(const ::gatekeeper::SizedBuffer &handle, const scrypt_params_t &params,
+                             uint8_t *out);
+
+    /* Parameters for new handles, calibrated on first use */
+    scrypt_params_t EnrollParams();
 
     virtual bool GetAuthTokenKey(const uint8_t **auth_token_key, uint32_t *length) const;
     virtual void GetPasswordKey(const uint8_t **password_key, uint32_t *length);
@@ -56,8 +134,9 @@ public:
                                           const uint8_t*, uint32_t, const uint8_t* password,
                                           uint32_t password_length, ::gatekeeper::salt_t salt) const;
     virtual void GetRandom(void *random, uint32_t requested_size) const;
-    virtual void ComputeSignature(uint8_t* signature, uint32_t signature_length, const uint8_t*,
-                                  uint32_t, const uint8_t*, const uint32_t) const;
+    virtual void ComputeSignature(uint8_t* signature, uint32_t signature_length, const uint8_t* key,
+                                  uint32_t key_length, const uint8_t* message,
+                                  const uint32_t length) const;
     virtual uint64_t GetMillisecondsSinceBoot() const;
     virtual bool GetFailureRecord(uint32_t uid, ::gatekeeper::secure_id_t user_id,
                                   ::gatekeeper::failure_record_t *record, bool secure);
@@ -65,9 +144,48 @@ public:
     virtual bool WriteFailureRecord(uint32_t uid, ::gatekeeper::failure_record_t *record, bool secure);
     virtual bool IsHardwareBacked() const;
 
+    /* Drop the throttling state and cached verifies of one user, or of all of them */
+    bool ForgetUser(uint32_t uid);
+    bool ForgetAllUsers();
+
+    void Dump(int fd);
+
+protected:
+    virtual bool DoVerify(const ::gatekeeper::password_handle_t *expected_handle,
+                          const ::gatekeeper::SizedBuffer &password);
+
 private:
-    std::unique_ptr<uint8_t[]> key_;
-    FailureRecordMap failure_map_;
+    void CalibrateScrypt();
+    static void HmacKeySchedule(const uint8_t *key, size_t length, SHA256_CTX *inner,
+                                SHA256_CTX *outer);
+    void ComputeFastHash(const ::gatekeeper::password_handle_t *handle,
+                         const ::gatekeeper::SizedBuffer &password, uint64_t salt,
+                         uint8_t *digest) const;
+    bool VerifyFast(const fast_hash_t &fast_hash, const ::gatekeeper::password_handle_t *handle,
+                    const ::gatekeeper::SizedBuffer &password) const;
+    std::mutex& UserLock(uint32_t uid) { return user_locks_[uid % kUserLockShards]; }
+
+    /*
+     * Auth tokens are signed with a key drawn at start, so with every
+     * boot. The SHA-256 states after absorbing key ^ ipad and key ^ opad
+     * are kept: an HMAC then costs one block of each, not four.
+     */
+    std::unique_ptr<uint8_t[]> auth_token_key_;
+    SHA256_CTX auth_token_inner_;
+    SHA256_CTX auth_token_outer_;
+    std::unique_ptr<uint8_t[]> password_key_;
+    std::unique_ptr<EntropyPool> entropy_;
+    std::unique_ptr<ScryptPool> scrypt_;
+    const uint32_t scrypt_target_ms_;
+    const size_t scrypt_budget_;
+    uint8_t scrypt_max_log2_n_;         /* largest N the budget allows, and SplitHandle() accepts */
+    std::once_flag calibrate_once_;
+    scrypt_params_t enroll_params_;
+    std::unique_ptr<FailureRecordStore> failure_store_;
+
+    std::array<std::mutex, kUserLockShards> user_locks_;
+
+    std::mutex fast_hash_lock_;         /* fast_hash_map_ only; never held across scrypt */
     FastHashMap fast_hash_map_;
 };
 
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <log/log.h>
+
+#include <algorithm>
+
+#include "ScryptPool.h"
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+ScryptPool::ScryptPool(uint64_t maxN, uint32_t r, size_t workers)
+{
+    std::vector<unsigned> cpus = ScryptWorker::FastestCluster();
+
+    if (workers == 0)
+        workers = std::min(std::max<size_t>(cpus.size(), 1), kMaxWorkers);
+
+    for (size_t i = 0; i < workers; i++) {
+        workers_.emplace_back(new ScryptWorker(maxN, r, cpus));
+        idle_.push_back(workers_.back().get());
+    }
+    ALOGI("%s: %zu scrypt workers", __func__, workers_.size());
+}
+
+int ScryptPool::Compute(const uint8_t *password, size_t password_length, const uint8_t *salt,
+                        size_t salt_length, uint64_t N, uint32_t r, uint32_t p, uint8_t *out,
+                        size_t out_length)
+{
+    ScryptWorker *worker;
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+        cond_.wait(lock, [this] { return !idle_.empty(); });
+        worker = idle_.back();
+        idle_.pop_back();
+    }
+
+    int result = worker->Compute(password, password_length, salt, salt_length, N, r, p, out,
+                                 out_length);
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        idle_.push_back(worker);
+    }
+    cond_.notify_one();
+    return result;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
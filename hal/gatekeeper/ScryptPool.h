@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ScryptWorker.h"
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * A few ScryptWorkers for concurrent callers. Each worker owns a 16 MiB
+ * arena, so there are as many as the fastest cluster has CPUs, capped at
+ * kMaxWorkers; every worker is pinned to the whole cluster and the
+ * scheduler spreads them over its cores. A caller takes an idle worker,
+ * or waits for one.
+ */
+class ScryptPool
+{
+public:
+    static constexpr size_t kMaxWorkers = 2;
+
+    /* @workers of 0 sizes the pool from the fastest cluster */
+    ScryptPool(uint64_t maxN, uint32_t r, size_t workers = 0);
+
+    ScryptPool(const ScryptPool&) = delete;
+    ScryptPool& operator=(const ScryptPool&) = delete;
+
+    /* Same contract as ScryptWorker::Compute() */
+    int Compute(const uint8_t *password, size_t password_length, const uint8_t *salt,
+                size_t salt_length, uint64_t N, uint32_t r, uint32_t p, uint8_t *out,
+                size_t out_length);
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    std::vector<std::unique_ptr<ScryptWorker>> workers_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::vector<ScryptWorker*> idle_;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
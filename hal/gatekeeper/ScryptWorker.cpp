@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <log/log.h>
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <openssl/evp.h>
+#include <openssl/mem.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "ScryptWorker.h"
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+static const char *kCpufreqDir = "/sys/devices/system/cpu/cpufreq";
+static constexpr unsigned kMaxCpus = 16;
+
+/*
+ * Four 32-bit lanes. The Salsa20 state is held by diagonals:
+ *   a = x0 x5 x10 x15,  b = x4 x9 x14 x3,  c = x8 x13 x2 x7,  d = x12 x1 x6 x11
+ * so a column round is four vector quarter-rounds, and rotating b, c
+ * and d by one, two and three lanes lines the rows up the same way.
+ */
+#if defined(__ARM_NEON)
+typedef uint32x4_t vec4;
+
+static inline vec4 Load(const uint32_t *p) { return vld1q_u32(p); }
+static inline void Store(uint32_t *p, vec4 v) { vst1q_u32(p, v); }
+static inline vec4 Add(vec4 a, vec4 b) { return vaddq_u32(a, b); }
+static inline vec4 Xor(vec4 a, vec4 b) { return veorq_u32(a, b); }
+template <int n> static inline vec4 Rotl(vec4 v) { return vsriq_n_u32(vshlq_n_u32(v, n), v, 32 - n); }
+template <int n> static inline vec4 Lanes(vec4 v) { return vextq_u32(v, v, n); }
+#else
+struct vec4 { uint32_t w[4]; };
+
+static inline vec4 Load(const uint32_t *p) { vec4 v; memcpy(v.w, p, sizeof(v.w)); return v; }
+static inline void Store(uint32_t *p, vec4 v) { memcpy(p, v.w, sizeof(v.w)); }
+static inline vec4 Add(vec4 a, vec4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.w[i] += b.w[i];
+    return a;
+}
+static inline vec4 Xor(vec4 a, vec4 b)
+{
+    for (int i = 0; i < 4; i++)
+        a.w[i] ^= b.w[i];
+    return a;
+}
+template <int n> static inline vec4 Rotl(vec4 v)
+{
+    for (int i = 0; i < 4; i++)
+        v.w[i] = (v.w[i] << n) | (v.w[i] >> (32 - n));
+    return v;
+}
+template <int n> static inline vec4 Lanes(vec4 v)
+{
+    vec4 r;
+    for (int i = 0; i < 4; i++)
+        r.w[i] = v.w[(i + n) % 4];
+    return r;
+}
+#endif
+
+/* Word i of a block in diagonal order is word kDiagonal[i] of the RFC layout */
+static const uint8_t kDiagonal[16] = { 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 1, 6, 11 };
+
+/* x = Salsa20/8(x ^ in ^ in2); @in2 may be null */
+static inline void Salsa20_8Xor(vec4 x[4], const uint32_t *in, const uint32_t *in2)
+{
+    vec4 a = Xor(x[0], Load(in));
+    vec4 b = Xor(x[1], Load(in + 4));
+    vec4 c = Xor(x[2], Load(in + 8));
+    vec4 d = Xor(x[3], Load(in + 12));
+
+    if (in2 != nullptr) {
+        a = Xor(a, Load(in2));
+        b = Xor(b, Load(in2 + 4));
+        c = Xor(c, Load(in2 + 8));
+        d = Xor(d, Load(in2 + 12));
+    }
+
+    const vec4 a0 = a, b0 = b, c0 = c, d0 = d;
+
+    for (int i = 0; i < 8; i += 2) {
+        /* Columns */
+        b = Xor(b, Rotl<7>(Add(a, d)));
+        c = Xor(c, Rotl<9>(Add(b, a)));
+        d = Xor(d, Rotl<13>(Add(c, b)));
+        a = Xor(a, Rotl<18>(Add(d, c)));
+
+        b = Lanes<3>(b);
+        c = Lanes<2>(c);
+        d = Lanes<1>(d);
+
+        /* Rows, with the roles of b and d swapped */
+        d = Xor(d, Rotl<7>(Add(a, b)));
+        c = Xor(c, Rotl<9>(Add(d, a)));
+        b = Xor(b, Rotl<13>(Add(c, d)));
+        a = Xor(a, Rotl<18>(Add(b, c)));
+
+        b = Lanes<1>(b);
+        c = Lanes<2>(c);
+        d = Lanes<3>(d);
+    }
+
+    x[0] = Add(a, a0);
+    x[1] = Add(b, b0);
+    x[2] = Add(c, c0);
+    x[3] = Add(d, d0);
+}
+
+/* out = BlockMix_salsa20/8(in ^ in2) over 2 * r 64-byte blocks; @in2 may be null */
+static void BlockMix(const uint32_t *in, const uint32_t *in2, uint32_t *out, uint32_t r)
+{
+    const uint32_t *last = in + (2 * r - 1) * 16;
+    vec4 x[4];
+
+    for (int k = 0; k < 4; k++) {
+        x[k] = Load(last + 4 * k);
+        if (in2 != nullptr)
+            x[k] = Xor(x[k], Load(in2 + (2 * r - 1) * 16 + 4 * k));
+    }
+
+    /* Even blocks go to the first half of the output, odd ones to the second */
+    for (uint32_t i = 0; i < r; i++) {
+        Salsa20_8Xor(x, in + 32 * i, in2 ? in2 + 32 * i : nullptr);
+        for (int k = 0; k < 4; k++)
+            Store(out + 16 * i + 4 * k, x[k]);
+
+        Salsa20_8Xor(x, in + 32 * i + 16, in2 ? in2 + 32 * i + 16 : nullptr);
+        for (int k = 0; k < 4; k++)
+            Store(out + 16 * (r + i) + 4 * k, x[k]);
+    }
+}
+
+/* ROMix on one 128 * r byte block of B, in place */
+static void SMix(uint8_t *B, uint32_t r, uint64_t N, uint32_t *V, uint32_t *XY)
+{
+    const size_t words = 32 * r;
+    uint32_t *X = XY;
+    uint32_t *Y = XY + words;
+
+    for (size_t k = 0; k < 2 * r; k++) {
+        for (int i = 0; i < 16; i++) {
+            const uint8_t *p = &B[(k * 16 + kDiagonal[i]) * 4];
+            X[k * 16 + i] = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+    }
+
+    for (uint64_t i = 0; i < N; i += 2) {
+        memcpy(&V[i * words], X, words * sizeof(uint32_t));
+        BlockMix(X, nullptr, Y, r);
+        memcpy(&V[(i + 1) * words], Y, words * sizeof(uint32_t));
+        BlockMix(Y, nullptr, X, r);
+    }
+
+    /* Integerify: word 0 of the last block, x0 in either order */
+    for (uint64_t i = 0; i < N; i += 2) {
+        uint64_t j = X[(2 * r - 1) * 16] & (N - 1);
+        BlockMix(X, &V[j * words], Y, r);
+        j = Y[(2 * r - 1) * 16] & (N - 1);
+        BlockMix(Y, &V[j * words], X, r);
+    }
+
+    for (size_t k = 0; k < 2 * r; k++) {
+        for (int i = 0; i < 16; i++) {
+            uint8_t *p = &B[(k * 16 + kDiagonal[i]) * 4];
+            uint32_t w = X[k * 16 + i];
+            p[0] = w;
+            p[1] = w >> 8;
+            p[2] = w >> 16;
+            p[3] = w >> 24;
+        }
+    }
+}
+
+std::vector<unsigned> ScryptWorker::FastestCluster()
+{
+    std::vector<unsigned> best;
+    uint64_t bestFreq = 0;
+
+    /* Policies are named after their first CPU: policy0 and policy4 on RK3399 */
+    for (unsigned cpu = 0; cpu < kMaxCpus; cpu++) {
+        const std::string dir = ::android::base::StringPrintf("%s/policy%u", kCpufreqDir, cpu);
+        std::string freq, related;
+        if (!::android::base::ReadFileToString(dir + "/cpuinfo_max_freq", &freq) ||
+            !::android::base::ReadFileToString(dir + "/related_cpus", &related))
+            continue;
+
+        uint64_t value = strtoull(freq.c_str(), nullptr, 10);
+        if (value <= bestFreq)
+            continue;
+
+        bestFreq = value;
+        best.clear();
+        for (const auto& token : ::android::base::Split(::android::base::Trim(related), " ")) {
+            if (!token.empty())
+                best.push_back(strtoul(token.c_str(), nullptr, 10));
+        }
+    }
+
+    return best;
+}
+
+ScryptWorker::ScryptWorker(uint64_t maxN, uint32_t r, const std::vector<unsigned>& cpus)
+    : max_n_(maxN), r_(r), cpus_(cpus), arena_(nullptr), arena_size_(0), locked_(false),
+      job_(nullptr), exit_(false)
+{
+    if (cpus_.empty())
+        cpus_ = FastestCluster();
+
+    /* V, then X and Y, then B for up to kMaxParallel blocks */
+    arena_size_ = 128 * r * maxN + 256 * r + 128 * r * kMaxParallel;
+    void *arena = mmap(nullptr, arena_size_, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (arena == MAP_FAILED) {
+        ALOGE("%s: Error mapping %zu bytes: %s", __func__, arena_size_, strerror(errno));
+        arena_size_ = 0;
+        return;
+    }
+    arena_ = static_cast<uint8_t*>(arena);
+
+    /* Keep password-derived state out of core dumps and, if allowed, out of swap/zram */
+    madvise(arena_, arena_size_, MADV_DONTDUMP);
+    locked_ = mlock(arena_, arena_size_) == 0;
+    if (!locked_)
+        ALOGW("%s: Arena not locked (%s), check RLIMIT_MEMLOCK", __func__, strerror(errno));
+
+    thread_ = std::thread(&ScryptWorker::ThreadLoop, this);
+}
+
+ScryptWorker::~ScryptWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        exit_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+
+    if (arena_ != nullptr)
+        munmap(arena_, arena_size_);
+}
+
+int ScryptWorker::Compute(const uint8_t *password, size_t password_length, const uint8_t *salt,
+                          size_t salt_length, uint64_t N, uint32_t r, uint32_t p, uint8_t *out,
+                          size_t out_length)
+{
+    if (arena_ == nullptr || r != r_ || N > max_n_ || N < 2 || (N & (N - 1)) != 0 ||
+        p == 0 || p > kMaxParallel)
+        return -1;
+
+    Job job = { password, password_length, salt, salt_length, N, r, p, out, out_length, -1, false };
+
+    std::lock_guard<std::mutex> call(call_lock_);
+    std::unique_lock<std::mutex> lock(lock_);
+    job_ = &job;
+    cond_.notify_all();
+    cond_.wait(lock, [&job] { return job.done; });
+    return job.result;
+}
+
+void ScryptWorker::Run(Job *job)
+{
+    const size_t blockSize = 128 * job->r;
+    uint32_t *V = reinterpret_cast<uint32_t*>(arena_);
+    uint32_t *XY = reinterpret_cast<uint32_t*>(arena_ + 128 * r_ * max_n_);
+    uint8_t *B = arena_ + 128 * r_ * max_n_ + 256 * r_;
+
+    if (!PKCS5_PBKDF2_HMAC(reinterpret_cast<const char*>(job->password), job->password_length,
+                           job->salt, job->salt_length, 1, EVP_sha256(), blockSize * job->p, B))
+        return;
+
+    for (uint32_t i = 0; i < job->p; i++)
+        SMix(B + i * blockSize, job->r, job->N, V, XY);
+
+    if (PKCS5_PBKDF2_HMAC(reinterpret_cast<const char*>(job->password), job->password_length,
+                          B, blockSize * job->p, 1, EVP_sha256(), job->out_length, job->out))
+        job->result = 0;
+
+    OPENSSL_cleanse(arena_, 128 * job->r * job->N);
+    OPENSSL_cleanse(XY, 256 * r_ + blockSize * job->p);
+}
+
+void ScryptWorker::ThreadLoop()
+{
+    if (!cpus_.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned cpu : cpus_)
+            CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            ALOGW("%s: Cannot pin to cpu%u-%u: %s", __func__, cpus_.front(), cpus_.back(),
+                  strerror(errno));
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+    for (;;) {
+        cond_.wait(lock, [this] { return job_ != nullptr || exit_; });
+        if (exit_)
+            return;
+
+        Job *job = job_;
+        job_ = nullptr;
+        lock.unlock();
+        Run(job);
+        lock.lock();
+
+        job->done = true;
+        cond_.notify_all();
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace gatekeeper {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * scrypt (RFC 7914) on a dedicated thread with a persistent work area.
+ *
+ * crypto_scrypt() mallocs and faults in 128 * r * N bytes (16 MiB for
+ * the gatekeeper parameters) on every call, and runs on whichever core
+ * the binder thread landed on. The worker instead maps its arena once,
+ * pre-faulted and mlock'd when RLIMIT_MEMLOCK allows, and pins itself
+ * to the cluster with the highest cpuinfo_max_freq (the A72s on
+ * RK3399) unless @cpus names others. The arena is wiped after every
+ * computation: V[0] is a single PBKDF2 of the password and must not
+ * outlive the call.
+ *
+ * Salsa20/8 keeps the four diagonals of the state in 4-lane vectors
+ * (NEON on arm64, plain arrays elsewhere), so a double round needs no
+ * shuffles beyond three lane rotations. Output is bit-identical to
+ * crypto_scrypt().
+ *
+ * Calls are serialised; Compute() fails for parameters the arena was
+ * not sized for, and the caller falls back to crypto_scrypt().
+ */
+class ScryptWorker
+{
+public:
+    static constexpr uint32_t kMaxParallel = 4;
+
+    ScryptWorker(uint64_t maxN, uint32_t r, const std::vector<unsigned>& cpus = {});
+    ~ScryptWorker();
+
+    ScryptWorker(const ScryptWorker&) = delete;
+    ScryptWorker& operator=(const ScryptWorker&) = delete;
+
+    /* Same contract as crypto_scrypt(): 0 on success, -1 on failure */
+    int Compute(const uint8_t *password, size_t password_length, const uint8_t *salt,
+                size_t salt_length, uint64_t N, uint32_t r, uint32_t p, uint8_t *out,
+                size_t out_length);
+
+    bool IsLocked() const { return locked_; }
+
+    /* CPUs of the cpufreq policy with the highest cpuinfo_max_freq, empty if there is no cpufreq */
+    static std::vector<unsigned> FastestCluster();
+
+private:
+    struct Job {
+        const uint8_t *password;
+        size_t password_length;
+        const uint8_t *salt;
+        size_t salt_length;
+        uint64_t N;
+        uint32_t r;
+        uint32_t p;
+        uint8_t *out;
+        size_t out_length;
+        int result;
+        bool done;
+    };
+
+    void Run(Job *job);
+    void ThreadLoop();
+
+    const uint64_t max_n_;
+    const uint32_t r_;
+    std::vector<unsigned> cpus_;
+
+    uint8_t *arena_;
+    size_t arena_size_;
+    bool locked_;
+
+    std::mutex call_lock_;              /* one computation at a time, the arena is shared */
+    std::mutex lock_;
+    std::condition_variable cond_;
+    Job *job_;
+    bool exit_;
+    std::thread thread_;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace gatekeeper
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Enroll and verify latency of the gatekeeper HAL, measured in process
+ * against GatekeeperDevice, without binder or system_server:
+ *
+ *   android.hardware.gatekeeper@1.0-benchmark.rockchip [-n count] [-t target_ms] [-b budget_kib]
+ *
+ * First bare scrypt at the default cost is timed on a worker pinned to
+ * each cpufreq policy in turn. Then @count fresh passwords are enrolled
+ * and verified twice: enroll and the first verify run scrypt, the
+ * second takes the fast hash path. With -t the device calibrates its
+ * cost as the service does for ro.vendor.gatekeeper.scrypt_target_ms,
+ * and the parameters it picked are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include "BenchUtil.h"
+#include "GatekeeperDevice.h"
+
+using namespace android::hardware::gatekeeper::V1_0::implementation;
+using namespace android::hardware::rockchip;
+
+static const char *kFailureRecordPath = "/data/local/tmp/gatekeeper_benchmark_records";
+static constexpr unsigned kMaxCpus = 64;
+
+struct Cluster {
+    std::string name;
+    std::vector<unsigned> cpus;
+};
+
+static std::vector<Cluster> Clusters()
+{
+    std::vector<Cluster> clusters;
+
+    for (unsigned cpu = 0; cpu < kMaxCpus; cpu++) {
+        std::string related;
+        if (!android::base::ReadFileToString(android::base::StringPrintf(
+                    "/sys/devices/system/cpu/cpufreq/policy%u/related_cpus", cpu), &related))
+            continue;
+
+        Cluster cluster;
+        cluster.name = android::base::StringPrintf("policy%u", cpu);
+        for (const auto& token : android::base::Split(android::base::Trim(related), " ")) {
+            if (!token.empty())
+                cluster.cpus.push_back(strtoul(token.c_str(), nullptr, 10));
+        }
+        clusters.push_back(cluster);
+    }
+
+    return clusters;
+}
+
+static ::gatekeeper::SizedBuffer Buffer(const void *data, size_t length)
+{
+    uint8_t *buffer = new uint8_t[length];
+    memcpy(buffer, data, length);
+    return { buffer, static_cast<uint32_t>(length) };
+}
+
+static void BenchScrypt(unsigned count)
+{
+    static const uint8_t kPassword[] = "benchmark";
+    uint64_t salt = 0;
+    uint8_t out[32];
+
+    for (const Cluster& cluster : Clusters()) {
+        ScryptWorker worker(16384, 8, cluster.cpus);
+        std::vector<double> ms;
+
+        for (unsigned i = 0; i < count; i++) {
+            salt++;
+            ms.push_back(TimeMs([&] {
+                worker.Compute(kPassword, sizeof(kPassword), reinterpret_cast<uint8_t*>(&salt),
+                               sizeof(salt), 16384, 8, 1, out, sizeof(out));
+            }));
+        }
+
+        std::string name = android::base::StringPrintf("scrypt %s (cpu%u-%u)", cluster.name.c_str(),
+                                                       cluster.cpus.front(), cluster.cpus.back());
+        Report(name.c_str(), ms, "ms");
+    }
+}
+
+static int BenchDevice(unsigned count, uint32_t target_ms, size_t budget)
+{
+    GatekeeperDevice device(kFailureRecordPath, target_ms, budget);
+    std::vector<double> enroll_ms, verify_ms, fast_ms;
+    int failures = 0;
+
+    scrypt_params_t params = device.EnrollParams();
+    printf("scrypt cost for new handles: N=2^%u r=%u p=%u%s\n", params.log2_n, params.r, params.p,
+           target_ms ? " (calibrated)" : "");
+
+    for (unsigned i = 0; i < count; i++) {
+        std::string password = android::base::StringPrintf("benchmark-%u", i);
+        const uint32_t uid = 0;
+
+        ::gatekeeper::EnrollRequest enroll_request(uid, {}, Buffer(password.data(), password.size()), {});
+        ::gatekeeper::EnrollResponse enroll_response;
+        scrypt_params_t enrolled;
+        enroll_ms.push_back(TimeMs([&] {
+            device.Enroll(enroll_request, &enroll_response, params, &enrolled);
+        }));
+        if (enroll_response.error != ::gatekeeper::ERROR_NONE) {
+            failures++;
+            continue;
+        }
+
+        /* Round trip the handle the way the HIDL service hands it out */
+        uint8_t handle[GatekeeperDevice::kMaxHandleLength];
+        size_t length = GatekeeperDevice::JoinHandle(enroll_response.enrolled_password_handle,
+                                                     enrolled, handle);
+
+        for (auto *ms : { &verify_ms, &fast_ms }) {
+            scrypt_params_t handle_params;
+            size_t handle_length = device.SplitHandle(handle, length, &handle_params);
+            ::gatekeeper::VerifyRequest request(uid, i, Buffer(handle, handle_length),
+                                                Buffer(password.data(), password.size()));
+            ::gatekeeper::VerifyResponse response;
+            ms->push_back(TimeMs([&] { device.Verify(request, &response, handle_params); }));
+            if (response.error != ::gatekeeper::ERROR_NONE)
+                failures++;
+        }
+    }
+
+    Report("enroll", enroll_ms, "ms");
+    Report("verify (scrypt)", verify_ms, "ms");
+    Report("verify (fast hash)", fast_ms, "ms");
+    if (failures)
+        printf("%d enrolls or verifies failed\n", failures);
+
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = 20;
+    uint32_t target_ms = 0;
+    size_t budget = 128 * 8 * 16384;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:b:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            target_ms = strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            budget = strtoull(optarg, nullptr, 10) * 1024;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n count] [-t target_ms] [-b budget_kib]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (count == 0)
+        count = 1;
+
+    BenchScrypt(count);
+    int result = BenchDevice(count, target_ms, budget);
+    unlink(kFailureRecordPath);
+    return result;
+}
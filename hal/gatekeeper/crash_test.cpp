@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Crash injection test of FailureRecordStore:
+ *
+ *   android.hardware.gatekeeper@1.0-crash-test.rockchip [-n runs] [-u uids] [-s seed]
+ *
+ * Each run forks a child that opens the store and keeps counting failed
+ * attempts for @uids users, as WriteFailureRecord() does, with a clear
+ * of the secure record now and then that is only synced in the
+ * background. After every synced write the child reports the counter
+ * to the parent over a pipe. The parent SIGKILLs the child after a
+ * random delay, wherever it is: mid-append, mid-sync or mid-compaction.
+ * It then reopens the store and checks that no acknowledged counter was
+ * lost and that every record read back is one the child wrote. A torn
+ * tail appended by hand must be cut off the same way. Exits non-zero on
+ * any violation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FailureRecordStore.h"
+
+using namespace android::hardware::gatekeeper::V1_0::implementation;
+using ::gatekeeper::failure_record_t;
+
+static const char *kScratchDir = "/data/local/tmp/gatekeeper_crash_test";
+static constexpr uint32_t kMaxKillDelayUs = 20000;
+
+/* Secure records only ever hold this user id, and are only ever cleared */
+static uint64_t SecureUserId(uint32_t uid)
+{
+    return uid + 100;
+}
+
+struct Ack {
+    uint32_t uid;
+    uint32_t counter;
+};
+
+static void RunChild(const std::string& path, uint32_t uids, int fd)
+{
+    FailureRecordStore store(path);
+
+    for (uint32_t n = 1;; n++) {
+        uint32_t uid = n % uids;
+        failure_record_t record;
+        uint32_t counter = store.Get(uid, false, &record) ? record.failure_counter : 0;
+
+        record = { uid, n, counter + 1 };
+        if (!store.Write(uid, false, record, true))
+            _exit(1);
+
+        if (n % 3 == 0) {
+            failure_record_t cleared = { SecureUserId(uid), 0, 0 };
+            store.Write(uid, true, cleared, false);
+        }
+
+        Ack ack = { uid, counter + 1 };
+        if (write(fd, &ack, sizeof(ack)) != sizeof(ack))
+            _exit(1);
+    }
+}
+
+/* Reopens the store and checks it against the highest acknowledged counters */
+static unsigned Check(const std::string& path, std::vector<uint32_t>& acked, int run)
+{
+    FailureRecordStore store(path);
+    unsigned errors = 0;
+
+    for (uint32_t uid = 0; uid < acked.size(); uid++) {
+        failure_record_t record = {};
+        uint32_t counter = 0;
+
+        if (store.Get(uid, false, &record)) {
+            counter = record.failure_counter;
+            if (record.secure_user_id != uid) {
+                printf("run %d uid %u: secure_user_id %llu\n", run, uid,
+                       (unsigned long long)record.secure_user_id);
+                errors++;
+            }
+        }
+        if (counter < acked[uid]) {
+            printf("run %d uid %u: counter %u, %u was acknowledged\n", run, uid, counter,
+                   acked[uid]);
+            errors++;
+        }
+        acked[uid] = counter;
+
+        if (store.Get(uid, true, &record) &&
+            (record.secure_user_id != SecureUserId(uid) || record.failure_counter != 0)) {
+            printf("run %d uid %u: bad secure record\n", run, uid);
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned runs = 300, uids = 8, seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:u:s:")) != -1) {
+        switch (opt) {
+        case 'n':
+            runs = strtoul(optarg, nullptr, 10);
+            break;
+        case 'u':
+            uids = strtoul(optarg, nullptr, 10);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n runs] [-u uids] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (uids == 0)
+        uids = 1;
+
+    const std::string path = std::string(kScratchDir) + "/failure_records";
+    if (mkdir(kScratchDir, 0700) < 0 && errno != EEXIST) {
+        fprintf(stderr, "%s: %s\n", kScratchDir, strerror(errno));
+        return 1;
+    }
+    unlink(path.c_str());
+    unlink((path + ".tmp").c_str());
+
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> acked(uids, 0);
+    unsigned errors = 0;
+    uint64_t acks = 0;
+
+    for (unsigned run = 0; run < runs; run++) {
+        int pipefd[2];
+        if (pipe(pipefd) < 0) {
+            perror("pipe");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            close(pipefd[0]);
+            RunChild(path, uids, pipefd[1]);
+        }
+
+        close(pipefd[1]);
+        usleep(rng() % kMaxKillDelayUs);
+        kill(pid, SIGKILL);
+
+        /* Whatever reached the pipe was acknowledged before the kill */
+        Ack ack;
+        while (read(pipefd[0], &ack, sizeof(ack)) == sizeof(ack)) {
+            if (ack.uid < uids && ack.counter > acked[ack.uid])
+                acked[ack.uid] = ack.counter;
+            acks++;
+        }
+        close(pipefd[0]);
+        waitpid(pid, nullptr, 0);
+
+        errors += Check(path, acked, run);
+    }
+
+    /* A write torn by power loss rather than a kill */
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd >= 0) {
+        static const char kTorn[] = "torn-entry";
+        (void)write(fd, kTorn, sizeof(kTorn) - 1);
+        close(fd);
+    }
+    errors += Check(path, acked, runs);
+
+    uint64_t total = 0;
+    for (uint32_t counter : acked)
+        total += counter;
+
+    printf("%u runs, %llu acknowledged writes, %llu failures counted, %u errors\n", runs,
+           (unsigned long long)acks, (unsigned long long)total, errors);
+    fflush(stdout);
+    FailureRecordStore(path).Dump(STDOUT_FILENO);
+
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+    return errors == 0 ? 0 : 1;
+}
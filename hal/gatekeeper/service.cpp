@@ -29,11 +29,14 @@ using namespace android::hardware;
 using namespace android::hardware::gatekeeper::V1_0;
 using namespace android::hardware::gatekeeper::V1_0::implementation;
 
+/* Verifies of different users run side by side, up to the scrypt workers; the rest wait in the HAL */
+static constexpr size_t kBinderThreads = 4;
+
 int main(void)
 {
     android::sp<IGatekeeper> hal = new implementation::Gatekeeper();
 
-    configureRpcThreadpool(1, true);
+    configureRpcThreadpool(kBinderThreads, true);
 
     const auto result = hal->registerAsService();
     CHECK_EQ(result, android::OK);
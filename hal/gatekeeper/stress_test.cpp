@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Concurrency stress test of GatekeeperDevice, its per-uid locks and
+ * the scrypt pool, run in process without binder:
+ *
+ *   android.hardware.gatekeeper@1.0-stress-test.rockchip [-u uids] [-t threads]
+ *
+ * ScryptWorker must produce the very bytes crypto_scrypt() does, or no
+ * existing handle verifies any more. It is first checked against the
+ * RFC 7914 test vectors that fit its limits, then against crypto_scrypt()
+ * for random passwords, salts and output lengths at every N up to the
+ * default, with r of 1 and 8 and p up to kMaxParallel.
+ *
+ * Then @threads threads share @uids users, each enrolling its users and
+ * verifying them with a mix of right and wrong passwords; every answer
+ * must be the expected one. Then all threads guess wrong for a single
+ * uid at once. libgatekeeper lets four failures through and answers the
+ * fifth with a 30 s timeout, so exactly four ERROR_INVALID and a failure
+ * counter of 5 show that no two guesses passed the throttle on the same
+ * record. Exits non-zero on any violation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/stringprintf.h>
+
+#include "GatekeeperDevice.h"
+
+using namespace android::hardware::gatekeeper::V1_0::implementation;
+
+static const char *kFailureRecordPath = "/data/local/tmp/gatekeeper_stress_records";
+static constexpr size_t kScryptBudget = 128 * 8 * 16384;
+static constexpr uint32_t kContendedUid = 1000000;
+static constexpr unsigned kGuessesPerThread = 3;
+static constexpr uint32_t kThrottledAfter = 5;
+
+/* Each user's verify sequence; a success between failures resets the counter */
+static const bool kAttempts[] = { true, false, true, true, false, false, true };
+
+struct ScryptVector {
+    const char *password;
+    const char *salt;
+    uint64_t N;
+    uint32_t r;
+    uint32_t p;
+    uint8_t key[64];
+};
+
+/* RFC 7914 section 12; the other two need p=16 and N=2^20 */
+static const ScryptVector kScryptVectors[] = {
+    { "", "", 16, 1, 1, {
+        0x77, 0xd6, 0x57, 0x62, 0x38, 0x65, 0x7b, 0x20, 0x3b, 0x19, 0xca, 0x42, 0xc1, 0x8a, 0x04, 0x97,
+        0xf1, 0x6b, 0x48, 0x44, 0xe3, 0x07, 0x4a, 0xe8, 0xdf, 0xdf, 0xfa, 0x3f, 0xed, 0xe2, 0x14, 0x42,
+        0xfc, 0xd0, 0x06, 0x9d, 0xed, 0x09, 0x48, 0xf8, 0x32, 0x6a, 0x75, 0x3a, 0x0f, 0xc8, 0x1f, 0x17,
+        0xe8, 0xd3, 0xe0, 0xfb, 0x2e, 0x0d, 0x36, 0x28, 0xcf, 0x35, 0xe2, 0x0c, 0x38, 0xd1, 0x89, 0x06,
+    } },
+    { "pleaseletmein", "SodiumChloride", 16384, 8, 1, {
+        0x70, 0x23, 0xbd, 0xcb, 0x3a, 0xfd, 0x73, 0x48, 0x46, 0x1c, 0x06, 0xcd, 0x81, 0xfd, 0x38, 0xeb,
+        0xfd, 0xa8, 0xfb, 0xba, 0x90, 0x4f, 0x8e, 0x3e, 0xa9, 0xb5, 0x43, 0xf6, 0x54, 0x5d, 0xa1, 0xf2,
+        0xd5, 0x43, 0x29, 0x55, 0x61, 0x3f, 0x0f, 0xcf, 0x62, 0xd4, 0x97, 0x05, 0x24, 0x2a, 0x9a, 0xf9,
+        0xe6, 0x1e, 0x85, 0xdc, 0x0d, 0x65, 0x1e, 0x40, 0xdf, 0xcf, 0x01, 0x7b, 0x45, 0x57, 0x58, 0x87,
+    } },
+};
+
+static constexpr uint64_t kScryptMaxN = 16384;
+static constexpr unsigned kScryptRandomRuns = 4;
+
+static unsigned CheckScrypt()
+{
+    std::mt19937 rng(1);
+    unsigned errors = 0, checked = 0;
+
+    for (const auto& v : kScryptVectors) {
+        ScryptWorker worker(v.N, v.r);
+        uint8_t key[sizeof(v.key)];
+
+        if (worker.Compute(reinterpret_cast<const uint8_t*>(v.password), strlen(v.password),
+                           reinterpret_cast<const uint8_t*>(v.salt), strlen(v.salt), v.N, v.r, v.p,
+                           key, sizeof(key)) != 0 || memcmp(key, v.key, sizeof(key)) != 0) {
+            printf("scrypt N=%llu r=%u p=%u of \"%s\": RFC 7914 mismatch\n",
+                   (unsigned long long)v.N, v.r, v.p, v.password);
+            errors++;
+        }
+    }
+
+    for (uint32_t r : { 1, 8 }) {
+        ScryptWorker worker(kScryptMaxN, r);
+
+        for (uint64_t N = 2; N <= kScryptMaxN; N <<= 1) {
+            for (uint32_t p = 1; p <= ScryptWorker::kMaxParallel; p++) {
+                for (unsigned run = 0; run < kScryptRandomRuns; run++) {
+                    uint8_t password[64], salt[32], expected[80], key[80];
+                    size_t password_length = rng() % (sizeof(password) + 1);
+                    size_t salt_length = rng() % (sizeof(salt) + 1);
+                    size_t key_length = 1 + rng() % sizeof(key);
+
+                    for (auto& b : password)
+                        b = rng();
+                    for (auto& b : salt)
+                        b = rng();
+
+                    if (crypto_scrypt(password, password_length, salt, salt_length, N, r, p,
+                                      expected, key_length) != 0 ||
+                        worker.Compute(password, password_length, salt, salt_length, N, r, p, key,
+                                       key_length) != 0 ||
+                        memcmp(key, expected, key_length) != 0) {
+                        printf("scrypt N=%llu r=%u p=%u: differs from crypto_scrypt\n",
+                               (unsigned long long)N, r, p);
+                        errors++;
+                    }
+                    checked++;
+                }
+            }
+        }
+    }
+
+    printf("scrypt: %zu RFC 7914 vectors, %u random inputs against crypto_scrypt, %u errors\n",
+           sizeof(kScryptVectors) / sizeof(kScryptVectors[0]), checked, errors);
+    return errors;
+}
+
+static ::gatekeeper::SizedBuffer Buffer(const void *data, size_t length)
+{
+    uint8_t *buffer = new uint8_t[length];
+    memcpy(buffer, data, length);
+    return { buffer, static_cast<uint32_t>(length) };
+}
+
+struct Handle {
+    uint8_t data[GatekeeperDevice::kMaxHandleLength];
+    size_t length;
+};
+
+static bool Enroll(GatekeeperDevice& device, uint32_t uid, const std::string& password,
+                   Handle *handle, uint64_t *user_id)
+{
+    ::gatekeeper::EnrollRequest request(uid, {}, Buffer(password.data(), password.size()), {});
+    ::gatekeeper::EnrollResponse response;
+    scrypt_params_t enrolled;
+
+    device.Enroll(request, &response, device.EnrollParams(), &enrolled);
+    if (response.error != ::gatekeeper::ERROR_NONE)
+        return false;
+
+    handle->length = GatekeeperDevice::JoinHandle(response.enrolled_password_handle, enrolled,
+                                                  handle->data);
+    *user_id = response.enrolled_password_handle.Data<::gatekeeper::password_handle_t>()->user_id;
+    return true;
+}
+
+static ::gatekeeper::gatekeeper_error_t Verify(GatekeeperDevice& device, uint32_t uid,
+                                               const Handle& handle, const std::string& password)
+{
+    scrypt_params_t params;
+    size_t length = device.SplitHandle(handle.data, handle.length, &params);
+    ::gatekeeper::VerifyRequest request(uid, 1, Buffer(handle.data, length),
+                                        Buffer(password.data(), password.size()));
+    ::gatekeeper::VerifyResponse response;
+
+    device.Verify(request, &response, params);
+    return response.error;
+}
+
+static unsigned StressUsers(GatekeeperDevice& device, unsigned uids, unsigned threads)
+{
+    std::atomic<unsigned> errors(0);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (uint32_t uid = t; uid < uids; uid += threads) {
+                const std::string password = android::base::StringPrintf("stress-%u", uid);
+                Handle handle;
+                uint64_t user_id;
+
+                if (!Enroll(device, uid, password, &handle, &user_id)) {
+                    printf("uid %u: enroll failed\n", uid);
+                    errors++;
+                    continue;
+                }
+
+                for (bool right : kAttempts) {
+                    auto error = Verify(device, uid, handle, right ? password : "wrong");
+                    if ((error == ::gatekeeper::ERROR_NONE) != right) {
+                        printf("uid %u: %s password got error %d\n", uid, right ? "right" : "wrong",
+                               error);
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u uids x (1 enroll + %zu verifies) on %u threads in %.2f s, %u errors\n", uids,
+           sizeof(kAttempts) / sizeof(kAttempts[0]), threads, secs, errors.load());
+    return errors;
+}
+
+static unsigned StressOneUser(GatekeeperDevice& device, unsigned threads)
+{
+    Handle handle;
+    uint64_t user_id;
+
+    if (!Enroll(device, kContendedUid, "right", &handle, &user_id)) {
+        printf("uid %u: enroll failed\n", kContendedUid);
+        return 1;
+    }
+
+    std::atomic<unsigned> invalid(0), retry(0), other(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (unsigned i = 0; i < kGuessesPerThread; i++) {
+                auto error = Verify(device, kContendedUid, handle, "wrong");
+                if (error == ::gatekeeper::ERROR_INVALID)
+                    invalid++;
+                else if (error == ::gatekeeper::ERROR_RETRY)
+                    retry++;
+                else
+                    other++;
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    ::gatekeeper::failure_record_t record = {};
+    device.GetFailureRecord(kContendedUid, user_id, &record, false);
+
+    printf("%u concurrent wrong guesses for one uid: %u invalid, %u retry, %u other, "
+           "failure counter %u\n", threads * kGuessesPerThread, invalid.load(), retry.load(),
+           other.load(), record.failure_counter);
+
+    bool ok = other == 0 && invalid == kThrottledAfter - 1 &&
+              record.failure_counter == kThrottledAfter;
+    if (!ok)
+        printf("expected %u invalid and a failure counter of %u\n", kThrottledAfter - 1,
+               kThrottledAfter);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned uids = 64, threads = 8;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "u:t:")) != -1) {
+        switch (opt) {
+        case 'u':
+            uids = strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            threads = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-u uids] [-t threads]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (uids == 0)
+        uids = 1;
+    /* Fewer would never reach the throttle in the single-uid test */
+    threads = std::max(threads, (kThrottledAfter + kGuessesPerThread - 1) / kGuessesPerThread);
+
+    unsigned errors = CheckScrypt();
+
+    unlink(kFailureRecordPath);
+    {
+        GatekeeperDevice device(kFailureRecordPath, 0, kScryptBudget);
+
+        errors += StressUsers(device, uids, threads);
+        errors += StressOneUser(device, threads);
+
+        fflush(stdout);
+        device.Dump(STDOUT_FILENO);
+        device.ForgetAllUsers();
+    }
+    unlink(kFailureRecordPath);
+
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <stdio.h>
+
+#include <hidl/HidlTransportSupport.h>
+
+#include "CallbackDispatcher.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+CallbackDispatcher::CallbackDispatcher(const DropHandler& onDrop)
+    : mOnDrop(onDrop),
+      mList(std::make_shared<const List>()),
+      mSlot{},
+      mPending(false),
+      mExit(false),
+      mPosted(0),
+      mRounds(0),
+      mDropped(0)
+{
+    mThread = std::thread(&CallbackDispatcher::ThreadLoop, this);
+}
+
+CallbackDispatcher::~CallbackDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCond.notify_one();
+    mThread.join();
+}
+
+std::shared_ptr<const CallbackDispatcher::List> CallbackDispatcher::GetList()
+{
+    std::lock_guard<std::mutex> lock(mListLock);
+    return mList;
+}
+
+void CallbackDispatcher::Add(const sp<IHealthInfoCallback>& callback)
+{
+    std::lock_guard<std::mutex> lock(mListLock);
+
+    auto list = std::make_shared<List>(*mList);
+    list->push_back(callback);
+    mList = std::move(list);
+}
+
+bool CallbackDispatcher::Remove(const sp<IBase>& callback)
+{
+    std::lock_guard<std::mutex> lock(mListLock);
+    auto list = std::make_shared<List>();
+
+    list->reserve(mList->size());
+    for (const auto& entry : *mList) {
+        if (!interfacesEqual(entry, callback))
+            list->push_back(entry);
+    }
+
+    bool removed = list->size() != mList->size();
+    mList = std::move(list);
+    return removed;
+}
+
+void CallbackDispatcher::Post(const HealthInfo& info)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mSlot = info;
+        mPending = true;
+        mPosted++;
+    }
+    mCond.notify_one();
+}
+
+void CallbackDispatcher::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    for (;;) {
+        mCond.wait(lock, [this] { return mPending || mExit; });
+        if (mExit)
+            return;
+
+        HealthInfo info = mSlot;
+        mPending = false;
+        mRounds++;
+        lock.unlock();
+
+        std::shared_ptr<const List> list = GetList();
+        std::vector<sp<IHealthInfoCallback>> dropped;
+        for (const auto& callback : *list) {
+            /* Oneway: a client that stopped draining fails here, it never blocks the round */
+            auto ret = callback->healthInfoChanged(info);
+            if (!ret.isOk()) {
+                ALOGW("%s: healthInfoChanged failed: %s", __func__, ret.description().c_str());
+                dropped.push_back(callback);
+            }
+        }
+
+        for (const auto& callback : dropped)
+            mOnDrop(callback);
+
+        lock.lock();
+        mDropped += dropped.size();
+    }
+}
+
+void CallbackDispatcher::Dump(int fd)
+{
+    size_t clients = GetList()->size();
+    std::lock_guard<std::mutex> lock(mLock);
+
+    dprintf(fd, "\ncallbacks: %zu clients, %llu posted, %llu delivered, %llu coalesced, %llu dropped\n",
+            clients, (unsigned long long)mPosted, (unsigned long long)mRounds,
+            (unsigned long long)(mPosted - mRounds - (mPending ? 1 : 0)),
+            (unsigned long long)mDropped);
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_CALLBACKDISPATCHER_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_CALLBACKDISPATCHER_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+#include <android/hardware/health/2.0/IHealthInfoCallback.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using ::android::sp;
+using ::android::hidl::base::V1_0::IBase;
+
+/*
+ * Delivers healthInfoChanged() to the registered clients from its own
+ * thread, so neither the binder thread nor the power_supply monitor
+ * ever waits on a client.
+ *
+ * Posting writes a single-slot mailbox: if the thread is still busy
+ * with an earlier HealthInfo, the newer one replaces whatever was
+ * waiting and only the latest state is delivered.
+ *
+ * The client list is an immutable snapshot replaced on every
+ * registration change; a delivery round iterates the snapshot it took
+ * without holding any lock, so registering never waits for a round.
+ * healthInfoChanged() is oneway: it returns once the transaction is
+ * queued and fails instead of blocking when the client stopped draining
+ * its async buffer or died. A client whose call fails is handed to
+ * @onDrop and not called again.
+ */
+class CallbackDispatcher
+{
+public:
+    typedef std::function<void(const sp<IHealthInfoCallback>&)> DropHandler;
+
+    explicit CallbackDispatcher(const DropHandler& onDrop);
+    ~CallbackDispatcher();
+
+    void Add(const sp<IHealthInfoCallback>& callback);
+    bool Remove(const sp<IBase>& callback);
+
+    void Post(const HealthInfo& info);
+
+    void Dump(int fd);
+
+private:
+    typedef std::vector<sp<IHealthInfoCallback>> List;
+
+    std::shared_ptr<const List> GetList();
+    void ThreadLoop();
+
+    const DropHandler mOnDrop;
+
+    std::mutex mListLock;
+    std::shared_ptr<const List> mList;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    HealthInfo mSlot;
+    bool mPending;
+    bool mExit;
+
+    /* Statistics for debug(), under mLock */
+    uint64_t mPosted;
+    uint64_t mRounds;
+    uint64_t mDropped;
+
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_CALLBACKDISPATCHER_H
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+
+#include "DiskStatsCollector.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+static const char *kBlockPath = "/sys/block";
+
+/* The rk3399 eMMC controller, unless the bootloader names the boot device */
+static const char *kDefaultBootDevice = "fe330000.sdhci";
+
+/* The first eleven fields of /sys/block/<disk>/stat, in file order */
+static uint64_t DiskStats::* const kStatFields[] = {
+    &DiskStats::reads,
+    &DiskStats::readMerges,
+    &DiskStats::readSectors,
+    &DiskStats::readTicks,
+    &DiskStats::writes,
+    &DiskStats::writeMerges,
+    &DiskStats::writeSectors,
+    &DiskStats::writeTicks,
+    &DiskStats::ioInFlight,
+    &DiskStats::ioTicks,
+    &DiskStats::ioInQueue,
+};
+
+/* Partitions-only, virtual or special-purpose block devices */
+static bool IsDisk(const std::string& name)
+{
+    static const char * const kSkipPrefixes[] = { "loop", "ram", "zram", "dm-", "md" };
+
+    for (const char *prefix : kSkipPrefixes) {
+        if (::android::base::StartsWith(name, prefix))
+            return false;
+    }
+    /* eMMC hardware partitions */
+    return name.find("boot") == std::string::npos && name.find("rpmb") == std::string::npos;
+}
+
+static std::string ReadAttr(const std::string& path)
+{
+    std::string value;
+
+    if (!::android::base::ReadFileToString(path, &value))
+        return "";
+    return ::android::base::Trim(value);
+}
+
+DiskStatsCollector::DiskStatsCollector(const std::string& root)
+{
+    Discover(root);
+}
+
+DiskStatsCollector::~DiskStatsCollector()
+{
+    for (int fd : mFds)
+        close(fd);
+}
+
+void DiskStatsCollector::Discover(const std::string& root)
+{
+    const std::string blockDir = root + kBlockPath;
+    const std::string bootDevice =
+            ::android::base::GetProperty("ro.boot.bootdevice", kDefaultBootDevice);
+    std::vector<std::string> names;
+    std::vector<DiskStats> stats;
+
+    DIR *dir = opendir(blockDir.c_str());
+    if (dir == nullptr) {
+        ALOGE("%s: Error opening %s: %s", __func__, blockDir.c_str(), strerror(errno));
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        if (de->d_name[0] != '.' && IsDisk(de->d_name))
+            names.push_back(de->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    for (const auto& name : names) {
+        const std::string path = blockDir + "/" + name;
+        DiskStats disk = {};
+
+        int fd = open((path + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        /* /sys/block/<disk> links to the device node of its controller */
+        std::string target;
+        ::android::base::Readlink(path, &target);
+
+        const bool removable = ReadAttr(path + "/removable") == "1";
+        if (::android::base::StartsWith(name, "mmcblk")) {
+            /* device/type is "MMC" for eMMC, "SD" for cards */
+            disk.attr.name = ReadAttr(path + "/device/type") == "SD" ? "uSD" : "eMMC";
+        } else if (::android::base::StartsWith(name, "nvme")) {
+            disk.attr.name = "NVMe";
+        } else if (target.find("/usb") != std::string::npos) {
+            disk.attr.name = "USB";
+        } else {
+            disk.attr.name = name;
+        }
+        disk.attr.isBootDevice = target.find(bootDevice) != std::string::npos;
+        disk.attr.isInternal = disk.attr.isBootDevice ||
+                               (!removable && disk.attr.name != "USB" && disk.attr.name != "uSD");
+
+        ALOGI("%s: %s (%s%s%s)", __func__, name.c_str(), disk.attr.name.c_str(),
+              disk.attr.isInternal ? ", internal" : "", disk.attr.isBootDevice ? ", boot" : "");
+
+        mNames.push_back(name);
+        mFds.push_back(fd);
+        stats.push_back(disk);
+    }
+
+    mStats = stats;
+}
+
+void DiskStatsCollector::ReadLocked(size_t index)
+{
+    DiskStats& disk = mStats[index];
+    char buf[256];
+
+    ssize_t len = pread(mFds[index], buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return;
+    buf[len] = '\0';
+
+    /* Space separated decimal counters, right aligned */
+    const char *p = buf;
+    for (auto field : kStatFields) {
+        uint64_t value = 0;
+
+        while (*p == ' ')
+            p++;
+        while (*p >= '0' && *p <= '9')
+            value = value * 10 + (*p++ - '0');
+        disk.*field = value;
+    }
+}
+
+void DiskStatsCollector::Collect(const Consumer& consumer)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (size_t i = 0; i < mFds.size(); i++)
+        ReadLocked(i);
+
+    consumer(mStats);
+}
+
+bool DiskStatsCollector::GetDisk(const std::string& name, DiskStats *disk)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (size_t i = 0; i < mNames.size(); i++) {
+        if (mNames[i] == name) {
+            ReadLocked(i);
+            *disk = mStats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_DISKSTATSCOLLECTOR_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_DISKSTATSCOLLECTOR_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using ::android::hardware::hidl_vec;
+
+/*
+ * I/O counters of every disk for getDiskStats().
+ *
+ * The disks (eMMC, uSD, NVMe, USB mass storage) are discovered once
+ * under /sys/block and their stat files kept open. A collection preads
+ * each file into a stack buffer and parses the counters in place into a
+ * DiskStats vector that was sized and labelled at discovery, so the
+ * binder thread does not allocate.
+ */
+class DiskStatsCollector
+{
+public:
+    typedef std::function<void(const hidl_vec<DiskStats>&)> Consumer;
+
+    /* @root prefixes the sysfs paths, for testing against a fake tree */
+    explicit DiskStatsCollector(const std::string& root);
+    ~DiskStatsCollector();
+
+    /* Refreshes the counters and hands them to @consumer under the lock */
+    void Collect(const Consumer& consumer);
+
+    /* Attributes and current counters of the disk named @name in /sys/block */
+    bool GetDisk(const std::string& name, DiskStats *disk);
+
+private:
+    void Discover(const std::string& root);
+    void ReadLocked(size_t index);
+
+    std::mutex mLock;
+    std::vector<std::string> mNames;
+    std::vector<int> mFds;
+    hidl_vec<DiskStats> mStats;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_DISKSTATSCOLLECTOR_H
@@ -30,18 +30,46 @@ namespace health {
 namespace V2_0 {
 namespace implementation {
 
+static const char * const kMetricNames[METRIC_COUNT] = {
+    "registerCallback",
+    "unregisterCallback",
+    "update",
+    "getChargeCounter",
+    "getCurrentNow",
+    "getCurrentAverage",
+    "getCapacity",
+    "getEnergyCounter",
+    "getChargeStatus",
+    "getStorageInfo",
+    "getDiskStats",
+    "getHealthInfo",
+};
+
+Health::Health(const std::string& root)
+    : mMetrics(kMetricNames, METRIC_COUNT),
+      mDispatcher([this](const sp<IHealthInfoCallback>& callback) {
+          (void)unregisterCallbackInternal(callback);
+      }),
+      mDiskStats(root),
+      mStorage(root, mDiskStats),
+      mScheduler(root),
+      mTelemetry(root),
+      mMonitor(root, [this](const HealthInfo& info) { mDispatcher.Post(info); })
+{
+    mStorage.Start();
+    mTelemetry.Start();
+    mMonitor.Start();
+}
+
 // Methods from ::android::hardware::health::V2_0::IHealth follow.
 Return<health::V2_0::Result> Health::registerCallback(const sp<health::V2_0::IHealthInfoCallback>& callback)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_REGISTER_CALLBACK);
     if (callback == nullptr) {
         return Result::SUCCESS;
     }
 
-    {
-        std::lock_guard<decltype(mCallbacksLock)> lock(mCallbacksLock);
-        mCallbacks.push_back(callback);
-        // unlock
-    }
+    mDispatcher.Add(callback);
 
     auto linkRet = callback->linkToDeath(this, 0u /* cookie */);
     if (!linkRet.withDefault(false)) {
@@ -50,11 +78,17 @@ Return<health::V2_0::Result> Health::registerCallback(const sp<health::V2_0::IHe
         // ignore the error
     }
 
+    /* Give the new client the current state right away */
+    HealthInfo info;
+    mMonitor.GetHealthInfo(&info);
+    mDispatcher.Post(info);
+
     return Result::SUCCESS;
 }
 
 Return<health::V2_0::Result> Health::unregisterCallback(const sp<health::V2_0::IHealthInfoCallback>& callback)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_UNREGISTER_CALLBACK);
     return unregisterCallbackInternal(callback) ? Result::SUCCESS : Result::NOT_FOUND;
 }
 
@@ -63,16 +97,7 @@ bool Health::unregisterCallbackInternal(const sp<IBase>& callback)
     if (callback == nullptr)
         return false;
 
-    bool removed = false;
-    std::lock_guard<decltype(mCallbacksLock)> _lock(mCallbacksLock);
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end();) {
-        if (interfacesEqual(*it, callback)) {
-            it = mCallbacks.erase(it);
-            removed = true;
-        } else {
-            ++it;
-        }
-    }
+    bool removed = mDispatcher.Remove(callback);
     (void)callback->unlinkToDeath(this).isOk();  // ignore errors
     return removed;
 }
@@ -84,123 +109,152 @@ void Health::serviceDied(uint64_t /* cookie */, const wp<IBase>& who)
 
 Return<health::V2_0::Result> Health::update()
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_UPDATE);
     V2_0::HealthInfo healthInfo = {};
 
-    healthInfo.legacy.chargerAcOnline = true;
-    healthInfo.legacy.batteryPresent = false;
-    healthInfo.legacy.batteryLevel = 0;
-    healthInfo.legacy.batteryStatus = V1_0::BatteryStatus::UNKNOWN;
-    healthInfo.legacy.batteryHealth = V1_0::BatteryHealth::UNKNOWN;
-
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end();) {
-        (*it++)->healthInfoChanged(healthInfo);
-    }
+    mMonitor.Update(&healthInfo);
+    mDispatcher.Post(healthInfo);
 
     return Result::SUCCESS;
 }
 
 Return<void> Health::getChargeCounter(getChargeCounter_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, 0);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_CHARGE_COUNTER);
+    HealthInfo info;
+    mMonitor.GetHealthInfo(&info);
+    if (!info.legacy.batteryPresent) {
+        _hidl_cb(Result::NOT_SUPPORTED, 0);
+        return Void();
+    }
+    _hidl_cb(Result::SUCCESS, info.legacy.batteryChargeCounter);
     return Void();
 }
 
 Return<void> Health::getCurrentNow(getCurrentNow_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, 0);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_CURRENT_NOW);
+    int64_t now, average;
+    if (!mMonitor.GetCurrent(&now, &average)) {
+        _hidl_cb(Result::NOT_SUPPORTED, 0);
+        return Void();
+    }
+    _hidl_cb(Result::SUCCESS, now);
     return Void();
 }
 
 Return<void> Health::getCurrentAverage(getCurrentAverage_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, 0);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_CURRENT_AVERAGE);
+    int64_t now, average;
+    if (!mMonitor.GetCurrent(&now, &average)) {
+        _hidl_cb(Result::NOT_SUPPORTED, 0);
+        return Void();
+    }
+    _hidl_cb(Result::SUCCESS, average);
     return Void();
 }
 
 Return<void> Health::getCapacity(getCapacity_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, 0);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_CAPACITY);
+    HealthInfo info;
+    mMonitor.GetHealthInfo(&info);
+    if (!info.legacy.batteryPresent) {
+        _hidl_cb(Result::NOT_SUPPORTED, 0);
+        return Void();
+    }
+    _hidl_cb(Result::SUCCESS, info.legacy.batteryLevel);
     return Void();
 }
 
 Return<void> Health::getEnergyCounter(getEnergyCounter_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, 0);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_ENERGY_COUNTER);
+    /* No energy counter is read from power_supply, so do not pass 0 off as one */
+    _hidl_cb(Result::NOT_SUPPORTED, 0);
     return Void();
 }
 
 Return<void> Health::getChargeStatus(getChargeStatus_cb _hidl_cb)
 {
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::SUCCESS, V1_0::BatteryStatus::UNKNOWN);
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_CHARGE_STATUS);
+    HealthInfo info;
+    mMonitor.GetHealthInfo(&info);
+    _hidl_cb(Result::SUCCESS, info.legacy.batteryStatus);
     return Void();
 }
 
 Return<void> Health::getStorageInfo(getStorageInfo_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_STORAGE_INFO);
     hidl_vec<struct StorageInfo> info;
 
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::NOT_SUPPORTED, info);
+    mStorage.GetStorageInfo(&info);
+    _hidl_cb(info.size() ? Result::SUCCESS : Result::NOT_SUPPORTED, info);
     return Void();
 }
 
 Return<void> Health::getDiskStats(getDiskStats_cb _hidl_cb)
 {
-    std::vector<struct DiskStats> stats;
-    get_disk_stats(stats);
-
-    hidl_vec<struct DiskStats> stats_vec(stats);
-    if (!stats.size()) {
-        _hidl_cb(Result::NOT_SUPPORTED, stats_vec);
-    } else {
-        _hidl_cb(Result::SUCCESS, stats_vec);
-    }
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_DISK_STATS);
+    mDiskStats.Collect([&_hidl_cb](const hidl_vec<DiskStats>& stats) {
+        _hidl_cb(stats.size() ? Result::SUCCESS : Result::NOT_SUPPORTED, stats);
+    });
     return Void();
 }
 
 Return<void> Health::getHealthInfo(getHealthInfo_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_HEALTH_INFO);
     V2_0::HealthInfo healthInfo = {};
 
-    ALOGD("%s", __func__);
-    _hidl_cb(Result::NOT_SUPPORTED, healthInfo);
+    mMonitor.GetHealthInfo(&healthInfo);
+    mStorage.GetStorageInfo(&healthInfo.storageInfos);
+    mDiskStats.Collect([&healthInfo](const hidl_vec<DiskStats>& stats) {
+        healthInfo.diskStats = stats;
+    });
+
+    _hidl_cb(Result::SUCCESS, healthInfo);
     return Void();
 }
 
-void Health::get_disk_stats(std::vector<DiskStats>& vec_stats)
+std::chrono::milliseconds Health::periodicChores()
 {
-    const size_t kDiskStatsSize = 11;
-    const std::string kDiskStatsPath = "/sys/block/mmcblk1/stat";
-    struct DiskStats stats = {};
+    HealthInfo info;
 
-    stats.attr.isInternal = true;
-    stats.attr.isBootDevice = true;
-    stats.attr.name = std::string("uSD");
+    mMonitor.Poll(&info);
+    return mScheduler.Update(PollScheduler::Clock::now(), info);
+}
 
-    std::string buffer;
-    if (!::android::base::ReadFileToString(kDiskStatsPath, &buffer)) {
-        ALOGE("ReadFileToString(%s) failed", kDiskStatsPath.c_str());
-        return;
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> Health::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args)
+{
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1)
+        return Void();
+
+    bool reset = false, telemetry = false;
+    for (const auto& arg : args) {
+        if (arg == "--reset")
+            reset = true;
+        else if (arg == "--telemetry")
+            telemetry = true;
     }
 
-    // Regular diskstats entries
-    std::stringstream ss(buffer);
-    for (uint i = 0; i < kDiskStatsSize; ++i) {
-        ss >> *(reinterpret_cast<uint64_t*>(&stats) + i);
+    /* CSV only, so the output can be redirected straight into a file */
+    if (telemetry) {
+        mTelemetry.DumpCsv(fd->data[0]);
+        return Void();
     }
 
-    vec_stats.resize(1);
-    vec_stats[0] = stats;
+    mMetrics.Dump(fd->data[0], reset);
+    mDispatcher.Dump(fd->data[0]);
+    mScheduler.Dump(fd->data[0]);
+    mStorage.Dump(fd->data[0]);
+    mTelemetry.Dump(fd->data[0]);
+    return Void();
 }
 
-// Methods from ::android::hidl::base::V1_0::IBase follow.
-
 }  // namespace implementation
 }  // namespace V2_0
 }  // namespace health
@@ -22,6 +22,15 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include <HalMetrics.h>
+
+#include "CallbackDispatcher.h"
+#include "DiskStatsCollector.h"
+#include "PollScheduler.h"
+#include "PowerSupplyMonitor.h"
+#include "StorageMonitor.h"
+#include "TelemetrySampler.h"
+
 namespace android {
 namespace hardware {
 namespace health {
@@ -36,10 +45,32 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::sp;
 
+using ::android::hardware::hidl_handle;
+using ::android::hardware::rockchip::HalMetrics;
+
 using namespace android::hardware;
 
+enum HealthMetric {
+    METRIC_REGISTER_CALLBACK = 0,
+    METRIC_UNREGISTER_CALLBACK,
+    METRIC_UPDATE,
+    METRIC_GET_CHARGE_COUNTER,
+    METRIC_GET_CURRENT_NOW,
+    METRIC_GET_CURRENT_AVERAGE,
+    METRIC_GET_CAPACITY,
+    METRIC_GET_ENERGY_COUNTER,
+    METRIC_GET_CHARGE_STATUS,
+    METRIC_GET_STORAGE_INFO,
+    METRIC_GET_DISK_STATS,
+    METRIC_GET_HEALTH_INFO,
+    METRIC_COUNT,
+};
+
 struct Health : public IHealth, hidl_death_recipient
 {
+    /* @root prefixes the sysfs paths, for testing against a fake tree */
+    explicit Health(const std::string& root = "");
+
     // Methods from ::android::hardware::health::V2_0::IHealth follow.
     Return<health::V2_0::Result> registerCallback(const sp<health::V2_0::IHealthInfoCallback>& callback) override;
     Return<health::V2_0::Result> unregisterCallback(const sp<health::V2_0::IHealthInfoCallback>& callback) override;
@@ -57,12 +88,28 @@ struct Health : public IHealth, hidl_death_recipient
     void serviceDied(uint64_t cookie, const wp<IBase>& /* who */) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override;
+
+    /* Polls the power supplies from the service loop, returns the delay until the next poll */
+    std::chrono::milliseconds periodicChores();
+
+    /* The power_supply uevent socket the service loop waits on, -1 without one */
+    int ueventFd() const { return mMonitor.GetUeventFd(); }
+
+    /* Handles the queued uevents once ueventFd() polls readable */
+    void handleUevents() { mMonitor.HandleUevents(); }
 
 private:
-    std::vector<sp<IHealthInfoCallback>> mCallbacks;
-    std::recursive_mutex mCallbacksLock;
+    HalMetrics mMetrics;
+    CallbackDispatcher mDispatcher;
+    DiskStatsCollector mDiskStats;
+    StorageMonitor mStorage;
+    PollScheduler mScheduler;
+    TelemetrySampler mTelemetry;
+
+    /* Declared last: its listener posts to mDispatcher */
+    PowerSupplyMonitor mMonitor;
 
-    void get_disk_stats(std::vector<DiskStats>& vec_stats);
     bool unregisterCallbackInternal(const sp<IBase>& callback);
 };
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "PollScheduler.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using std::chrono::milliseconds;
+
+static const char *kBacklightDir = "/sys/class/backlight";
+
+PollScheduler::PollScheduler(const std::string& root)
+    : mBacklightFd(-1),
+      mHaveSample(false),
+      mLevel(0),
+      mCharging(false),
+      mInterval(kFastInterval),
+      mSamples(0),
+      mFastSamples(0)
+{
+    const std::string dirPath = root + kBacklightDir;
+    DIR *dir = opendir(dirPath.c_str());
+    if (dir == nullptr)
+        return;
+
+    struct dirent *de;
+    while (mBacklightFd < 0 && (de = readdir(dir)) != nullptr) {
+        if (de->d_name[0] == '.')
+            continue;
+        const std::string path = dirPath + "/" + de->d_name + "/brightness";
+        mBacklightFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    closedir(dir);
+}
+
+PollScheduler::~PollScheduler()
+{
+    if (mBacklightFd >= 0)
+        close(mBacklightFd);
+}
+
+bool PollScheduler::ScreenOn()
+{
+    char buf[16];
+
+    if (mBacklightFd < 0)
+        return false;
+
+    ssize_t len = pread(mBacklightFd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return false;
+    buf[len] = '\0';
+
+    return strtol(buf, nullptr, 10) > 0;
+}
+
+milliseconds PollScheduler::Update(Clock::time_point now, const HealthInfo& info)
+{
+    const V1_0::HealthInfo& legacy = info.legacy;
+    const bool charging = legacy.chargerAcOnline || legacy.chargerUsbOnline ||
+                          legacy.chargerWirelessOnline;
+    const bool screenOn = ScreenOn();
+    std::lock_guard<std::mutex> lock(mLock);
+
+    mSamples++;
+
+    /* Nothing drains without a battery, a slow poll covers late chargers */
+    if (!legacy.batteryPresent) {
+        mHaveSample = false;
+        mInterval = kSlowInterval;
+        return mInterval;
+    }
+
+    const bool moved = mHaveSample && (legacy.batteryLevel != mLevel || charging != mCharging);
+    if (!mHaveSample) {
+        mLastChange = now;
+        mFastUntil = now;
+    } else if (moved) {
+        /* Two steps within the window: the level is moving quickly */
+        if (now - mLastChange < kActiveWindow)
+            mFastUntil = now + kActiveWindow;
+        mLastChange = now;
+    }
+    mHaveSample = true;
+    mLevel = legacy.batteryLevel;
+    mCharging = charging;
+
+    if (charging || screenOn || now < mFastUntil) {
+        mInterval = kFastInterval;
+        mFastSamples++;
+    } else if (moved) {
+        mInterval = kFastInterval;
+    } else {
+        mInterval = std::min(mInterval * 2, kSlowInterval);
+    }
+
+    return mInterval;
+}
+
+void PollScheduler::Dump(int fd)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    dprintf(fd, "\npoll: interval %lld s, %llu samples, %llu fast\n",
+            (long long)std::chrono::duration_cast<std::chrono::seconds>(mInterval).count(),
+            (unsigned long long)mSamples, (unsigned long long)mFastSamples);
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
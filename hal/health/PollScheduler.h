@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_POLLSCHEDULER_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_POLLSCHEDULER_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+/*
+ * Picks the delay until the next periodic power_supply poll, in the
+ * spirit of healthd's fast and slow chore intervals. Fuel gauges do not
+ * send a uevent for every step, so the monitor still has to be polled
+ * now and then.
+ *
+ * The interval is kFastInterval while a charger is plugged in, while
+ * the screen is on, and for kActiveWindow after the battery level moved
+ * twice within kActiveWindow. Otherwise every stable sample doubles the
+ * interval up to kSlowInterval, and a single step of the level or the
+ * charger state starts the back-off over. The screen counts as on while the
+ * first backlight reports a non-zero brightness; boards without a
+ * backlight are treated as screen off.
+ *
+ * The scheduler only does arithmetic on the time it is given and never
+ * reads a clock, so it can be driven by a virtual one.
+ */
+class PollScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr std::chrono::milliseconds kFastInterval = std::chrono::seconds(60);
+    static constexpr std::chrono::milliseconds kSlowInterval = std::chrono::minutes(10);
+    static constexpr std::chrono::milliseconds kActiveWindow = std::chrono::minutes(10);
+
+    /* @root prefixes the sysfs paths, for testing against a fake tree */
+    explicit PollScheduler(const std::string& root);
+    ~PollScheduler();
+
+    /* Accounts a sample taken at @now, returns the delay until the next one */
+    std::chrono::milliseconds Update(Clock::time_point now, const HealthInfo& info);
+
+    void Dump(int fd);
+
+private:
+    bool ScreenOn();
+
+    int mBacklightFd;
+
+    std::mutex mLock;
+    bool mHaveSample;
+    int32_t mLevel;
+    bool mCharging;
+    Clock::time_point mLastChange;
+    Clock::time_point mFastUntil;
+    std::chrono::milliseconds mInterval;
+
+    /* Statistics for debug(), under mLock */
+    uint64_t mSamples;
+    uint64_t mFastSamples;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_POLLSCHEDULER_H
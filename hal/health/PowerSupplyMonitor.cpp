@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <cutils/uevent.h>
+
+#include "PowerSupplyMonitor.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using V1_0::BatteryHealth;
+using V1_0::BatteryStatus;
+
+static const char *kPowerSupplyPath = "/sys/class/power_supply";
+
+static constexpr size_t kUeventBufferSize = 64 * 1024;
+
+/* Indexed by PowerSupplyMonitor::Attr */
+static const char * const kAttrNames[] = {
+    "online",
+    "present",
+    "status",
+    "health",
+    "capacity",
+    "voltage_now",
+    "voltage_max",
+    "current_now",
+    "current_avg",
+    "current_max",
+    "temp",
+    "cycle_count",
+    "charge_full",
+    "charge_counter",
+    "technology",
+};
+
+static const struct {
+    const char *name;
+    BatteryStatus status;
+} kStatusMap[] = {
+    { "Charging", BatteryStatus::CHARGING },
+    { "Discharging", BatteryStatus::DISCHARGING },
+    { "Not charging", BatteryStatus::NOT_CHARGING },
+    { "Full", BatteryStatus::FULL },
+};
+
+static const struct {
+    const char *name;
+    BatteryHealth health;
+} kHealthMap[] = {
+    { "Good", BatteryHealth::GOOD },
+    { "Cold", BatteryHealth::COLD },
+    { "Cool", BatteryHealth::GOOD },
+    { "Warm", BatteryHealth::GOOD },
+    { "Overheat", BatteryHealth::OVERHEAT },
+    { "Hot", BatteryHealth::OVERHEAT },
+    { "Dead", BatteryHealth::DEAD },
+    { "Over voltage", BatteryHealth::OVER_VOLTAGE },
+    { "Unspecified failure", BatteryHealth::UNSPECIFIED_FAILURE },
+    { "Watchdog timer expire", BatteryHealth::UNSPECIFIED_FAILURE },
+    { "Safety timer expire", BatteryHealth::UNSPECIFIED_FAILURE },
+};
+
+static int64_t ParseStatus(const char *value)
+{
+    for (const auto& entry : kStatusMap) {
+        if (strcmp(value, entry.name) == 0)
+            return static_cast<int64_t>(entry.status);
+    }
+    return static_cast<int64_t>(BatteryStatus::UNKNOWN);
+}
+
+static int64_t ParseHealth(const char *value)
+{
+    for (const auto& entry : kHealthMap) {
+        if (strcmp(value, entry.name) == 0)
+            return static_cast<int64_t>(entry.health);
+    }
+    return static_cast<int64_t>(BatteryHealth::UNKNOWN);
+}
+
+/* Everything BatteryService reacts to; currents change on every read and are left out */
+static bool InfoChanged(const HealthInfo& a, const HealthInfo& b)
+{
+    const V1_0::HealthInfo& x = a.legacy;
+    const V1_0::HealthInfo& y = b.legacy;
+
+    return x.chargerAcOnline != y.chargerAcOnline ||
+           x.chargerUsbOnline != y.chargerUsbOnline ||
+           x.chargerWirelessOnline != y.chargerWirelessOnline ||
+           x.maxChargingCurrent != y.maxChargingCurrent ||
+           x.maxChargingVoltage != y.maxChargingVoltage ||
+           x.batteryStatus != y.batteryStatus ||
+           x.batteryHealth != y.batteryHealth ||
+           x.batteryPresent != y.batteryPresent ||
+           x.batteryLevel != y.batteryLevel ||
+           x.batteryVoltage != y.batteryVoltage ||
+           x.batteryTemperature != y.batteryTemperature ||
+           x.batteryCycleCount != y.batteryCycleCount ||
+           x.batteryFullCharge != y.batteryFullCharge ||
+           x.batteryChargeCounter != y.batteryChargeCounter ||
+           x.batteryTechnology != y.batteryTechnology;
+}
+
+PowerSupplyMonitor::PowerSupplyMonitor(const std::string& root, const Listener& listener)
+    : mRoot(root), mListener(listener), mInfo{}, mUeventFd(-1), mBuffer(kUeventBufferSize)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    DiscoverLocked();
+    for (auto& supply : mSupplies)
+        ReadSupplyLocked(supply);
+    BuildLocked(&mInfo);
+}
+
+PowerSupplyMonitor::~PowerSupplyMonitor()
+{
+    if (mUeventFd >= 0)
+        close(mUeventFd);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    CloseLocked();
+}
+
+void PowerSupplyMonitor::DiscoverLocked()
+{
+    const std::string dirPath = mRoot + kPowerSupplyPath;
+
+    CloseLocked();
+
+    DIR *dir = opendir(dirPath.c_str());
+    if (dir == nullptr) {
+        ALOGE("%s: Error opening %s: %s", __func__, dirPath.c_str(), strerror(errno));
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        if (de->d_name[0] == '.')
+            continue;
+
+        const std::string path = dirPath + "/" + de->d_name;
+        std::string type;
+        if (!::android::base::ReadFileToString(path + "/type", &type))
+            continue;
+        type = ::android::base::Trim(type);
+
+        Supply supply;
+        supply.name = de->d_name;
+        if (type == "Mains")
+            supply.type = SUPPLY_AC;
+        else if (::android::base::StartsWith(type, "USB"))
+            supply.type = SUPPLY_USB;
+        else if (type == "Wireless")
+            supply.type = SUPPLY_WIRELESS;
+        else if (type == "Battery")
+            supply.type = SUPPLY_BATTERY;
+        else
+            supply.type = SUPPLY_UNKNOWN;
+
+        /* Most attributes are optional, a missing one reads as 0 */
+        for (size_t i = 0; i < ATTR_COUNT; i++) {
+            supply.fds[i] = open((path + "/" + kAttrNames[i]).c_str(), O_RDONLY | O_CLOEXEC);
+            supply.values[i] = 0;
+        }
+
+        ALOGI("%s: %s (%s)", __func__, supply.name.c_str(), type.c_str());
+        mSupplies.push_back(supply);
+    }
+    closedir(dir);
+}
+
+void PowerSupplyMonitor::CloseLocked()
+{
+    for (const auto& supply : mSupplies) {
+        for (int fd : supply.fds) {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+    mSupplies.clear();
+}
+
+void PowerSupplyMonitor::ReadSupplyLocked(Supply& supply)
+{
+    char buf[64];
+
+    for (size_t i = 0; i < ATTR_COUNT; i++) {
+        if (supply.fds[i] < 0)
+            continue;
+
+        ssize_t len = pread(supply.fds[i], buf, sizeof(buf) - 1, 0);
+        if (len <= 0) {
+            supply.values[i] = 0;
+            continue;
+        }
+        while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+            len--;
+        buf[len] = '\0';
+
+        switch (i) {
+            case ATTR_STATUS:
+                supply.values[i] = ParseStatus(buf);
+                break;
+            case ATTR_HEALTH:
+                supply.values[i] = ParseHealth(buf);
+                break;
+            case ATTR_TECHNOLOGY:
+                supply.technology = buf;
+                break;
+            default:
+                supply.values[i] = strtoll(buf, nullptr, 10);
+                break;
+        }
+    }
+}
+
+void PowerSupplyMonitor::BuildLocked(HealthInfo *info)
+{
+    V1_0::HealthInfo& legacy = info->legacy;
+    bool battery = false;
+
+    legacy.chargerAcOnline = false;
+    legacy.chargerUsbOnline = false;
+    legacy.chargerWirelessOnline = false;
+    legacy.maxChargingCurrent = 0;
+    legacy.maxChargingVoltage = 0;
+
+    for (const auto& supply : mSupplies) {
+        const int64_t *v = supply.values;
+
+        if (supply.type == SUPPLY_BATTERY) {
+            if (battery)
+                continue;
+            battery = true;
+
+            /* Fuel gauges without a "present" attribute are always there */
+            legacy.batteryPresent = supply.fds[ATTR_PRESENT] < 0 || v[ATTR_PRESENT] != 0;
+            legacy.batteryStatus = static_cast<BatteryStatus>(v[ATTR_STATUS]);
+            legacy.batteryHealth = static_cast<BatteryHealth>(v[ATTR_HEALTH]);
+            legacy.batteryLevel = v[ATTR_CAPACITY];
+            legacy.batteryVoltage = v[ATTR_VOLTAGE_NOW] / 1000;
+            legacy.batteryTemperature = v[ATTR_TEMP];
+            legacy.batteryCurrent = v[ATTR_CURRENT_NOW];
+            legacy.batteryCycleCount = v[ATTR_CYCLE_COUNT];
+            legacy.batteryFullCharge = v[ATTR_CHARGE_FULL];
+            legacy.batteryChargeCounter = v[ATTR_CHARGE_COUNTER];
+            legacy.batteryTechnology = supply.technology;
+            info->batteryCurrentAverage = v[ATTR_CURRENT_AVG];
+            continue;
+        }
+
+        if (v[ATTR_ONLINE] == 0)
+            continue;
+
+        switch (supply.type) {
+            case SUPPLY_AC:
+                legacy.chargerAcOnline = true;
+                break;
+            case SUPPLY_USB:
+                legacy.chargerUsbOnline = true;
+                break;
+            case SUPPLY_WIRELESS:
+                legacy.chargerWirelessOnline = true;
+                break;
+            default:
+                continue;
+        }
+
+        legacy.maxChargingCurrent = std::max<int64_t>(legacy.maxChargingCurrent, v[ATTR_CURRENT_MAX]);
+        legacy.maxChargingVoltage = std::max<int64_t>(legacy.maxChargingVoltage, v[ATTR_VOLTAGE_MAX]);
+    }
+
+    if (!battery) {
+        /* Mains powered board */
+        legacy.chargerAcOnline = true;
+        legacy.batteryPresent = false;
+        legacy.batteryLevel = 0;
+        legacy.batteryStatus = BatteryStatus::UNKNOWN;
+        legacy.batteryHealth = BatteryHealth::UNKNOWN;
+    }
+}
+
+bool PowerSupplyMonitor::RefreshLocked(const char *name, HealthInfo *info)
+{
+    auto supply = std::find_if(mSupplies.begin(), mSupplies.end(),
+                               [name](const Supply& s) { return s.name == name; });
+
+    if (supply != mSupplies.end()) {
+        ReadSupplyLocked(*supply);
+    } else {
+        /* A supply we have not seen, e.g. a charger driver probed late */
+        DiscoverLocked();
+        for (auto& s : mSupplies)
+            ReadSupplyLocked(s);
+    }
+
+    HealthInfo updated = mInfo;
+    BuildLocked(&updated);
+    bool changed = InfoChanged(updated, mInfo);
+    mInfo = updated;
+
+    if (changed)
+        *info = updated;
+    return changed;
+}
+
+void PowerSupplyMonitor::HandleUevent(const char *msg, size_t len)
+{
+    const char *end = msg + len;
+    const char *name = nullptr;
+    bool powerSupply = false;
+
+    /* "change@/devices/...\0ACTION=change\0SUBSYSTEM=power_supply\0POWER_SUPPLY_NAME=battery\0..." */
+    for (const char *p = msg; p < end; p += strlen(p) + 1) {
+        if (strcmp(p, "SUBSYSTEM=power_supply") == 0)
+            powerSupply = true;
+        else if (strncmp(p, "POWER_SUPPLY_NAME=", strlen("POWER_SUPPLY_NAME=")) == 0)
+            name = p + strlen("POWER_SUPPLY_NAME=");
+    }
+
+    if (!powerSupply || name == nullptr)
+        return;
+
+    HealthInfo info;
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        changed = RefreshLocked(name, &info);
+    }
+
+    if (changed)
+        mListener(info);
+}
+
+void PowerSupplyMonitor::Update(HealthInfo *info)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (auto& supply : mSupplies)
+        ReadSupplyLocked(supply);
+    BuildLocked(&mInfo);
+    *info = mInfo;
+}
+
+void PowerSupplyMonitor::Poll(HealthInfo *info)
+{
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+
+        for (auto& supply : mSupplies)
+            ReadSupplyLocked(supply);
+
+        HealthInfo updated = mInfo;
+        BuildLocked(&updated);
+        changed = InfoChanged(updated, mInfo);
+        mInfo = updated;
+        *info = updated;
+    }
+
+    if (changed)
+        mListener(*info);
+}
+
+void PowerSupplyMonitor::GetHealthInfo(HealthInfo *info)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    *info = mInfo;
+}
+
+bool PowerSupplyMonitor::GetCurrent(int64_t *now, int64_t *average)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    char buf[32];
+
+    for (auto& supply : mSupplies) {
+        if (supply.type != SUPPLY_BATTERY)
+            continue;
+
+        for (Attr attr : { ATTR_CURRENT_NOW, ATTR_CURRENT_AVG }) {
+            ssize_t len = supply.fds[attr] >= 0 ? pread(supply.fds[attr], buf, sizeof(buf) - 1, 0) : -1;
+            if (len > 0) {
+                buf[len] = '\0';
+                supply.values[attr] = strtoll(buf, nullptr, 10);
+            }
+        }
+
+        *now = supply.values[ATTR_CURRENT_NOW];
+        *average = supply.values[ATTR_CURRENT_AVG];
+        return true;
+    }
+
+    return false;
+}
+
+void PowerSupplyMonitor::Start()
+{
+    mUeventFd = uevent_open_socket(kUeventBufferSize, true);
+    if (mUeventFd < 0) {
+        ALOGE("%s: Error opening uevent socket: %s", __func__, strerror(errno));
+        return;
+    }
+    fcntl(mUeventFd, F_SETFL, O_NONBLOCK);
+}
+
+void PowerSupplyMonitor::HandleUevents()
+{
+    /* Drain everything queued, several supplies often change together */
+    ssize_t len;
+    while ((len = uevent_kernel_multicast_recv(mUeventFd, mBuffer.data(), mBuffer.size() - 1)) > 0) {
+        mBuffer[len] = '\0';
+        HandleUevent(mBuffer.data(), len);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_POWERSUPPLYMONITOR_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_POWERSUPPLYMONITOR_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+/*
+ * Battery and charger state from /sys/class/power_supply.
+ *
+ * Every supply's attribute files are opened once at discovery. The
+ * kernel sends a power_supply uevent whenever a supply changes; only
+ * that supply is read again, the HealthInfo is rebuilt from the cached
+ * state of all supplies, and @listener runs only if the result differs
+ * from what it was last given. The monitor has no thread of its own:
+ * the service loop waits on GetUeventFd() next to binder and calls
+ * HandleUevents() when it is readable. Gauges that step without a
+ * uevent are caught by Poll(), on the interval chosen by PollScheduler.
+ *
+ * Boards without a battery keep reporting AC power, as before.
+ */
+class PowerSupplyMonitor
+{
+public:
+    typedef std::function<void(const HealthInfo&)> Listener;
+
+    /* @root prefixes the sysfs paths, for testing against a fake tree */
+    PowerSupplyMonitor(const std::string& root, const Listener& listener);
+    ~PowerSupplyMonitor();
+
+    /* Opens the uevent socket */
+    void Start();
+
+    /* The non-blocking uevent socket for the caller's event loop, -1 if it failed to open */
+    int GetUeventFd() const { return mUeventFd; }
+
+    /* Drains the uevent socket; called when GetUeventFd() polls readable */
+    void HandleUevents();
+
+    /* Re-reads every supply, for IHealth::update() */
+    void Update(HealthInfo *info);
+
+    /* Re-reads every supply for a periodic poll, @listener runs if anything moved */
+    void Poll(HealthInfo *info);
+
+    void GetHealthInfo(HealthInfo *info);
+
+    /* Reads the battery current afresh, it moves on every sample; false without a battery */
+    bool GetCurrent(int64_t *now, int64_t *average);
+
+    /* Handles one uevent message; public so recorded events can be replayed */
+    void HandleUevent(const char *msg, size_t len);
+
+private:
+    enum SupplyType {
+        SUPPLY_UNKNOWN = 0,
+        SUPPLY_AC,
+        SUPPLY_USB,
+        SUPPLY_WIRELESS,
+        SUPPLY_BATTERY,
+    };
+
+    enum Attr {
+        ATTR_ONLINE = 0,
+        ATTR_PRESENT,
+        ATTR_STATUS,
+        ATTR_HEALTH,
+        ATTR_CAPACITY,
+        ATTR_VOLTAGE_NOW,
+        ATTR_VOLTAGE_MAX,
+        ATTR_CURRENT_NOW,
+        ATTR_CURRENT_AVG,
+        ATTR_CURRENT_MAX,
+        ATTR_TEMP,
+        ATTR_CYCLE_COUNT,
+        ATTR_CHARGE_FULL,
+        ATTR_CHARGE_COUNTER,
+        ATTR_TECHNOLOGY,
+        ATTR_COUNT,
+    };
+
+    struct Supply {
+        std::string name;
+        SupplyType type;
+        int fds[ATTR_COUNT];
+        int64_t values[ATTR_COUNT];     /* status and health hold the HIDL enum */
+        std::string technology;
+    };
+
+    void DiscoverLocked();
+    void CloseLocked();
+    void ReadSupplyLocked(Supply& supply);
+    void BuildLocked(HealthInfo *info);
+    bool RefreshLocked(const char *name, HealthInfo *info);
+
+    const std::string mRoot;
+    const Listener mListener;
+
+    std::mutex mLock;
+    std::vector<Supply> mSupplies;
+    HealthInfo mInfo;
+
+    int mUeventFd;
+    std::vector<char> mBuffer;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_POWERSUPPLYMONITOR_H
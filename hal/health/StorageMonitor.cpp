@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include "StorageMonitor.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using ::android::base::StringPrintf;
+
+static const char *kMmcDevicesPath = "/sys/bus/mmc/devices";
+static const char *kStatePath = "/data/vendor/health/storage_wear";
+static const char *kBootIdPath = "/proc/sys/kernel/random/boot_id";
+
+/* Wear changes over weeks, an hourly look is plenty */
+static constexpr std::chrono::hours kRefreshPeriod(1);
+
+/* Typical rated erase cycles of the MLC eMMC parts these boards ship with */
+static constexpr uint64_t kRatedEraseCycles = 3000;
+
+static std::string ReadAttr(const std::string& path)
+{
+    std::string value;
+
+    if (!::android::base::ReadFileToString(path, &value))
+        return "";
+    return ::android::base::Trim(value);
+}
+
+StorageMonitor::StorageMonitor(const std::string& root, DiskStatsCollector& disks)
+    : mDisks(disks), mStatePath(root + kStatePath), mLoaded(false), mExit(false)
+{
+    mBootId = ReadAttr(root + kBootIdPath);
+    Discover(root);
+}
+
+StorageMonitor::~StorageMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCond.notify_one();
+    if (mThread.joinable())
+        mThread.join();
+}
+
+void StorageMonitor::Discover(const std::string& root)
+{
+    const std::string mmcDir = root + kMmcDevicesPath;
+
+    DIR *dir = opendir(mmcDir.c_str());
+    if (dir == nullptr) {
+        ALOGW("%s: Error opening %s: %s", __func__, mmcDir.c_str(), strerror(errno));
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        if (de->d_name[0] == '.')
+            continue;
+
+        Device dev = {};
+        dev.dir = mmcDir + "/" + de->d_name;
+
+        const std::string type = ReadAttr(dev.dir + "/type");
+        if (type != "MMC" && type != "SD")
+            continue;
+        dev.emmc = type == "MMC";
+
+        /* <card>/block/mmcblkN */
+        DIR *blockDir = opendir((dev.dir + "/block").c_str());
+        if (blockDir == nullptr)
+            continue;
+        struct dirent *be;
+        while ((be = readdir(blockDir)) != nullptr) {
+            if (be->d_name[0] != '.')
+                dev.block = be->d_name;
+        }
+        closedir(blockDir);
+        if (dev.block.empty())
+            continue;
+
+        dev.capacity = strtoull(ReadAttr(dev.dir + "/block/" + dev.block + "/size").c_str(),
+                                nullptr, 10) * 512;
+        dev.cid = ReadAttr(dev.dir + "/cid");
+        if (dev.cid.empty())
+            dev.cid = dev.block;
+
+        ALOGI("%s: %s is %s, %llu MiB", __func__, dev.block.c_str(), type.c_str(),
+              (unsigned long long)(dev.capacity >> 20));
+        mDevices.push_back(dev);
+    }
+    closedir(dir);
+
+    std::sort(mDevices.begin(), mDevices.end(),
+              [](const Device& a, const Device& b) { return a.block < b.block; });
+}
+
+/*
+ * One line per card after the boot id of the last save:
+ *   <cid> <lifetime> <bootSectors> <hostSectors> <baseLifetime> <baseSectors>
+ * bootSectors only carries over within the same boot, i.e. when the
+ * service restarted, so sectors already counted are not counted again.
+ * The HAL may come up before /data; until init has created the state
+ * directory nothing is loaded or saved.
+ */
+bool StorageMonitor::Load()
+{
+    std::string state;
+
+    if (access(::android::base::Dirname(mStatePath).c_str(), W_OK) != 0)
+        return false;
+    if (!::android::base::ReadFileToString(mStatePath, &state))
+        return true;
+
+    std::vector<std::string> lines = ::android::base::Split(state, "\n");
+    const bool sameBoot = !mBootId.empty() && lines[0] == mBootId;
+
+    for (size_t i = 1; i < lines.size(); i++) {
+        char cid[64];
+        unsigned lifetime, baseLifetime;
+        unsigned long long bootSectors, hostSectors, baseSectors;
+
+        if (sscanf(lines[i].c_str(), "%63s %u %llu %llu %u %llu", cid, &lifetime, &bootSectors,
+                   &hostSectors, &baseLifetime, &baseSectors) != 6)
+            continue;
+
+        for (auto& dev : mDevices) {
+            if (dev.cid != cid)
+                continue;
+            dev.lifetime = lifetime;
+            dev.bootSectors = sameBoot ? bootSectors : 0;
+            dev.hostSectors = hostSectors;
+            dev.baseLifetime = baseLifetime;
+            dev.baseSectors = baseSectors;
+        }
+    }
+
+    return true;
+}
+
+void StorageMonitor::Save()
+{
+    std::string state = mBootId + "\n";
+    for (const auto& dev : mDevices) {
+        state += StringPrintf("%s %u %llu %llu %u %llu\n", dev.cid.c_str(), dev.lifetime,
+                              (unsigned long long)dev.bootSectors,
+                              (unsigned long long)dev.hostSectors, dev.baseLifetime,
+                              (unsigned long long)dev.baseSectors);
+    }
+
+    /* Replace, never truncate in place: a torn file would restart every estimate */
+    const std::string tmp = mStatePath + ".tmp";
+    int fd = TEMP_FAILURE_RETRY(open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        ALOGE("%s: Error creating %s: %s", __func__, tmp.c_str(), strerror(errno));
+        return;
+    }
+    bool ok = ::android::base::WriteStringToFd(state, fd) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), mStatePath.c_str()) < 0) {
+        ALOGE("%s: Error writing %s: %s", __func__, mStatePath.c_str(), strerror(errno));
+        unlink(tmp.c_str());
+    }
+}
+
+void StorageMonitor::Refresh()
+{
+    std::vector<StorageInfo> infos;
+    std::vector<Wear> wear;
+
+    if (!mLoaded)
+        mLoaded = Load();
+
+    for (auto& dev : mDevices) {
+        StorageInfo info = {};
+        DiskStats disk = {};
+
+        if (mDisks.GetDisk(dev.block, &disk)) {
+            info.attr = disk.attr;
+            /* diskstats restarts at every boot */
+            uint64_t sectors = disk.writeSectors;
+            dev.hostSectors += sectors >= dev.bootSectors ? sectors - dev.bootSectors : sectors;
+            dev.bootSectors = sectors;
+        } else {
+            info.attr.name = dev.block;
+        }
+
+        if (dev.emmc) {
+            /* Kernels without the attributes leave both estimates undefined */
+            unsigned a = 0, b = 0, eol = 0;
+            const std::string lifeTime = ReadAttr(dev.dir + "/life_time");
+            if (sscanf(lifeTime.c_str(), "%x %x", &a, &b) == 2)
+                eol = strtoul(ReadAttr(dev.dir + "/pre_eol_info").c_str(), nullptr, 16);
+            else
+                a = b = 0;
+            info.lifetimeA = a;
+            info.lifetimeB = b;
+            info.eol = eol;
+            info.version = StringPrintf("emmc rev %s fw %s", ReadAttr(dev.dir + "/rev").c_str(),
+                                        ReadAttr(dev.dir + "/fwrev").c_str());
+
+            /* The first step seen, possibly while powered off, starts the measurement */
+            uint16_t lifetime = std::max(info.lifetimeA, info.lifetimeB);
+            if (dev.lifetime != 0 && lifetime > dev.lifetime && dev.baseLifetime == 0) {
+                dev.baseLifetime = lifetime;
+                dev.baseSectors = dev.hostSectors;
+            }
+
+            /* Each step is 10% of the rated erase cycles of the whole part */
+            if (dev.baseLifetime != 0 && lifetime > dev.baseLifetime &&
+                dev.hostSectors > dev.baseSectors) {
+                double nand = static_cast<double>(dev.capacity) * kRatedEraseCycles / 10 *
+                              (lifetime - dev.baseLifetime);
+                double host = static_cast<double>(dev.hostSectors - dev.baseSectors) * 512;
+                dev.writeAmplification = nand / host;
+                if (lifetime > dev.lifetime)
+                    ALOGI("%s: %s life time %u, write amplification %.1f", __func__,
+                          dev.block.c_str(), lifetime, dev.writeAmplification);
+            }
+            dev.lifetime = lifetime;
+        } else {
+            info.version = StringPrintf("sd fw %s", ReadAttr(dev.dir + "/fwrev").c_str());
+        }
+
+        infos.push_back(info);
+        wear.push_back({ dev.block, dev.hostSectors, dev.writeAmplification });
+    }
+
+    if (mLoaded)
+        Save();
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mInfo = infos;
+    mWear.swap(wear);
+}
+
+void StorageMonitor::Start()
+{
+    if (!mDevices.empty())
+        mThread = std::thread(&StorageMonitor::ThreadLoop, this);
+}
+
+void StorageMonitor::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    while (!mExit) {
+        lock.unlock();
+        Refresh();
+        lock.lock();
+
+        mCond.wait_for(lock, kRefreshPeriod, [this] { return mExit; });
+    }
+}
+
+void StorageMonitor::GetStorageInfo(hidl_vec<StorageInfo> *info)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    *info = mInfo;
+}
+
+void StorageMonitor::Dump(int fd)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    dprintf(fd, "\n%-10s %6s %6s %4s %14s %8s  %s\n",
+            "storage", "lifeA", "lifeB", "eol", "written(MiB)", "WA", "version");
+
+    for (size_t i = 0; i < mInfo.size(); i++) {
+        const StorageInfo& info = mInfo[i];
+        const Wear& wear = mWear[i];
+
+        dprintf(fd, "%-10s %6u %6u %4u %14llu ", wear.block.c_str(), info.lifetimeA,
+                info.lifetimeB, info.eol, (unsigned long long)(wear.hostSectors >> 11));
+        if (wear.writeAmplification > 0)
+            dprintf(fd, "%8.1f", wear.writeAmplification);
+        else
+            dprintf(fd, "%8s", "n/a");
+        dprintf(fd, "  %s\n", info.version.c_str());
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_STORAGEMONITOR_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_STORAGEMONITOR_H
+
+#include <android/hardware/health/2.0/IHealth.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DiskStatsCollector.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+/*
+ * eMMC and SD wear state for getStorageInfo().
+ *
+ * For eMMC, the device life time estimates (type A and B, in 10% steps)
+ * and the pre-EOL state come from the card's sysfs life_time and
+ * pre_eol_info attributes. The EXT_CSD copy in debugfs is root only and
+ * not readable by the service, so on kernels without the attributes,
+ * and for SD cards, which report no wear, both estimates are undefined.
+ *
+ * Write amplification is estimated from how many sectors the host wrote
+ * while the life time estimate advanced, each step being 10% of the
+ * card's rated erase cycles. Steps are weeks or months apart, so the
+ * host writes (accumulated from the per-boot diskstats counter) and the
+ * life time and host writes at the first step seen are kept per card,
+ * keyed by CID, in /data/vendor/health/storage_wear across boots. The
+ * estimate is available from the second step on, averaged over all
+ * steps since the first, and shown by debug() with the host writes.
+ *
+ * Everything is read by a background thread every kRefreshPeriod, which
+ * also saves the state; the binder thread only copies the cached result.
+ */
+class StorageMonitor
+{
+public:
+    /* @root prefixes the sysfs paths, for testing against a fake tree */
+    StorageMonitor(const std::string& root, DiskStatsCollector& disks);
+    ~StorageMonitor();
+
+    void Start();
+
+    void GetStorageInfo(hidl_vec<StorageInfo> *info);
+
+    void Dump(int fd);
+
+private:
+    struct Device {
+        std::string block;              /* mmcblkN */
+        std::string dir;                /* /sys/bus/mmc/devices/<card> */
+        std::string cid;                /* card identity, keys the saved state */
+        bool emmc;
+        uint64_t capacity;              /* bytes */
+
+        /* Saved across boots */
+        uint16_t lifetime;              /* max of type A and B at the last refresh */
+        uint64_t bootSectors;           /* diskstats sectors written this boot, last refresh */
+        uint64_t hostSectors;           /* sectors written since the card was first seen */
+        uint16_t baseLifetime;          /* life time at the first step seen, 0 until then */
+        uint64_t baseSectors;           /* hostSectors at that step */
+
+        double writeAmplification;      /* 0 until measured */
+    };
+
+    struct Wear {
+        std::string block;
+        uint64_t hostSectors;
+        double writeAmplification;
+    };
+
+    void Discover(const std::string& root);
+    bool Load();
+    void Save();
+    void Refresh();
+    void ThreadLoop();
+
+    DiskStatsCollector& mDisks;
+    const std::string mStatePath;
+    std::string mBootId;
+    bool mLoaded;                       /* the saved state is in mDevices */
+    std::vector<Device> mDevices;       /* refresh thread only */
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    hidl_vec<StorageInfo> mInfo;
+    std::vector<Wear> mWear;
+    bool mExit;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_STORAGEMONITOR_H
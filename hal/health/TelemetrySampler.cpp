@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "HealthHAL"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include "TelemetrySampler.h"
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+using ::android::base::StringPrintf;
+
+static const char *kPeriodProperty = "persist.vendor.health.telemetry_period_ms";
+static constexpr uint32_t kDefaultPeriodMs = 1000;
+static constexpr uint32_t kMinPeriodMs = 10;
+
+/* The cpu lines come first; the interrupt counts after them are not needed */
+static constexpr size_t kStatBufferSize = 4096;
+static constexpr unsigned kMaxCpus = 64;
+
+static bool PreadString(int fd, char *buf, size_t size)
+{
+    ssize_t len = pread(fd, buf, size - 1, 0);
+    if (len <= 0)
+        return false;
+
+    buf[len] = '\0';
+    return true;
+}
+
+static int64_t PreadI64(int fd)
+{
+    char buf[24];
+
+    if (fd < 0 || !PreadString(fd, buf, sizeof(buf)))
+        return 0;
+
+    return strtoll(buf, nullptr, 10);
+}
+
+static uint64_t MonotonicMs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+TelemetrySampler::TelemetrySampler(const std::string& root)
+    : mStatFd(-1),
+      mStatBuf(kStatBufferSize),
+      mPeriod(::android::base::GetUintProperty<uint32_t>(kPeriodProperty, kDefaultPeriodMs)),
+      mSlots(new Slot[kCapacity]),
+      mHead(0),
+      mExit(false)
+{
+    for (size_t i = 0; i < kCapacity; i++)
+        mSlots[i].seq.store(0, std::memory_order_relaxed);
+
+    if (mPeriod.count() > 0 && mPeriod.count() < kMinPeriodMs)
+        mPeriod = std::chrono::milliseconds(kMinPeriodMs);
+
+    Discover(root);
+}
+
+TelemetrySampler::~TelemetrySampler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCond.notify_one();
+    if (mThread.joinable())
+        mThread.join();
+
+    for (const auto& zone : mZones)
+        close(zone.fd);
+    for (const auto& cluster : mClusters) {
+        close(cluster.curFd);
+        if (cluster.maxFd >= 0)
+            close(cluster.maxFd);
+    }
+    if (mStatFd >= 0)
+        close(mStatFd);
+}
+
+void TelemetrySampler::Discover(const std::string& root)
+{
+    for (unsigned n = 0; mZones.size() < kMaxZones; n++) {
+        const std::string dir = StringPrintf("%s/sys/class/thermal/thermal_zone%u", root.c_str(), n);
+        std::string type;
+        if (!::android::base::ReadFileToString(dir + "/type", &type))
+            break;
+
+        int fd = open((dir + "/temp").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        mZones.push_back({ ::android::base::Trim(type), fd });
+    }
+
+    /* Policies are named after their first CPU: policy0 and policy4 on RK3399 */
+    for (unsigned cpu = 0; cpu < kMaxCpus && mClusters.size() < kMaxClusters; cpu++) {
+        const std::string dir = StringPrintf("%s/sys/devices/system/cpu/cpufreq/policy%u",
+                                             root.c_str(), cpu);
+        std::string related;
+        if (!::android::base::ReadFileToString(dir + "/related_cpus", &related))
+            continue;
+
+        Cluster cluster = {};
+        cluster.name = StringPrintf("policy%u", cpu);
+        cluster.curFd = open((dir + "/scaling_cur_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        cluster.maxFd = open((dir + "/scaling_max_freq").c_str(), O_RDONLY | O_CLOEXEC);
+        if (cluster.curFd < 0) {
+            ALOGW("%s: No scaling_cur_freq in %s", __func__, dir.c_str());
+            if (cluster.maxFd >= 0)
+                close(cluster.maxFd);
+            continue;
+        }
+
+        for (const auto& token : ::android::base::Split(::android::base::Trim(related), " ")) {
+            unsigned id = strtoul(token.c_str(), nullptr, 10);
+            if (!token.empty() && id < kMaxCpus)
+                cluster.cpuMask |= 1ULL << id;
+        }
+        mClusters.push_back(cluster);
+    }
+
+    mStatFd = open((root + "/proc/stat").c_str(), O_RDONLY | O_CLOEXEC);
+    if (mStatFd < 0)
+        ALOGW("%s: Error opening /proc/stat: %s", __func__, strerror(errno));
+}
+
+void TelemetrySampler::Start()
+{
+    if (mPeriod.count() == 0 || (mZones.empty() && mClusters.empty()))
+        return;
+
+    mThread = std::thread(&TelemetrySampler::ThreadLoop, this);
+}
+
+void TelemetrySampler::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    auto next = std::chrono::steady_clock::now();
+
+    while (!mExit) {
+        lock.unlock();
+        Sample();
+        lock.lock();
+
+        /* Keep the cadence, but do not burst to catch up after a stall */
+        next = std::max(next + mPeriod, std::chrono::steady_clock::now());
+        mCond.wait_until(lock, next, [this] { return mExit; });
+    }
+}
+
+void TelemetrySampler::ReadLoad(Record *record)
+{
+    uint64_t busy[kMaxClusters] = {};
+    uint64_t total[kMaxClusters] = {};
+    char *buf = mStatBuf.data();
+
+    if (mStatFd < 0 || !PreadString(mStatFd, buf, mStatBuf.size()))
+        return;
+
+    /* "cpuN user nice system idle iowait irq softirq steal ...", after the aggregate "cpu" line */
+    for (char *line = buf; line != nullptr && strncmp(line, "cpu", 3) == 0; ) {
+        char *next = strchr(line, '\n');
+        char *p = line + 3;
+
+        if (*p >= '0' && *p <= '9') {
+            unsigned cpu = strtoul(p, &p, 10);
+            uint64_t all = 0, idle = 0;
+            for (int field = 0; field < 8; field++) {
+                uint64_t value = strtoull(p, &p, 10);
+                all += value;
+                if (field == 3 || field == 4)
+                    idle += value;
+            }
+
+            for (size_t c = 0; c < mClusters.size(); c++) {
+                if (cpu < kMaxCpus && (mClusters[c].cpuMask & (1ULL << cpu))) {
+                    busy[c] += all - idle;
+                    total[c] += all;
+                }
+            }
+        }
+
+        line = next ? next + 1 : nullptr;
+    }
+
+    for (size_t c = 0; c < mClusters.size(); c++) {
+        Cluster& cluster = mClusters[c];
+        uint64_t dBusy = busy[c] - cluster.lastBusy;
+        uint64_t dTotal = total[c] - cluster.lastTotal;
+
+        /* The first sample, or a CPU that went offline, has no usable delta */
+        if (cluster.lastTotal != 0 && total[c] > cluster.lastTotal && busy[c] >= cluster.lastBusy)
+            record->load[c] = std::min<uint64_t>(dBusy * 1000 / dTotal, 1000);
+        cluster.lastBusy = busy[c];
+        cluster.lastTotal = total[c];
+    }
+}
+
+void TelemetrySampler::Sample()
+{
+    Record record = {};
+
+    record.timeMs = MonotonicMs();
+    for (size_t i = 0; i < mZones.size(); i++)
+        record.temp[i] = PreadI64(mZones[i].fd);
+    for (size_t i = 0; i < mClusters.size(); i++) {
+        record.curFreq[i] = PreadI64(mClusters[i].curFd);
+        record.maxFreq[i] = PreadI64(mClusters[i].maxFd);
+    }
+    ReadLoad(&record);
+
+    uint64_t words[kWords];
+    memcpy(words, &record, sizeof(record));
+
+    uint64_t index = mHead.load(std::memory_order_relaxed);
+    Slot& slot = mSlots[index % kCapacity];
+
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; i++)
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    mHead.store(index + 1, std::memory_order_release);
+}
+
+bool TelemetrySampler::ReadSlot(uint64_t index, Record *record)
+{
+    const Slot& slot = mSlots[index % kCapacity];
+    uint64_t words[kWords];
+
+    if (slot.seq.load(std::memory_order_acquire) != 2 * index + 2)
+        return false;
+    for (size_t i = 0; i < kWords; i++)
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != 2 * index + 2)
+        return false;               /* overwritten by a newer sample meanwhile */
+
+    memcpy(record, words, sizeof(*record));
+    return true;
+}
+
+void TelemetrySampler::Dump(int fd)
+{
+    uint64_t head = mHead.load(std::memory_order_acquire);
+
+    dprintf(fd, "\ntelemetry: period %lld ms, %zu zones, %zu clusters, %llu samples, %llu buffered"
+            " (debug --telemetry for CSV)\n",
+            (long long)mPeriod.count(), mZones.size(), mClusters.size(),
+            (unsigned long long)head, (unsigned long long)std::min<uint64_t>(head, kCapacity));
+}
+
+void TelemetrySampler::DumpCsv(int fd)
+{
+    uint64_t head = mHead.load(std::memory_order_acquire);
+    uint64_t first = head > kCapacity ? head - kCapacity : 0;
+
+    dprintf(fd, "time_ms");
+    for (const auto& zone : mZones)
+        dprintf(fd, ",%s_mC", zone.type.c_str());
+    for (const auto& cluster : mClusters) {
+        dprintf(fd, ",%s_cur_kHz,%s_max_kHz,%s_load_pm", cluster.name.c_str(),
+                cluster.name.c_str(), cluster.name.c_str());
+    }
+    dprintf(fd, "\n");
+
+    for (uint64_t index = first; index < head; index++) {
+        Record record;
+        char line[256];
+        int len;
+
+        if (!ReadSlot(index, &record))
+            continue;
+
+        len = snprintf(line, sizeof(line), "%llu", (unsigned long long)record.timeMs);
+        for (size_t i = 0; i < mZones.size(); i++)
+            len += snprintf(line + len, sizeof(line) - len, ",%d", record.temp[i]);
+        for (size_t i = 0; i < mClusters.size(); i++) {
+            len += snprintf(line + len, sizeof(line) - len, ",%u,%u,%u",
+                            record.curFreq[i], record.maxFreq[i], record.load[i]);
+        }
+        line[len++] = '\n';
+        (void)::android::base::WriteFully(fd, line, len);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
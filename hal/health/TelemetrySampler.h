@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_HEALTH_V2_0_TELEMETRYSAMPLER_H
+#define ANDROID_HARDWARE_HEALTH_V2_0_TELEMETRYSAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+/*
+ * Thermal and CPU load telemetry, for correlating throttling with
+ * frame drops without a shell loop on the device.
+ *
+ * Every period the sampler thread reads the thermal zone temperatures,
+ * the current and maximum frequency of each cpufreq policy, and the
+ * per-cluster busy ratio from /proc/stat, all through files opened
+ * once at start. The period comes from
+ * persist.vendor.health.telemetry_period_ms (default 1000, 0 disables
+ * sampling) and is read when the service starts.
+ *
+ * Samples go into a fixed ring of kCapacity slots. The sampler is the
+ * only writer and never waits: each slot carries a sequence number that
+ * is odd while the slot is written, and a reader copies a slot and
+ * keeps it only if the sequence was even and unchanged around the copy.
+ * DumpCsv() writes the buffered window with monotonic timestamps, the
+ * clock gfxinfo framestats use.
+ */
+class TelemetrySampler
+{
+public:
+    static constexpr size_t kCapacity = 1024;
+    static constexpr size_t kMaxZones = 4;
+    static constexpr size_t kMaxClusters = 4;
+
+    /* @root prefixes the sysfs and procfs paths, for testing against a fake tree */
+    explicit TelemetrySampler(const std::string& root);
+    ~TelemetrySampler();
+
+    void Start();
+
+    /* Takes one sample now; called by the sampler thread, or by one test thread without Start() */
+    void Sample();
+
+    /* One line summary for the regular debug() output */
+    void Dump(int fd);
+
+    void DumpCsv(int fd);
+
+private:
+    struct Record {
+        uint64_t timeMs;                /* CLOCK_MONOTONIC */
+        int32_t temp[kMaxZones];        /* mC */
+        uint32_t curFreq[kMaxClusters]; /* kHz */
+        uint32_t maxFreq[kMaxClusters]; /* kHz, lowered by thermal throttling */
+        uint16_t load[kMaxClusters];    /* busy per mille since the previous sample */
+    };
+
+    static constexpr size_t kWords = sizeof(Record) / sizeof(uint64_t);
+    static_assert(sizeof(Record) % sizeof(uint64_t) == 0, "Record must be whole words");
+
+    struct Slot {
+        std::atomic<uint64_t> seq;      /* 2 * (index + 1) once written, odd while writing */
+        std::atomic<uint64_t> words[kWords];
+    };
+
+    struct Zone {
+        std::string type;
+        int fd;
+    };
+
+    struct Cluster {
+        std::string name;               /* policyN */
+        int curFd;
+        int maxFd;
+        uint64_t cpuMask;
+        uint64_t lastBusy;              /* sampler thread only */
+        uint64_t lastTotal;
+    };
+
+    void Discover(const std::string& root);
+    void ReadLoad(Record *record);
+    bool ReadSlot(uint64_t index, Record *record);
+    void ThreadLoop();
+
+    std::vector<Zone> mZones;
+    std::vector<Cluster> mClusters;
+    int mStatFd;
+    std::vector<char> mStatBuf;
+    std::chrono::milliseconds mPeriod;
+
+    std::unique_ptr<Slot[]> mSlots;
+    std::atomic<uint64_t> mHead;        /* samples written so far */
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mExit;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_HEALTH_V2_0_TELEMETRYSAMPLER_H
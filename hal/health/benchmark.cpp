@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * getDiskStats() latency of the health HAL, measured in process against
+ * DiskStatsCollector, without binder:
+ *
+ *   android.hardware.health@2.0-benchmark.rockchip [-n count] [-r root]
+ *
+ * Every disk DiskStatsCollector finds under @root/sys/block is read
+ * @count times the way getDiskStats() used to, with ReadFileToString
+ * and a stringstream into a fresh vector, then as many times through
+ * Collect(), which preads the kept fds and parses in place.
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "BenchUtil.h"
+#include "DiskStatsCollector.h"
+
+using namespace android::hardware::health::V2_0;
+using namespace android::hardware::health::V2_0::implementation;
+using namespace android::hardware::rockchip;
+
+static uint64_t DiskStats::* const kStatFields[] = {
+    &DiskStats::reads,
+    &DiskStats::readMerges,
+    &DiskStats::readSectors,
+    &DiskStats::readTicks,
+    &DiskStats::writes,
+    &DiskStats::writeMerges,
+    &DiskStats::writeSectors,
+    &DiskStats::writeTicks,
+    &DiskStats::ioInFlight,
+    &DiskStats::ioTicks,
+    &DiskStats::ioInQueue,
+};
+
+/* What getDiskStats() did per disk before the collector */
+static bool LegacyRead(const std::string& path, std::vector<DiskStats>& vec)
+{
+    DiskStats stats = {};
+    std::string buffer;
+
+    if (!android::base::ReadFileToString(path, &buffer))
+        return false;
+
+    std::stringstream ss(buffer);
+    for (auto field : kStatFields)
+        ss >> stats.*field;
+
+    vec.push_back(stats);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = 10000;
+    std::string root;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+            root = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n count] [-r root]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (count == 0)
+        count = 1;
+
+    DiskStatsCollector collector(root);
+
+    /* Compare on the disks the collector's discovery settled on */
+    std::vector<std::string> paths;
+    DIR *dir = opendir((root + "/sys/block").c_str());
+    if (dir != nullptr) {
+        struct dirent *de;
+        while ((de = readdir(dir)) != nullptr) {
+            DiskStats disk;
+            if (de->d_name[0] != '.' && collector.GetDisk(de->d_name, &disk)) {
+                printf("%s (%s)\n", de->d_name, disk.attr.name.c_str());
+                paths.push_back(root + "/sys/block/" + de->d_name + "/stat");
+            }
+        }
+        closedir(dir);
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "no disks under %s/sys/block\n", root.c_str());
+        return 1;
+    }
+
+    std::vector<double> legacy_us, collect_us;
+    uint64_t sectors = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        legacy_us.push_back(TimeUs([&] {
+            std::vector<DiskStats> stats;
+            for (const auto& path : paths)
+                LegacyRead(path, stats);
+            hidl_vec<DiskStats> vec(stats);
+            for (const auto& disk : vec)
+                sectors += disk.readSectors;
+        }));
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        collect_us.push_back(TimeUs([&] {
+            collector.Collect([&](const hidl_vec<DiskStats>& stats) {
+                for (const auto& disk : stats)
+                    sectors += disk.readSectors;
+            });
+        }));
+    }
+
+    Report("stringstream, per call", legacy_us, "us");
+    Report("Collect, per call", collect_us, "us");
+    printf("%zu disks per call, %llu sectors read in total\n", paths.size(),
+           static_cast<unsigned long long>(sectors));
+
+    return 0;
+}
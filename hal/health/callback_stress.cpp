@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stress test of CallbackDispatcher, run in process without binder:
+ *
+ *   android.hardware.health@2.0-callback-stress.rockchip [-c clients] [-n posts]
+ *
+ * @clients local callbacks and one whose calls fail, like a dead client,
+ * are registered while another thread keeps adding and removing more.
+ * @posts HealthInfos carrying a sequence number in batteryLevel are then
+ * posted back to back, followed by a final one. Every client must see
+ * the sequence rise, every client must get the final post, and the
+ * failing client must be called once and dropped once. Exits non-zero on
+ * any violation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <hidl/Status.h>
+
+#include "BenchUtil.h"
+#include "CallbackDispatcher.h"
+
+using namespace android::hardware::health::V2_0;
+using namespace android::hardware::health::V2_0::implementation;
+using namespace android::hardware::rockchip;
+using ::android::hardware::Return;
+using ::android::hardware::Status;
+
+static constexpr std::chrono::seconds kDrainTimeout(10);
+
+class Client : public IHealthInfoCallback
+{
+public:
+    explicit Client(bool dead = false) : mDead(dead), mCalls(0), mLast(-1), mReordered(0) {}
+
+    Return<void> healthInfoChanged(const HealthInfo& info) override
+    {
+        int32_t seq = info.legacy.batteryLevel;
+
+        mCalls++;
+        if (seq <= mLast.load(std::memory_order_relaxed))
+            mReordered++;
+        mLast.store(seq, std::memory_order_relaxed);
+
+        if (mDead)
+            return Status::fromExceptionCode(Status::EX_TRANSACTION_FAILED);
+        return Return<void>();
+    }
+
+    const bool mDead;
+    std::atomic<uint64_t> mCalls;
+    std::atomic<int32_t> mLast;
+    std::atomic<uint64_t> mReordered;
+};
+
+int main(int argc, char **argv)
+{
+    unsigned clients = 300, posts = 100000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+        switch (opt) {
+        case 'c':
+            clients = strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            posts = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c clients] [-n posts]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::atomic<unsigned> drops(0);
+    CallbackDispatcher *self = nullptr;
+    CallbackDispatcher dispatcher([&](const sp<IHealthInfoCallback>& callback) {
+        drops++;
+        /* As Health does: unregister from the dispatcher thread */
+        self->Remove(callback);
+    });
+    self = &dispatcher;
+
+    std::vector<sp<Client>> list;
+    for (unsigned i = 0; i < clients; i++) {
+        list.push_back(sp<Client>(new Client()));
+        dispatcher.Add(list.back());
+    }
+    sp<Client> dead(new Client(true));
+    dispatcher.Add(dead);
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> churned(0);
+    std::thread churn([&] {
+        while (!stop) {
+            sp<Client> client(new Client());
+            dispatcher.Add(client);
+            dispatcher.Remove(client);
+            churned++;
+        }
+    });
+
+    double post_ms = TimeMs([&] {
+        for (unsigned i = 0; i < posts; i++) {
+            HealthInfo info = {};
+            info.legacy.batteryLevel = i;
+            dispatcher.Post(info);
+        }
+    });
+
+    const int32_t last_seq = posts;
+    HealthInfo info = {};
+    info.legacy.batteryLevel = last_seq;
+    dispatcher.Post(info);
+
+    /* Delivery is asynchronous: wait for the final post to reach everyone */
+    unsigned missing;
+    double drain_ms = post_ms + TimeMs([&] {
+        auto deadline = std::chrono::steady_clock::now() + kDrainTimeout;
+        do {
+            missing = 0;
+            for (const auto& client : list)
+                missing += client->mLast.load() != last_seq;
+            if (missing != 0)
+                usleep(1000);
+        } while (missing != 0 && std::chrono::steady_clock::now() < deadline);
+    });
+
+    stop = true;
+    churn.join();
+
+    uint64_t min = UINT64_MAX, max = 0, reordered = 0;
+    for (const auto& client : list) {
+        min = std::min<uint64_t>(min, client->mCalls);
+        max = std::max<uint64_t>(max, client->mCalls);
+        reordered += client->mReordered;
+    }
+
+    printf("%u clients, %u posts in %.1f ms (%.2f us each), all delivered after %.1f ms\n",
+           clients, posts + 1, post_ms, post_ms * 1000 / (posts + 1), drain_ms);
+    printf("rounds per client %llu..%llu, %llu add/remove pairs alongside\n",
+           (unsigned long long)min, (unsigned long long)max, (unsigned long long)churned.load());
+    fflush(stdout);
+    dispatcher.Dump(STDOUT_FILENO);
+
+    bool ok = true;
+    if (missing != 0) {
+        printf("FAIL: %u clients never got the final post\n", missing);
+        ok = false;
+    }
+    if (reordered != 0) {
+        printf("FAIL: %llu deliveries out of order\n", (unsigned long long)reordered);
+        ok = false;
+    }
+    if (dead->mCalls != 1 || drops != 1) {
+        printf("FAIL: failing client called %llu times, dropped %u times\n",
+               (unsigned long long)dead->mCalls.load(), drops.load());
+        ok = false;
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
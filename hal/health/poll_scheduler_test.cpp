@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * PollScheduler driven by a virtual clock:
+ *
+ *   android.hardware.health@2.0-poll-scheduler-test.rockchip [-v]
+ *
+ * The scheduler reads the first backlight of a scratch tree under
+ * /data/local/tmp, whose brightness the test writes to turn the screen
+ * on and off. Every sample is taken at the time the previous one asked
+ * for, so the clock only moves by the intervals under test. Checked:
+ *
+ *   a stable battery with the screen off backs off from the fast to the
+ *   slow interval, doubling each sample; a charger or the screen on
+ *   keeps the fast interval, and unplugging or the screen going off
+ *   starts the back-off over; a single level step polls fast once, two
+ *   steps within kActiveWindow poll fast until the window ends; no
+ *   battery polls slow.
+ *
+ * -v prints every sample. Exits non-zero on any violation.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "BenchUtil.h"
+#include "PollScheduler.h"
+
+using namespace android::hardware::health::V2_0;
+using namespace android::hardware::health::V2_0::implementation;
+using namespace android::hardware::rockchip;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+static const char *kBacklight = "/sys/class/backlight/panel";
+
+static constexpr milliseconds kFast = PollScheduler::kFastInterval;
+static constexpr milliseconds kSlow = PollScheduler::kSlowInterval;
+
+static bool verbose = false;
+
+/* The battery and screen as the scheduler sees them, with a clock only samples move */
+class Device
+{
+public:
+    Device(PollScheduler& scheduler, const std::string& brightness)
+        : mScheduler(scheduler), mBrightness(brightness), mNow()
+    {
+        mInfo = {};
+        mInfo.legacy.batteryPresent = true;
+        mInfo.legacy.batteryLevel = 80;
+        SetScreen(false);
+    }
+
+    void SetScreen(bool on) { android::base::WriteStringToFile(on ? "128" : "0", mBrightness); }
+    void SetCharging(bool charging) { mInfo.legacy.chargerUsbOnline = charging; }
+    void SetLevel(int32_t level) { mInfo.legacy.batteryLevel = level; }
+    void SetPresent(bool present) { mInfo.legacy.batteryPresent = present; }
+
+    /* Takes a sample now and moves the clock on to the next one */
+    milliseconds Sample(const char *name)
+    {
+        milliseconds delay = mScheduler.Update(mNow, mInfo);
+
+        if (verbose)
+            printf("%-10s t=%6lld s: level %d, next in %lld s\n", name,
+                   (long long)std::chrono::duration_cast<seconds>(Elapsed()).count(),
+                   mInfo.legacy.batteryLevel,
+                   (long long)std::chrono::duration_cast<seconds>(delay).count());
+        mNow += delay;
+        return delay;
+    }
+
+    std::vector<milliseconds> Samples(const char *name, size_t count)
+    {
+        std::vector<milliseconds> delays;
+        for (size_t i = 0; i < count; i++)
+            delays.push_back(Sample(name));
+        return delays;
+    }
+
+    PollScheduler::Clock::duration Elapsed() const { return mNow.time_since_epoch(); }
+
+private:
+    PollScheduler& mScheduler;
+    const std::string mBrightness;
+    PollScheduler::Clock::time_point mNow;
+    HealthInfo mInfo;
+};
+
+static bool Check(bool ok, const char *test, const char *what)
+{
+    printf("%-10s %s: %s\n", test, what, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+/* Doubling from the fast interval, then held at the slow one */
+static bool BacksOff(const std::vector<milliseconds>& delays)
+{
+    milliseconds expected = kFast;
+
+    for (milliseconds delay : delays) {
+        expected = std::min(expected * 2, kSlow);
+        if (delay != expected)
+            return false;
+    }
+    return delays.back() == kSlow;
+}
+
+static bool AllFast(const std::vector<milliseconds>& delays)
+{
+    for (milliseconds delay : delays) {
+        if (delay != kFast)
+            return false;
+    }
+    return true;
+}
+
+static unsigned TestStable(Device& device)
+{
+    unsigned errors = 0;
+
+    errors += !Check(BacksOff(device.Samples("stable", 8)), "stable",
+                     "screen off backs off to the slow interval");
+    return errors;
+}
+
+static unsigned TestCharger(Device& device)
+{
+    unsigned errors = 0;
+
+    /* Plugged in for longer than the window, so unplugging is not a second quick step */
+    device.SetCharging(true);
+    errors += !Check(AllFast(device.Samples("charger", PollScheduler::kActiveWindow / kFast + 2)),
+                     "charger", "plugged in polls fast");
+
+    device.SetCharging(false);
+    errors += !Check(device.Sample("charger") == kFast, "charger", "unplugging polls fast once");
+    errors += !Check(BacksOff(device.Samples("charger", 6)), "charger",
+                     "then backs off again");
+    return errors;
+}
+
+static unsigned TestScreen(Device& device)
+{
+    unsigned errors = 0;
+
+    device.SetScreen(true);
+    errors += !Check(AllFast(device.Samples("screen", 6)), "screen", "screen on polls fast");
+
+    device.SetScreen(false);
+    errors += !Check(BacksOff(device.Samples("screen", 6)), "screen",
+                     "screen off starts the back-off over");
+    return errors;
+}
+
+static unsigned TestActiveWindow(Device& device)
+{
+    unsigned errors = 0;
+
+    /* Settled at the slow interval: one step is not yet a moving level */
+    device.SetLevel(79);
+    errors += !Check(device.Sample("window") == kFast, "window", "single step polls fast once");
+    device.Samples("window", 1);
+
+    device.SetLevel(78);
+    auto start = device.Elapsed();
+    std::vector<milliseconds> window;
+    while (device.Elapsed() - start < PollScheduler::kActiveWindow)
+        window.push_back(device.Sample("window"));
+    errors += !Check(AllFast(window), "window", "two steps in the window poll fast");
+    errors += !Check(window.size() == size_t(PollScheduler::kActiveWindow / kFast), "window",
+                     "for the whole window");
+    errors += !Check(BacksOff(device.Samples("window", 6)), "window",
+                     "then back off once it has passed");
+
+    /* A step long after the last one only polls fast once */
+    device.SetLevel(77);
+    errors += !Check(device.Sample("window") == kFast && device.Sample("window") == 2 * kFast,
+                     "window", "a step outside the window does not open it");
+    return errors;
+}
+
+static unsigned TestNoBattery(Device& device)
+{
+    unsigned errors = 0;
+
+    device.SetPresent(false);
+    device.SetCharging(true);
+    errors += !Check(device.Sample("battery") == kSlow, "battery", "no battery polls slow");
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const std::string root = ScratchRoot("health_poll_test");
+    const std::string brightness = root + kBacklight + "/brightness";
+    if (!WriteScratchFile(brightness, "0")) {
+        fprintf(stderr, "%s: %s\n", brightness.c_str(), strerror(errno));
+        return 1;
+    }
+
+    unsigned errors = 0;
+    {
+        PollScheduler scheduler(root);
+        Device device(scheduler, brightness);
+
+        errors += TestStable(device);
+        errors += TestCharger(device);
+        errors += TestScreen(device);
+        errors += TestActiveWindow(device);
+        errors += TestNoBattery(device);
+
+        fflush(stdout);
+        scheduler.Dump(STDOUT_FILENO);
+    }
+
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+    return errors == 0 ? 0 : 1;
+}
@@ -17,6 +17,10 @@
 #define LOG_TAG "HealthHAL"
 #include <android-base/logging.h>
 
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
 #include <hidl/LegacySupport.h>
 #include <hidl/HidlTransportSupport.h>
 #include <utils/StrongPointer.h>
@@ -29,15 +33,75 @@ using namespace android::hardware;
 using namespace android::hardware::health::V2_0;
 
 using android::hardware::configureRpcThreadpool;
-using android::hardware::joinRpcThreadpool;
+using android::hardware::handleTransportPoll;
+using android::hardware::setupTransportPolling;
+
+static void ArmTimer(int fd, std::chrono::milliseconds delay)
+{
+    struct itimerspec spec = {};
+
+    spec.it_value.tv_sec = delay.count() / 1000;
+    spec.it_value.tv_nsec = delay.count() % 1000 * 1000000;
+    if (timerfd_settime(fd, 0, &spec, nullptr) < 0)
+        PLOG(ERROR) << "timerfd_settime failed";
+}
 
 int main() {
-    android::sp<IHealth> hal = new implementation::Health();
+    android::sp<implementation::Health> hal = new implementation::Health();
 
-    configureRpcThreadpool(1, true /*callerWillJoin*/);
+    /*
+     * Binder is polled from the loop below together with the chore
+     * timer and the power_supply uevent socket, so neither the periodic
+     * poll nor uevent handling needs a thread of its own.
+     */
+    configureRpcThreadpool(1, false /*callerWillJoin*/);
+    int binderFd = setupTransportPolling();
+    CHECK_GE(binderFd, 0);
 
     const auto status = hal->registerAsService();
     CHECK_EQ(status, android::OK);
 
-    joinRpcThreadpool();
+    /* CLOCK_BOOTTIME without the alarm flag: suspend is not interrupted for a poll */
+    int timerFd = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    CHECK_GE(timerFd, 0);
+    CHECK_GE(epollFd, 0);
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = binderFd;
+    CHECK_EQ(epoll_ctl(epollFd, EPOLL_CTL_ADD, binderFd, &ev), 0);
+    ev.data.fd = timerFd;
+    CHECK_EQ(epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev), 0);
+
+    /* Without the socket changes are still caught by the periodic poll */
+    int ueventFd = hal->ueventFd();
+    if (ueventFd >= 0) {
+        ev.data.fd = ueventFd;
+        CHECK_EQ(epoll_ctl(epollFd, EPOLL_CTL_ADD, ueventFd, &ev), 0);
+    }
+
+    ArmTimer(timerFd, hal->periodicChores());
+
+    for (;;) {
+        struct epoll_event events[3];
+        int n = epoll_wait(epollFd, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            PLOG(FATAL) << "epoll_wait failed";
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == binderFd) {
+                handleTransportPoll(binderFd);
+            } else if (events[i].data.fd == timerFd) {
+                uint64_t expirations;
+                (void)read(timerFd, &expirations, sizeof(expirations));
+                ArmTimer(timerFd, hal->periodicChores());
+            } else if (events[i].data.fd == ueventFd) {
+                hal->handleUevents();
+            }
+        }
+    }
 }
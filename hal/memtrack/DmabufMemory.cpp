@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MemtrackHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "DmabufMemory.h"
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+static const char *kBufinfoPath = "/sys/kernel/debug/dma_buf/bufinfo";
+
+/* Attached device names of the rk3399 video blocks (hantro, rkvdec, rkvenc) */
+static const char * const kVpuDevices[] = {
+    "video-codec",
+    "vpu",
+    "rkvdec",
+    "rkvenc",
+};
+
+static bool IsVpuDevice(const char *name)
+{
+    for (const char *vpu : kVpuDevices) {
+        if (strstr(name, vpu) != nullptr)
+            return true;
+    }
+    return false;
+}
+
+static bool IsVpuExporter(const char *name)
+{
+    return strncmp(name, "videobuf2", strlen("videobuf2")) == 0;
+}
+
+DmabufMemory::DmabufMemory(const std::string& root)
+    : mRoot(root), mUid(getuid())
+{
+}
+
+void DmabufMemory::ReadBufinfo()
+{
+    const std::string path = mRoot + kBufinfoPath;
+    FILE *fp = fopen(path.c_str(), "re");
+    if (fp == nullptr) {
+        ALOGV("%s: Error opening %s: %s", __func__, path.c_str(), strerror(errno));
+        return;
+    }
+
+    /*
+     * One object per block:
+     *
+     *   00032768  00000002  00080007  00000003  drm  00012345  <name>
+     *           Attached Devices:
+     *           ff660000.video-codec
+     *   Total 1 devices attached
+     */
+    char line[256];
+    Buffer *buf = nullptr;
+    bool attached = false;
+
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        if (line[0] >= '0' && line[0] <= '9') {
+            unsigned long long size;
+            unsigned long inode;
+            unsigned refs;
+            char exporter[64];
+
+            buf = nullptr;
+            attached = false;
+            if (sscanf(line, "%llu %*x %*x %u %63s %lu", &size, &refs, exporter, &inode) != 4)
+                continue;
+
+            mBuffers.push_back({ inode, size, refs, 0, IsVpuExporter(exporter) });
+            buf = &mBuffers.back();
+        } else if (line[0] == '\t' && buf != nullptr) {
+            if (strstr(line, "Attached Devices:") != nullptr) {
+                attached = true;
+            } else if (attached && IsVpuDevice(line)) {
+                buf->multimedia = true;
+            }
+        } else {
+            buf = nullptr;
+            attached = false;
+        }
+    }
+    fclose(fp);
+}
+
+void DmabufMemory::ReadFds(pid_t pid, const std::string& procDir)
+{
+    DIR *dir = opendir((procDir + "/fdinfo").c_str());
+    if (dir == nullptr)
+        return;
+
+    int fdDir = open((procDir + "/fd").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        char target[64];
+        char info[512];
+
+        if (de->d_name[0] == '.')
+            continue;
+
+        /* Cheap filter: most fds are files, sockets or pipes */
+        ssize_t len = readlinkat(fdDir, de->d_name, target, sizeof(target) - 1);
+        if (len > 0) {
+            target[len] = '\0';
+            if (strstr(target, "dmabuf") == nullptr)
+                continue;
+        }
+
+        int infoFd = openat(dirfd(dir), de->d_name, O_RDONLY | O_CLOEXEC);
+        if (infoFd < 0)
+            continue;
+        len = read(infoFd, info, sizeof(info) - 1);
+        close(infoFd);
+        if (len <= 0)
+            continue;
+        info[len] = '\0';
+
+        const char *exporter = strstr(info, "exp_name:");
+        const char *size = strstr(info, "size:");
+        if (exporter == nullptr || size == nullptr)
+            continue;
+
+        /* fdinfo carries the inode on newer kernels, otherwise stat the fd itself */
+        const char *ino = strstr(info, "ino:");
+        struct stat st;
+        ino_t inode;
+        if (ino != nullptr)
+            inode = strtoull(ino + strlen("ino:"), nullptr, 10);
+        else if (fstatat(fdDir, de->d_name, &st, 0) == 0)
+            inode = st.st_ino;
+        else
+            continue;
+
+        mRefs.push_back({ pid, inode, 1, false });
+
+        /* Without bufinfo the fd is the only source of size and exporter */
+        exporter += strlen("exp_name:");
+        exporter += strspn(exporter, " \t");
+        mFdBuffers.push_back({ inode, strtoull(size + strlen("size:"), nullptr, 10), 0, 0,
+                               IsVpuExporter(exporter) });
+    }
+
+    if (fdDir >= 0)
+        close(fdDir);
+    closedir(dir);
+}
+
+void DmabufMemory::ReadMaps(pid_t pid, const std::string& procDir)
+{
+    FILE *fp = fopen((procDir + "/maps").c_str(), "re");
+    if (fp == nullptr)
+        return;
+
+    /* 7f8c4e6000-7f8c7e6000 rw-s 00000000 00:0a 12345    /dmabuf: */
+    char line[512];
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        unsigned long inode;
+
+        if (strstr(line, "dmabuf") == nullptr)
+            continue;
+        if (sscanf(line, "%*s %*s %*s %*s %lu", &inode) == 1)
+            mRefs.push_back({ pid, inode, 1, true });
+    }
+    fclose(fp);
+}
+
+void DmabufMemory::SortBuffers()
+{
+    /* Stable, so the bufinfo entry of a buffer wins over the fdinfo ones */
+    std::stable_sort(mBuffers.begin(), mBuffers.end(), [](const Buffer& a, const Buffer& b) {
+        return a.inode < b.inode;
+    });
+    mBuffers.erase(std::unique(mBuffers.begin(), mBuffers.end(),
+                               [](const Buffer& a, const Buffer& b) {
+                                   return a.inode == b.inode;
+                               }),
+                   mBuffers.end());
+}
+
+DmabufMemory::Buffer *DmabufMemory::FindBuffer(ino_t inode)
+{
+    auto it = std::lower_bound(mBuffers.begin(), mBuffers.end(), inode,
+                               [](const Buffer& buf, ino_t key) {
+                                   return buf.inode < key;
+                               });
+    return it != mBuffers.end() && it->inode == inode ? &*it : nullptr;
+}
+
+void DmabufMemory::Read(std::vector<DmabufShare> *shares)
+{
+    const std::string procRoot = mRoot + "/proc";
+
+    mBuffers.clear();
+    mFdBuffers.clear();
+    mRefs.clear();
+    shares->clear();
+
+    ReadBufinfo();
+
+    DIR *dir = opendir(procRoot.c_str());
+    if (dir == nullptr) {
+        ALOGE("%s: Error opening %s: %s", __func__, procRoot.c_str(), strerror(errno));
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        char *end;
+        pid_t pid = strtol(de->d_name, &end, 10);
+        if (*end != '\0' || pid <= 0)
+            continue;
+
+        /* fd and maps of other uids need CAP_SYS_PTRACE, don't even try */
+        struct stat st;
+        if (fstatat(dirfd(dir), de->d_name, &st, 0) != 0 || st.st_uid != mUid)
+            continue;
+
+        const std::string procDir = procRoot + "/" + de->d_name;
+        shares->push_back({ pid, {}, {} });
+        ReadFds(pid, procDir);
+        ReadMaps(pid, procDir);
+    }
+    closedir(dir);
+
+    mBuffers.insert(mBuffers.end(), mFdBuffers.begin(), mFdBuffers.end());
+    SortBuffers();
+
+    /* One entry per process and buffer; a mapping makes it accounted */
+    std::sort(mRefs.begin(), mRefs.end(), [](const Ref& a, const Ref& b) {
+        return a.pid != b.pid ? a.pid < b.pid : a.inode < b.inode;
+    });
+    size_t out = 0;
+    for (size_t i = 0; i < mRefs.size(); i++) {
+        if (out && mRefs[out - 1].pid == mRefs[i].pid && mRefs[out - 1].inode == mRefs[i].inode) {
+            mRefs[out - 1].count += mRefs[i].count;
+            mRefs[out - 1].mapped |= mRefs[i].mapped;
+            continue;
+        }
+        mRefs[out++] = mRefs[i];
+    }
+    mRefs.resize(out);
+
+    for (const auto& ref : mRefs) {
+        Buffer *buf = FindBuffer(ref.inode);
+        if (buf != nullptr)
+            buf->found += ref.count;
+    }
+
+    std::sort(shares->begin(), shares->end(), [](const DmabufShare& a, const DmabufShare& b) {
+        return a.pid < b.pid;
+    });
+
+    auto share = shares->begin();
+    for (const auto& ref : mRefs) {
+        const Buffer *buf = FindBuffer(ref.inode);
+        if (buf == nullptr)
+            continue;
+
+        while (share != shares->end() && share->pid < ref.pid)
+            share++;
+        if (share == shares->end())
+            break;
+        if (share->pid != ref.pid)
+            continue;
+
+        DmabufUsage& usage = buf->multimedia ? share->multimedia : share->graphics;
+        /* bufinfo is read before the walk, never charge more than the whole buffer */
+        uint64_t pss = buf->size * ref.count / std::max(buf->refs, buf->found);
+        if (ref.mapped)
+            usage.accounted += pss;
+        else
+            usage.unaccounted += pss;
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_MEMTRACK_V1_0_DMABUFMEMORY_H
+#define ANDROID_HARDWARE_MEMTRACK_V1_0_DMABUFMEMORY_H
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+struct DmabufUsage {
+    uint64_t accounted;                 /* mapped, so smaps already sees it */
+    uint64_t unaccounted;               /* only held through an fd */
+};
+
+struct DmabufShare {
+    pid_t pid;
+    DmabufUsage graphics;
+    DmabufUsage multimedia;
+};
+
+/*
+ * dma-buf memory attributed to processes, split into what the video
+ * codecs use (MULTIMEDIA) and everything else, i.e. gralloc buffers
+ * (GRAPHICS).
+ *
+ * gralloc buffers are shared between the app, SurfaceFlinger and the
+ * composer, so every holder is charged its part of a buffer, like PSS.
+ * A process holds a buffer through fds (found through
+ * /proc/<pid>/fdinfo, where only dma-bufs carry "exp_name:") and
+ * mappings (/proc/<pid>/maps), each one a reference to the buffer's
+ * file. Its share is accounted if the buffer is mapped, since smaps
+ * then already counts it, and unaccounted otherwise.
+ *
+ * The HAL runs without CAP_SYS_PTRACE, so only the processes of its own
+ * uid (SurfaceFlinger, the composer, gralloc) can be read; the others
+ * are skipped without opening anything under their /proc directory and
+ * get no entry, so their usage is unknown rather than zero.
+ *
+ * Buffers are keyed by inode. /sys/kernel/debug/dma_buf/bufinfo gives
+ * the size, exporter, attached devices and file reference count of
+ * every buffer. A holder is charged size * its references / the count,
+ * so the holders that cannot be read still take their part. Without
+ * debugfs, size and exporter come from fdinfo and a buffer is split
+ * over the references that were found. A buffer is multimedia
+ * when videobuf2 (the V4L2 decoders and encoders) exported it or a VPU
+ * is attached to it.
+ *
+ * The buffer index and the references are flat vectors sorted by key,
+ * kept across refreshes so a refresh does not allocate once warm.
+ */
+class DmabufMemory
+{
+public:
+    explicit DmabufMemory(const std::string& root);
+
+    /* Fills one entry per live process, sorted by pid */
+    void Read(std::vector<DmabufShare> *shares);
+
+private:
+    struct Buffer {
+        ino_t inode;
+        uint64_t size;
+        uint32_t refs;                  /* file references per bufinfo, 0 if unknown */
+        uint32_t found;                 /* references found in the processes read */
+        bool multimedia;
+    };
+
+    struct Ref {
+        pid_t pid;
+        ino_t inode;
+        uint32_t count;                 /* fds and mappings */
+        bool mapped;
+    };
+
+    void ReadBufinfo();
+    void ReadFds(pid_t pid, const std::string& procDir);
+    void ReadMaps(pid_t pid, const std::string& procDir);
+    void SortBuffers();
+    Buffer *FindBuffer(ino_t inode);
+
+    const std::string mRoot;
+    const uid_t mUid;
+    std::vector<Buffer> mBuffers;       /* sorted by inode once all sources are read */
+    std::vector<Buffer> mFdBuffers;
+    std::vector<Ref> mRefs;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_MEMTRACK_V1_0_DMABUFMEMORY_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MemtrackHAL"
+#include <log/log.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "KbaseMemory.h"
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+static const char *kGpuMemoryPath = "/sys/kernel/debug/mali0/gpu_memory";
+
+KbaseMemory::KbaseMemory(const std::string& root)
+    : mPath(root + kGpuMemoryPath),
+      mPageSize(sysconf(_SC_PAGESIZE)),
+      mWarnedNoTgid(false)
+{
+}
+
+bool KbaseMemory::Read(std::vector<std::pair<pid_t, uint64_t>> *contexts)
+{
+    FILE *fp = fopen(mPath.c_str(), "re");
+    if (fp == nullptr) {
+        ALOGV("%s: Error opening %s: %s", __func__, mPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    char line[128];
+
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        unsigned long long used;
+        int tgid;
+
+        /* The first line is the device-wide total, only contexts are indented */
+        if (line[0] != ' ')
+            continue;
+
+        int n = sscanf(line, " kctx-%*s %llu %d", &used, &tgid);
+        if (n == 1 && !mWarnedNoTgid) {
+            ALOGW("%s: kbase does not report context owners, GL usage unavailable", __func__);
+            mWarnedNoTgid = true;
+        }
+        if (n == 2)
+            contexts->emplace_back(tgid, used * mPageSize);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
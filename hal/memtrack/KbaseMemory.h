@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_MEMTRACK_V1_0_KBASEMEMORY_H
+#define ANDROID_HARDWARE_MEMTRACK_V1_0_KBASEMEMORY_H
+
+#include <sys/types.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * GPU memory allocated by the mali kbase driver, per process.
+ *
+ * /sys/kernel/debug/mali0/gpu_memory lists every open kbase context
+ * with its used page count and owning tgid:
+ *
+ *   mali0                   81234
+ *     kctx-0xffffffc0a1b2c000       1234        567
+ *
+ * A process may hold several contexts; their pages are summed.
+ */
+class KbaseMemory
+{
+public:
+    explicit KbaseMemory(const std::string& root);
+
+    /* Appends (tgid, bytes) per context; false if the kbase debugfs is missing */
+    bool Read(std::vector<std::pair<pid_t, uint64_t>> *contexts);
+
+private:
+    const std::string mPath;
+    const uint64_t mPageSize;
+    bool mWarnedNoTgid;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_MEMTRACK_V1_0_KBASEMEMORY_H
@@ -27,10 +27,42 @@ namespace implementation {
 
 using namespace ::android::hardware;
 
+static const char * const kMetricNames[METRIC_COUNT] = {
+    "getMemory",
+};
+
+/* kbase pages are mapped VM_PFNMAP and never show up in smaps */
+static constexpr uint32_t kGlFlags = MemtrackFlag::SMAPS_UNACCOUNTED |
+                                     MemtrackFlag::PRIVATE |
+                                     MemtrackFlag::SYSTEM |
+                                     MemtrackFlag::NONSECURE;
+
+/* dma-bufs are charged proportionally to their references, split by whether smaps sees them */
+static constexpr uint32_t kDmabufFlags = MemtrackFlag::SHARED_PSS |
+                                         MemtrackFlag::SYSTEM |
+                                         MemtrackFlag::NONSECURE;
+
+static hidl_vec<MemtrackRecord> DmabufRecords(const DmabufUsage& usage)
+{
+    return {
+        { kDmabufFlags | MemtrackFlag::SMAPS_ACCOUNTED, usage.accounted },
+        { kDmabufFlags | MemtrackFlag::SMAPS_UNACCOUNTED, usage.unaccounted },
+    };
+}
+
+Memtrack::Memtrack(const std::string& root)
+    : mMetrics(kMetricNames, METRIC_COUNT), mSnapshot(root)
+{
+}
+
 // Methods from ::android::hardware::memtrack::V1_0::IMemtrack follow.
 Return<void> Memtrack::getMemory(int32_t pid, memtrack::V1_0::MemtrackType type, getMemory_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_MEMORY);
+    MemtrackStatus status = MemtrackStatus::SUCCESS;
     hidl_vec<MemtrackRecord> records;
+    MemtrackUsage usage = {};
+    bool haveGl = false;
 
     switch (type) {
         case MemtrackType::OTHER:
@@ -38,23 +70,49 @@ Return<void> Memtrack::getMemory(int32_t pid, memtrack::V1_0::MemtrackType type,
             break;
         case MemtrackType::GL:
             ALOGV("getMemory(GL): for pid=%d", pid);
+            mSnapshot.Get(pid, &usage, &haveGl);
+            if (haveGl)
+                records = { { kGlFlags, usage.gl } };
             break;
+        /* Only processes of the HAL's own uid can be read, don't pass 0 off as a measurement */
         case MemtrackType::GRAPHICS:
             ALOGV("getMemory(GRAPHICS): for pid=%d", pid);
+            if (mSnapshot.Get(pid, &usage, &haveGl) && usage.haveDmabuf)
+                records = DmabufRecords(usage.graphics);
+            else
+                status = MemtrackStatus::TYPE_NOT_SUPPORTED;
             break;
         case MemtrackType::MULTIMEDIA:
             ALOGV("getMemory(MULTIMEDIA): for pid=%d", pid);
+            if (mSnapshot.Get(pid, &usage, &haveGl) && usage.haveDmabuf)
+                records = DmabufRecords(usage.multimedia);
+            else
+                status = MemtrackStatus::TYPE_NOT_SUPPORTED;
             break;
         case MemtrackType::CAMERA:
             ALOGV("getMemory(CAMERA): for pid=%d", pid);
             break;
     };
 
-    _hidl_cb(MemtrackStatus::SUCCESS, records);
+    _hidl_cb(status, records);
     return Void();
 }
 
 // Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> Memtrack::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args)
+{
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1)
+        return Void();
+
+    bool reset = false;
+    for (const auto& arg : args) {
+        if (arg == "--reset")
+            reset = true;
+    }
+
+    mMetrics.Dump(fd->data[0], reset);
+    return Void();
+}
 
 }  // namespace implementation
 }  // namespace V1_0
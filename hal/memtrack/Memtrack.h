@@ -21,6 +21,12 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include <string>
+
+#include <HalMetrics.h>
+
+#include "MemtrackSnapshot.h"
+
 namespace android {
 namespace hardware {
 namespace memtrack {
@@ -35,13 +41,29 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::sp;
 
+using ::android::hardware::hidl_handle;
+using ::android::hardware::rockchip::HalMetrics;
+
 using namespace ::android::hardware;
 
+enum MemtrackMetric {
+    METRIC_GET_MEMORY = 0,
+    METRIC_COUNT,
+};
+
 struct Memtrack : public IMemtrack {
+    /* @root prefixes every debugfs and procfs path, for testing against a fake tree */
+    explicit Memtrack(const std::string& root = "");
+
     // Methods from ::android::hardware::memtrack::V1_0::IMemtrack follow.
     Return<void> getMemory(int32_t pid, memtrack::V1_0::MemtrackType type, getMemory_cb _hidl_cb) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override;
+
+private:
+    HalMetrics mMetrics;
+    MemtrackSnapshot mSnapshot;
 };
 
 }  // namespace implementation
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MemtrackHAL"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "MemtrackSnapshot.h"
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+/* Long enough to cover one meminfo sweep, short enough to follow app churn */
+static constexpr std::chrono::milliseconds kSnapshotTtl(500);
+
+MemtrackSnapshot::MemtrackSnapshot(const std::string& root)
+    : mProcDir(root + "/proc"),
+      mKbase(root),
+      mDmabuf(root),
+      mGeneration(0),
+      mHaveGl(false),
+      mValid(false)
+{
+    mLoadavgFd = open((mProcDir + "/loadavg").c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+MemtrackSnapshot::~MemtrackSnapshot()
+{
+    if (mLoadavgFd >= 0)
+        close(mLoadavgFd);
+}
+
+uint64_t MemtrackSnapshot::ReadGeneration()
+{
+    char buf[128];
+
+    if (mLoadavgFd < 0)
+        return 0;
+
+    ssize_t len = pread(mLoadavgFd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0)
+        return 0;
+    buf[len] = '\0';
+
+    /* "0.52 0.58 0.59 2/1203 12345": the last field is the last pid handed out */
+    const char *last = strrchr(buf, ' ');
+    return last ? strtoull(last + 1, nullptr, 10) : 0;
+}
+
+void MemtrackSnapshot::RefreshLocked()
+{
+    /* Read first, so a process created during the walk forces the next refresh */
+    mGeneration = ReadGeneration();
+
+    mContexts.clear();
+    mHaveGl = mKbase.Read(&mContexts);
+    std::sort(mContexts.begin(), mContexts.end());
+    mDmabuf.Read(&mShares);
+
+    /* Merge the two pid-sorted lists; a process may own several kbase contexts */
+    mTable.clear();
+    auto context = mContexts.begin();
+    auto share = mShares.begin();
+    while (context != mContexts.end() || share != mShares.end()) {
+        pid_t pid;
+        if (share == mShares.end() || (context != mContexts.end() && context->first < share->pid))
+            pid = context->first;
+        else
+            pid = share->pid;
+
+        MemtrackUsage usage = {};
+        for (; context != mContexts.end() && context->first == pid; context++)
+            usage.gl += context->second;
+        if (share != mShares.end() && share->pid == pid) {
+            usage.graphics = share->graphics;
+            usage.multimedia = share->multimedia;
+            usage.haveDmabuf = true;
+            share++;
+        }
+        mTable.emplace_back(pid, usage);
+    }
+
+    mLastRefresh = Clock::now();
+    mValid = true;
+}
+
+const MemtrackUsage *MemtrackSnapshot::FindLocked(pid_t pid)
+{
+    auto it = std::lower_bound(mTable.begin(), mTable.end(), pid,
+                               [](const std::pair<pid_t, MemtrackUsage>& entry, pid_t key) {
+                                   return entry.first < key;
+                               });
+    return it != mTable.end() && it->first == pid ? &it->second : nullptr;
+}
+
+bool MemtrackSnapshot::Get(pid_t pid, MemtrackUsage *usage, bool *haveGl)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (!mValid || Clock::now() - mLastRefresh >= kSnapshotTtl)
+        RefreshLocked();
+
+    const MemtrackUsage *entry = FindLocked(pid);
+    if (entry == nullptr && ReadGeneration() != mGeneration) {
+        RefreshLocked();
+        entry = FindLocked(pid);
+    }
+
+    *haveGl = mHaveGl;
+    if (entry == nullptr)
+        return false;
+
+    *usage = *entry;
+    return true;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_MEMTRACK_V1_0_MEMTRACKSNAPSHOT_H
+#define ANDROID_HARDWARE_MEMTRACK_V1_0_MEMTRACKSNAPSHOT_H
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DmabufMemory.h"
+#include "KbaseMemory.h"
+
+namespace android {
+namespace hardware {
+namespace memtrack {
+namespace V1_0 {
+namespace implementation {
+
+struct MemtrackUsage {
+    uint64_t gl;
+    DmabufUsage graphics;
+    DmabufUsage multimedia;
+    bool haveDmabuf;                    /* false when the process's dma-bufs could not be read */
+};
+
+/*
+ * System-wide memtrack accounting, built in one pass.
+ *
+ * dumpsys meminfo asks for every type of every process in turn; parsing
+ * the kbase and dma-buf sources for each query made a sweep quadratic.
+ * A refresh instead parses gpu_memory and bufinfo once and walks the
+ * fdinfo of all processes into a table sorted by pid, and the queries
+ * of the sweep are binary searches into it.
+ *
+ * The table is rebuilt once it is older than kSnapshotTtl, or when a pid
+ * it has not seen is asked for and processes were created since it was
+ * built (the last allocated pid in /proc/loadavg moved on).
+ */
+class MemtrackSnapshot
+{
+public:
+    explicit MemtrackSnapshot(const std::string& root);
+    ~MemtrackSnapshot();
+
+    /* @haveGl is false when the GPU usage is unknown rather than zero */
+    bool Get(pid_t pid, MemtrackUsage *usage, bool *haveGl);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t ReadGeneration();
+    void RefreshLocked();
+    const MemtrackUsage *FindLocked(pid_t pid);
+
+    const std::string mProcDir;
+    KbaseMemory mKbase;
+    DmabufMemory mDmabuf;
+    int mLoadavgFd;
+
+    std::mutex mLock;
+    std::vector<std::pair<pid_t, MemtrackUsage>> mTable;
+    std::vector<std::pair<pid_t, uint64_t>> mContexts;
+    std::vector<DmabufShare> mShares;
+    Clock::time_point mLastRefresh;
+    uint64_t mGeneration;
+    bool mHaveGl;
+    bool mValid;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace memtrack
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_MEMTRACK_V1_0_MEMTRACKSNAPSHOT_H
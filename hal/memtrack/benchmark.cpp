@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cost of a dumpsys meminfo sweep against the memtrack HAL, measured in
+ * process against MemtrackSnapshot:
+ *
+ *   android.hardware.memtrack@1.0-benchmark.rockchip [-p procs] [-f fds] [-b bufs] [-n sweeps] [-r root]
+ *
+ * By default a scratch procfs/debugfs tree under /data/local/tmp is
+ * populated with @procs processes of @fds fds each, @bufs of which are
+ * gralloc buffers also held and half mapped by the first process, the
+ * way SurfaceFlinger holds app buffers, plus one kbase context per
+ * process. A sweep queries GL, GRAPHICS and MULTIMEDIA of every process
+ * in turn. It is timed @sweeps times from a cold snapshot and from a
+ * warm one. A sample of queries is also timed with a snapshot rebuilt
+ * for each, which is what every query cost before the snapshot, and
+ * scaled to a sweep. With -r / the live /proc and debugfs are used
+ * instead; like the HAL, only processes of the caller's uid are read
+ * for dma-bufs.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+
+#include "BenchUtil.h"
+#include "MemtrackSnapshot.h"
+
+using namespace android::hardware::memtrack::V1_0::implementation;
+using namespace android::hardware::rockchip;
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
+
+static constexpr pid_t kFirstPid = 1000;
+static constexpr uint64_t kBufferSize = 8 << 20;
+static constexpr unsigned kGlPages = 2048;
+static constexpr size_t kUncachedQueries = 30;
+
+/* (inode, mapped) of every buffer a process holds */
+typedef std::vector<std::pair<unsigned long, bool>> Holdings;
+
+static bool CreateProcess(const std::string& procDir, pid_t pid, unsigned fds,
+                          const Holdings& inodes)
+{
+    const std::string dir = StringPrintf("%s/%d", procDir.c_str(), pid);
+    if (!MakeDirs(dir + "/fd") || !MakeDirs(dir + "/fdinfo"))
+        return false;
+
+    std::string maps = "5d2c1a4000-5d2c1a6000 r-xp 00000000 fd:00 1234    /system/bin/app_process64\n";
+    for (unsigned fd = 0; fd < std::max<size_t>(fds, inodes.size()); fd++) {
+        const std::string name = std::to_string(fd);
+        std::string target, info = "pos:\t0\nflags:\t02000002\nmnt_id:\t9\n";
+
+        if (fd < inodes.size()) {
+            target = "/dmabuf:";
+            info += StringPrintf("size:\t%llu\ncount:\t2\nexp_name:\tdrm\nino:\t%lu\n",
+                                 static_cast<unsigned long long>(kBufferSize), inodes[fd].first);
+            if (inodes[fd].second)
+                maps += StringPrintf("7f8c%06x-7f8c%06x rw-s 00000000 00:0a %lu    /dmabuf:\n",
+                                     fd << 12, (fd + 1) << 12, inodes[fd].first);
+        } else {
+            target = StringPrintf("socket:[%d]", pid * 1000 + fd);
+        }
+
+        unlink((dir + "/fd/" + name).c_str());
+        if (symlink(target.c_str(), (dir + "/fd/" + name).c_str()) != 0 ||
+            !WriteStringToFile(info, dir + "/fdinfo/" + name))
+            return false;
+    }
+
+    return WriteStringToFile(maps, dir + "/maps");
+}
+
+static bool CreateTree(const std::string& root, unsigned procs, unsigned fds, unsigned bufs)
+{
+    const std::string procDir = root + "/proc";
+    const std::string debugDir = root + "/sys/kernel/debug";
+    std::string bufinfo = "\nDma-buf Objects:\nsize\tflags\tmode\tcount\texp_name\tino\n";
+    std::string gpuMemory = StringPrintf("mali0                   %u\n", procs * kGlPages);
+    Holdings all;
+
+    if (!MakeDirs(procDir) || !MakeDirs(debugDir + "/dma_buf") || !MakeDirs(debugDir + "/mali0"))
+        return false;
+
+    /* Every app buffer is also held by the first process, mapped for half of them */
+    for (unsigned p = 1; p < procs; p++) {
+        Holdings inodes;
+        for (unsigned b = 0; b < bufs; b++) {
+            unsigned long inode = 100000 + p * bufs + b;
+            bool mapped = b < bufs / 2;
+            inodes.emplace_back(inode, mapped);
+            all.emplace_back(inode, mapped);
+            /* One fd in each holder, plus a mapping in each if mapped */
+            bufinfo += StringPrintf("%08llu\t00000002\t00080007\t%08u\tdrm\t%08lu\t\n"
+                                    "\tAttached Devices:\n\tff8f0000.vop\nTotal 1 devices attached\n\n",
+                                    static_cast<unsigned long long>(kBufferSize),
+                                    mapped ? 4 : 2, inode);
+        }
+        if (!CreateProcess(procDir, kFirstPid + p, fds, inodes))
+            return false;
+    }
+    if (!CreateProcess(procDir, kFirstPid, fds, all))
+        return false;
+
+    for (unsigned p = 0; p < procs; p++)
+        gpuMemory += StringPrintf("  kctx-0xffffffc0%08x       %u        %d\n", p, kGlPages,
+                                  kFirstPid + p);
+
+    std::string loadavg = StringPrintf("0.52 0.58 0.59 2/%u %d\n", procs, kFirstPid + procs);
+    return WriteStringToFile(bufinfo, debugDir + "/dma_buf/bufinfo") &&
+           WriteStringToFile(gpuMemory, debugDir + "/mali0/gpu_memory") &&
+           WriteStringToFile(loadavg, procDir + "/loadavg");
+}
+
+static std::vector<pid_t> ListPids(const std::string& root)
+{
+    std::vector<pid_t> pids;
+
+    DIR *dir = opendir((root + "/proc").c_str());
+    if (dir == nullptr)
+        return pids;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        char *end;
+        pid_t pid = strtol(de->d_name, &end, 10);
+        if (*end == '\0' && pid > 0)
+            pids.push_back(pid);
+    }
+    closedir(dir);
+
+    std::sort(pids.begin(), pids.end());
+    return pids;
+}
+
+/* GL, GRAPHICS and MULTIMEDIA of every pid, as dumpsys meminfo asks for them */
+static uint64_t Sweep(MemtrackSnapshot& snapshot, const std::vector<pid_t>& pids)
+{
+    uint64_t total = 0;
+
+    for (int type = 0; type < 3; type++) {
+        for (pid_t pid : pids) {
+            MemtrackUsage usage = {};
+            bool haveGl;
+            snapshot.Get(pid, &usage, &haveGl);
+            total += type == 0 ? usage.gl
+                   : type == 1 ? usage.graphics.accounted + usage.graphics.unaccounted
+                               : usage.multimedia.accounted + usage.multimedia.unaccounted;
+        }
+    }
+
+    return total;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned procs = 300, fds = 64, bufs = 6, sweeps = 10;
+    const std::string scratch = ScratchRoot("memtrack_benchmark");
+    std::string root = scratch;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:f:b:n:r:")) != -1) {
+        switch (opt) {
+        case 'p':
+            procs = strtoul(optarg, nullptr, 10);
+            break;
+        case 'f':
+            fds = strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            bufs = strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            sweeps = strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+            root = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p procs] [-f fds] [-b bufs] [-n sweeps] [-r root]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    if (procs == 0)
+        procs = 1;
+    if (sweeps == 0)
+        sweeps = 1;
+    if (root == "/")
+        root.clear();
+
+    if (root == scratch && !CreateTree(root, procs, fds, bufs)) {
+        fprintf(stderr, "%s: %s\n", root.c_str(), strerror(errno));
+        return 1;
+    }
+
+    std::vector<pid_t> pids = ListPids(root);
+    if (pids.empty()) {
+        fprintf(stderr, "no processes under %s/proc\n", root.c_str());
+        return 1;
+    }
+    printf("%zu processes under %s\n", pids.size(), root.empty() ? "/" : root.c_str());
+
+    std::vector<double> cold_ms, warm_ms, uncached_ms;
+    uint64_t total = 0;
+
+    for (unsigned i = 0; i < sweeps; i++) {
+        MemtrackSnapshot snapshot(root);
+        cold_ms.push_back(TimeMs([&] { total = Sweep(snapshot, pids); }));
+        warm_ms.push_back(TimeMs([&] { Sweep(snapshot, pids); }));
+    }
+
+    /*
+     * A snapshot per query stands in for the parse per query it replaced;
+     * a whole sweep of those takes minutes, so time a sample and scale it.
+     */
+    for (size_t i = 0; i < std::min<size_t>(pids.size(), kUncachedQueries); i++) {
+        uncached_ms.push_back(TimeMs([&] {
+            MemtrackSnapshot snapshot(root);
+            MemtrackUsage usage;
+            bool haveGl;
+            snapshot.Get(pids[i], &usage, &haveGl);
+        }));
+    }
+    double uncached = 0;
+    for (double ms : uncached_ms)
+        uncached += ms;
+    uncached *= pids.size() * 3.0 / uncached_ms.size();
+
+    Report("sweep, cold snapshot", cold_ms, "ms");
+    Report("sweep, warm snapshot", warm_ms, "ms");
+    Report("query, uncached", uncached_ms, "ms");
+    printf("%zu queries per sweep, %.1f MiB reported; uncached sweep ~%.0f ms\n",
+           pids.size() * 3, total / 1048576.0, uncached);
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "HalMetrics.h"
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+
+static std::atomic<uint64_t> sNextId(1);
+
+/* Last shard used by this thread, saves the lookup on every call */
+static thread_local struct {
+    uint64_t owner;
+    void *shard;
+} tCache = { 0, nullptr };
+
+static size_t BucketOf(uint64_t us)
+{
+    if (us < 4)
+        return us;
+
+    size_t msb = 63 - __builtin_clzll(us);
+    size_t bucket = (msb - 1) * 4 + ((us >> (msb - 2)) & 3);
+
+    return bucket < HalMetrics::kBuckets ? bucket : HalMetrics::kBuckets - 1;
+}
+
+/* Lowest latency in us that lands in @bucket */
+static uint64_t BucketFloor(size_t bucket)
+{
+    if (bucket < 4)
+        return bucket;
+
+    size_t msb = bucket / 4 + 1;
+    return (4 + bucket % 4) << (msb - 2);
+}
+
+HalMetrics::HalMetrics(const char * const *methods, size_t count)
+    : mMethods(methods), mCount(count), mId(sNextId++)
+{
+}
+
+HalMetrics::Shard *HalMetrics::GetShard()
+{
+    if (tCache.owner == mId)
+        return static_cast<Shard*>(tCache.shard);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    std::thread::id self = std::this_thread::get_id();
+    Shard *shard = nullptr;
+
+    for (const auto& s : mShards) {
+        if (s->thread == self)
+            shard = s.get();
+    }
+
+    if (shard == nullptr) {
+        size_t n = mCount * kSlotsPerMethod;
+        mShards.emplace_back(new Shard());
+        shard = mShards.back().get();
+        shard->thread = self;
+        shard->slots.reset(new std::atomic<uint64_t>[n]);
+        for (size_t i = 0; i < n; i++)
+            shard->slots[i].store(0, std::memory_order_relaxed);
+    }
+
+    tCache.owner = mId;
+    tCache.shard = shard;
+    return shard;
+}
+
+void HalMetrics::Record(size_t method, std::chrono::nanoseconds latency)
+{
+    if (method >= mCount)
+        return;
+
+    uint64_t ns = latency.count() > 0 ? latency.count() : 0;
+    std::atomic<uint64_t> *slots = &GetShard()->slots[method * kSlotsPerMethod];
+
+    /* Only the owning thread writes a shard, relaxed adds are enough */
+    slots[kSlotCount].fetch_add(1, std::memory_order_relaxed);
+    slots[kSlotTotal].fetch_add(ns, std::memory_order_relaxed);
+    if (ns > slots[kSlotMax].load(std::memory_order_relaxed))
+        slots[kSlotMax].store(ns, std::memory_order_relaxed);
+    slots[kSlotBucket + BucketOf(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void HalMetrics::Dump(int fd, bool reset)
+{
+    static const double kPercentiles[] = { 0.5, 0.9, 0.99 };
+    std::lock_guard<std::mutex> lock(mLock);
+
+    dprintf(fd, "%-28s %10s %10s %10s %10s %10s %10s\n",
+            "method", "calls", "mean(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+    for (size_t m = 0; m < mCount; m++) {
+        uint64_t count = 0, total = 0, max = 0;
+        uint64_t buckets[kBuckets] = {};
+
+        for (const auto& shard : mShards) {
+            const std::atomic<uint64_t> *slots = &shard->slots[m * kSlotsPerMethod];
+            count += slots[kSlotCount].load(std::memory_order_relaxed);
+            total += slots[kSlotTotal].load(std::memory_order_relaxed);
+            max = std::max(max, slots[kSlotMax].load(std::memory_order_relaxed));
+            for (size_t b = 0; b < kBuckets; b++)
+                buckets[b] += slots[kSlotBucket + b].load(std::memory_order_relaxed);
+        }
+
+        dprintf(fd, "%-28s %10llu", mMethods[m], (unsigned long long)count);
+        if (count == 0) {
+            dprintf(fd, "\n");
+            continue;
+        }
+
+        dprintf(fd, " %10llu", (unsigned long long)(total / count / 1000));
+        for (double pct : kPercentiles) {
+            uint64_t rank = count * pct, seen = 0;
+            size_t b = 0;
+            while (b < kBuckets - 1 && (seen += buckets[b]) <= rank)
+                b++;
+            dprintf(fd, " %10llu", (unsigned long long)BucketFloor(b));
+        }
+        dprintf(fd, " %10llu\n", (unsigned long long)(max / 1000));
+    }
+
+    if (reset) {
+        for (const auto& shard : mShards) {
+            for (size_t i = 0; i < mCount * kSlotsPerMethod; i++)
+                shard->slots[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
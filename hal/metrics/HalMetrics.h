@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_ROCKCHIP_HALMETRICS_H
+#define ANDROID_HARDWARE_ROCKCHIP_HALMETRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace rockchip {
+
+/*
+ * Per-method call counters and latency histograms for the HAL services,
+ * dumped through IBase::debug() (lshal debug <fqname>).
+ *
+ * Every thread records into its own shard with relaxed atomic adds, so the
+ * binder threads never contend with each other; only the dump walks all
+ * shards. Latencies go into log-linear buckets (four per power of two,
+ * microsecond resolution), which bounds the percentile error to 25%.
+ */
+class HalMetrics
+{
+public:
+    /* @methods must outlive the HalMetrics object, usually a static table */
+    HalMetrics(const char * const *methods, size_t count);
+
+    HalMetrics(const HalMetrics&) = delete;
+    HalMetrics& operator=(const HalMetrics&) = delete;
+
+    void Record(size_t method, std::chrono::nanoseconds latency);
+
+    /* Writes a text report to @fd; @reset clears the counters afterwards */
+    void Dump(int fd, bool reset);
+
+    /* Times the enclosing scope as one call of @method */
+    class Scope
+    {
+    public:
+        Scope(HalMetrics& metrics, size_t method)
+            : mMetrics(metrics), mMethod(method), mStart(std::chrono::steady_clock::now()) {}
+        ~Scope() { mMetrics.Record(mMethod, std::chrono::steady_clock::now() - mStart); }
+
+    private:
+        HalMetrics& mMetrics;
+        size_t mMethod;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    static constexpr size_t kBuckets = 96;
+
+private:
+    /* count, total ns, max ns, then kBuckets histogram slots per method */
+    static constexpr size_t kSlotCount = 0;
+    static constexpr size_t kSlotTotal = 1;
+    static constexpr size_t kSlotMax = 2;
+    static constexpr size_t kSlotBucket = 3;
+    static constexpr size_t kSlotsPerMethod = kSlotBucket + kBuckets;
+
+    struct Shard {
+        std::thread::id thread;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    Shard *GetShard();
+
+    const char * const *mMethods;
+    const size_t mCount;
+    const uint64_t mId;
+
+    std::mutex mLock;
+    std::vector<std::unique_ptr<Shard>> mShards;
+};
+
+}  // namespace rockchip
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_ROCKCHIP_HALMETRICS_H
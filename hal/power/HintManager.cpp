@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHAL"
+#include <log/log.h>
+
+#include <algorithm>
+
+#include "HintManager.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+HintManager::HintManager(NodeTable& nodes, std::unique_ptr<PowerProfile> profile)
+    : mNodes(nodes), mProfile(std::move(profile)), mExit(false)
+{
+    if (mProfile == nullptr)
+        mProfile.reset(new PowerProfile());
+
+    mRequests.resize(mProfile->nodes.size() * HINT_COUNT, Request{ false, 0, {} });
+
+    for (const auto& node : mProfile->nodes) {
+        if (!node.captureDefault)
+            mNodes.Write(node.id, node.values[node.defaultIndex]);
+        mApplied.push_back(node.defaultIndex);
+    }
+
+    mThread = std::thread(&HintManager::ThreadLoop, this);
+}
+
+HintManager::~HintManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCond.notify_one();
+    mThread.join();
+}
+
+void HintManager::DoHint(ProfileHint hint, uint32_t durationMs)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    Clock::time_point now = Clock::now();
+    bool rearm = false;
+
+    for (const auto& action : mProfile->actions[hint]) {
+        Request& req = GetRequest(action.node, hint);
+        Clock::time_point deadline = Clock::time_point::max();
+
+        if (action.durationMs) {
+            uint32_t ms = durationMs ? std::min(durationMs, kMaxDurationMs) : action.durationMs;
+            deadline = now + std::chrono::milliseconds(ms);
+        }
+
+        /* A repeated hint only ever extends the running request */
+        if (req.active && req.deadline >= deadline)
+            continue;
+
+        bool wasActive = req.active;
+        req.active = true;
+        req.value = action.value;
+        req.deadline = deadline;
+        rearm = true;
+
+        if (!wasActive)
+            UpdateNodeLocked(action.node);
+    }
+
+    if (rearm)
+        mCond.notify_one();
+}
+
+void HintManager::EndHint(ProfileHint hint)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (const auto& action : mProfile->actions[hint]) {
+        Request& req = GetRequest(action.node, hint);
+        if (!req.active)
+            continue;
+
+        req.active = false;
+        UpdateNodeLocked(action.node);
+    }
+}
+
+void HintManager::SetHintValue(ProfileHint hint, size_t node, uint16_t value)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (node >= mProfile->nodes.size() || value >= mProfile->nodes[node].values.size())
+        return;
+
+    Request& req = GetRequest(node, hint);
+    if (!req.active || req.value == value)
+        return;
+
+    req.value = value;
+    UpdateNodeLocked(node);
+}
+
+void HintManager::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    while (!mExit) {
+        Clock::time_point next = Clock::time_point::max();
+        for (const auto& req : mRequests) {
+            if (req.active)
+                next = std::min(next, req.deadline);
+        }
+
+        if (next == Clock::time_point::max()) {
+            mCond.wait(lock);
+            continue;
+        }
+
+        if (mCond.wait_until(lock, next) != std::cv_status::timeout)
+            continue;
+
+        Clock::time_point now = Clock::now();
+        for (size_t n = 0; n < mProfile->nodes.size(); n++) {
+            bool expired = false;
+            for (size_t h = 0; h < HINT_COUNT; h++) {
+                Request& req = GetRequest(n, h);
+                if (req.active && req.deadline <= now) {
+                    req.active = false;
+                    expired = true;
+                }
+            }
+
+            if (expired)
+                UpdateNodeLocked(n);
+        }
+    }
+}
+
+void HintManager::UpdateNodeLocked(size_t node)
+{
+    ProfileNode& pnode = mProfile->nodes[node];
+    uint32_t target = pnode.defaultIndex;
+
+    for (size_t h = 0; h < HINT_COUNT; h++) {
+        const Request& req = GetRequest(node, h);
+        if (req.active)
+            target = std::min<uint32_t>(target, req.value);
+    }
+
+    if (target == mApplied[node])
+        return;
+
+    if (pnode.captureDefault && mApplied[node] == pnode.defaultIndex) {
+        std::string& baseline = pnode.values[pnode.defaultIndex];
+        if (mNodes.Read(pnode.id, &baseline))
+            pnode.captureDefault = false;
+    }
+
+    /* An uncaptured baseline was never changed by us, there is nothing to restore */
+    const std::string& val = pnode.values[target];
+    if (!val.empty())
+        mNodes.Write(pnode.id, val);
+    mApplied[node] = target;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
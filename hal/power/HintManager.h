@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_0_HINTMANAGER_H
+#define ANDROID_HARDWARE_POWER_V1_0_HINTMANAGER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "NodeTable.h"
+#include "PowerProfile.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Applies the actions of a PowerProfile. Every (node, hint) pair holds at
+ * most one timed request; a node is set to the highest priority value
+ * among its active requests, or to its default when none is left, so
+ * overlapping hints merge instead of stacking writes. Expiry is handled
+ * by a single timer thread.
+ */
+class HintManager
+{
+public:
+    /* Longest a caller's duration can make a timed action */
+    static constexpr uint32_t kMaxDurationMs = 5000;
+
+    HintManager(NodeTable& nodes, std::unique_ptr<PowerProfile> profile);
+    ~HintManager();
+
+    /*
+     * @durationMs, if non-zero, replaces the profile's duration of timed
+     * actions of the hint, up to kMaxDurationMs
+     */
+    void DoHint(ProfileHint hint, uint32_t durationMs);
+    void EndHint(ProfileHint hint);
+
+    /* Changes the value requested by an active held @hint on @node */
+    void SetHintValue(ProfileHint hint, size_t node, uint16_t value);
+
+    const PowerProfile& GetProfile() const { return *mProfile; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request {
+        bool active;
+        uint16_t value;
+        Clock::time_point deadline;
+    };
+
+    Request& GetRequest(size_t node, size_t hint) { return mRequests[node * HINT_COUNT + hint]; }
+
+    void ThreadLoop();
+    void UpdateNodeLocked(size_t node);
+
+    NodeTable& mNodes;
+    std::unique_ptr<PowerProfile> mProfile;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::vector<Request> mRequests;
+    std::vector<uint32_t> mApplied;         /* value index currently set on each node */
+    bool mExit;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_0_HINTMANAGER_H
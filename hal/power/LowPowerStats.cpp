@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHAL"
+#include <log/log.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <android-base/stringprintf.h>
+
+#include "LowPowerStats.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+using ::android::base::StringPrintf;
+
+/* system_server polls this on every battery stats update */
+static constexpr std::chrono::milliseconds kStatsTtl(1000);
+
+static const char *kSuspendStatsPath = "/sys/power/suspend_stats/success";
+static const char *kSuspendStatsDebugfsPath = "/sys/kernel/debug/suspend_stats";
+
+static bool PreadString(int fd, char *buf, size_t size)
+{
+    ssize_t len = pread(fd, buf, size - 1, 0);
+    if (len <= 0)
+        return false;
+
+    buf[len] = '\0';
+    return true;
+}
+
+static uint64_t PreadU64(int fd)
+{
+    char buf[32];
+
+    if (fd < 0 || !PreadString(fd, buf, sizeof(buf)))
+        return 0;
+
+    return strtoull(buf, nullptr, 10);
+}
+
+/* "policyN" of the cpufreq policy @cpu belongs to, "cpuN" without cpufreq */
+static std::string ClusterName(const std::string& cpuDir, unsigned cpu)
+{
+    std::string policy;
+
+    if (!::android::base::Readlink(StringPrintf("%s/cpu%u/cpufreq", cpuDir.c_str(), cpu), &policy))
+        return StringPrintf("cpu%u", cpu);
+
+    return ::android::base::Basename(policy);
+}
+
+static uint64_t ClockMs(clockid_t clock)
+{
+    struct timespec ts;
+
+    if (clock_gettime(clock, &ts) < 0)
+        return 0;
+
+    return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+LowPowerStats::LowPowerStats(const std::string& root)
+    : mValid(false), mSuspendDebugfs(false)
+{
+    mSuspendFd = open((root + kSuspendStatsPath).c_str(), O_RDONLY | O_CLOEXEC);
+    if (mSuspendFd < 0) {
+        mSuspendFd = open((root + kSuspendStatsDebugfsPath).c_str(), O_RDONLY | O_CLOEXEC);
+        mSuspendDebugfs = true;
+    }
+    if (mSuspendFd < 0) {
+        ALOGW("%s: No suspend statistics available", __func__);
+    }
+
+    std::vector<PowerStatePlatformSleepState> states(1);
+    states[0].name = "suspend";
+    states[0].supportedOnlyInSuspend = true;
+    mStates = states;
+
+    DiscoverCpuidle(root);
+}
+
+LowPowerStats::~LowPowerStats()
+{
+    if (mSuspendFd >= 0)
+        close(mSuspendFd);
+
+    for (const auto& counter : mIdleCounters) {
+        close(counter.timeFd);
+        close(counter.usageFd);
+    }
+}
+
+void LowPowerStats::DiscoverCpuidle(const std::string& root)
+{
+    const std::string cpuDir = root + "/sys/devices/system/cpu";
+    std::vector<PowerStatePlatformSleepState> states(mStates);
+    std::vector<std::vector<PowerStateVoter>> voters(states.size());
+    std::vector<unsigned> cpus;
+
+    DIR *dir = opendir(cpuDir.c_str());
+    if (dir == nullptr) {
+        ALOGW("%s: Error opening %s: %s", __func__, cpuDir.c_str(), strerror(errno));
+        return;
+    }
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != nullptr) {
+        unsigned cpu;
+        char tail;
+        if (sscanf(de->d_name, "cpu%u%c", &cpu, &tail) == 1)
+            cpus.push_back(cpu);
+    }
+    closedir(dir);
+    std::sort(cpus.begin(), cpus.end());
+
+    for (unsigned cpu : cpus) {
+        for (unsigned n = 0; ; n++) {
+            const std::string stateDir = StringPrintf("%s/cpu%u/cpuidle/state%u",
+                                                      cpuDir.c_str(), cpu, n);
+            std::string name;
+            if (!::android::base::ReadFileToString(stateDir + "/name", &name))
+                break;
+            name = StringPrintf("cpuidle.%s.%s", ClusterName(cpuDir, cpu).c_str(),
+                                ::android::base::Trim(name).c_str());
+
+            IdleCounter counter;
+            counter.timeFd = open((stateDir + "/time").c_str(), O_RDONLY | O_CLOEXEC);
+            counter.usageFd = open((stateDir + "/usage").c_str(), O_RDONLY | O_CLOEXEC);
+            if (counter.timeFd < 0 || counter.usageFd < 0) {
+                ALOGW("%s: Incomplete counters in %s", __func__, stateDir.c_str());
+                if (counter.timeFd >= 0)
+                    close(counter.timeFd);
+                if (counter.usageFd >= 0)
+                    close(counter.usageFd);
+                continue;
+            }
+
+            for (counter.state = 0; counter.state < states.size(); counter.state++) {
+                if (states[counter.state].name == name)
+                    break;
+            }
+            if (counter.state == states.size()) {
+                states.emplace_back();
+                states.back().name = name;
+                states.back().supportedOnlyInSuspend = false;
+                voters.emplace_back();
+            }
+
+            counter.voter = voters[counter.state].size();
+            voters[counter.state].emplace_back();
+            voters[counter.state].back().name = StringPrintf("cpu%u", cpu);
+
+            mIdleCounters.push_back(counter);
+        }
+    }
+
+    for (size_t i = 0; i < states.size(); i++)
+        states[i].voters = voters[i];
+    mStates = states;
+}
+
+void LowPowerStats::RefreshLocked()
+{
+    PowerStatePlatformSleepState& suspend = mStates[0];
+
+    suspend.residencyInMsecSinceBoot = ClockMs(CLOCK_BOOTTIME) - ClockMs(CLOCK_MONOTONIC);
+    if (!mSuspendDebugfs) {
+        suspend.totalTransitions = PreadU64(mSuspendFd);
+    } else if (mSuspendFd >= 0) {
+        /* "success: N" is the first line of /d/suspend_stats */
+        char buf[64];
+        if (PreadString(mSuspendFd, buf, sizeof(buf))) {
+            const char *p = strstr(buf, "success:");
+            suspend.totalTransitions = p ? strtoull(p + strlen("success:"), nullptr, 10) : 0;
+        }
+    }
+
+    for (size_t i = 1; i < mStates.size(); i++) {
+        mStates[i].residencyInMsecSinceBoot = UINT64_MAX;
+        mStates[i].totalTransitions = UINT64_MAX;
+    }
+
+    for (const auto& counter : mIdleCounters) {
+        PowerStatePlatformSleepState& state = mStates[counter.state];
+        PowerStateVoter& voter = state.voters[counter.voter];
+
+        voter.totalTimeInMsecVoting = PreadU64(counter.timeFd) / 1000;
+        voter.totalNumberOfTimesVoted = PreadU64(counter.usageFd);
+
+        state.residencyInMsecSinceBoot = std::min(state.residencyInMsecSinceBoot,
+                                                  voter.totalTimeInMsecVoting);
+        state.totalTransitions = std::min(state.totalTransitions, voter.totalNumberOfTimesVoted);
+    }
+
+    mLastRefresh = Clock::now();
+    mValid = true;
+}
+
+void LowPowerStats::Get(hidl_vec<PowerStatePlatformSleepState> *states)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (!mValid || Clock::now() - mLastRefresh >= kStatsTtl)
+        RefreshLocked();
+
+    *states = mStates;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_0_LOWPOWERSTATS_H
+#define ANDROID_HARDWARE_POWER_V1_0_LOWPOWERSTATS_H
+
+#include <android/hardware/power/1.0/IPower.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+using ::android::hardware::hidl_vec;
+
+/*
+ * Platform low power state residency for getPlatformLowPowerStats():
+ *
+ *  - "suspend": time spent in system suspend (CLOCK_BOOTTIME minus
+ *    CLOCK_MONOTONIC) and the number of successful suspends from
+ *    /sys/power/suspend_stats or /d/suspend_stats;
+ *  - one entry per cpuidle state of each cluster (cpufreq policy), with
+ *    one voter per CPU carrying that CPU's residency and entry count.
+ *    The cluster itself can have been in the state no longer and no
+ *    more often than its least idle CPU, so the entry reports the
+ *    minimum over the voters rather than a sum that would exceed the
+ *    time since boot.
+ *
+ * The stat files are discovered and opened once; a refresh only preads
+ * the counters into the already built result, and results younger than
+ * kStatsTtl are served from the cache.
+ */
+class LowPowerStats
+{
+public:
+    explicit LowPowerStats(const std::string& root);
+    ~LowPowerStats();
+
+    void Get(hidl_vec<PowerStatePlatformSleepState> *states);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct IdleCounter {
+        size_t state;                   /* index into mStates */
+        size_t voter;                   /* index into mStates[state].voters */
+        int timeFd;                     /* stateN/time, us */
+        int usageFd;                    /* stateN/usage */
+    };
+
+    void DiscoverCpuidle(const std::string& root);
+    void RefreshLocked();
+
+    std::mutex mLock;
+    hidl_vec<PowerStatePlatformSleepState> mStates;
+    Clock::time_point mLastRefresh;
+    bool mValid;
+
+    int mSuspendFd;
+    bool mSuspendDebugfs;               /* mSuspendFd is /d/suspend_stats, not a plain counter */
+    std::vector<IdleCounter> mIdleCounters;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_0_LOWPOWERSTATS_H
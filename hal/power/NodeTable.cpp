@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHAL"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+
+#include "NodeTable.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+NodeTable::~NodeTable()
+{
+    for (auto& node : mNodes) {
+        if (node.fd >= 0)
+            close(node.fd);
+    }
+}
+
+NodeId NodeTable::Add(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    for (NodeId id = 0; id < mNodes.size(); id++) {
+        if (mNodes[id].path == path)
+            return id;
+    }
+
+    Node node;
+    node.path = path;
+    node.fd = -1;
+    node.truncate = false;
+    node.openFailed = false;
+    node.lastLen = 0;
+    OpenLocked(node);
+
+    mNodes.push_back(node);
+    return mNodes.size() - 1;
+}
+
+bool NodeTable::OpenLocked(Node& node)
+{
+    node.fd = open(node.path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (node.fd < 0) {
+        /* Retried on every write; only the first failure is worth a log line */
+        if (!node.openFailed)
+            ALOGE("%s: Error opening %s: %s", __func__, node.path.c_str(), strerror(errno));
+        node.openFailed = true;
+        return false;
+    }
+
+    if (node.openFailed)
+        ALOGI("%s: Opened %s", __func__, node.path.c_str());
+    node.openFailed = false;
+
+    /* Plain files (a fake tree on a host) keep stale bytes past the new value */
+    struct statfs sfs;
+    if (fstatfs(node.fd, &sfs) == 0)
+        node.truncate = sfs.f_type != SYSFS_MAGIC && sfs.f_type != CGROUP_SUPER_MAGIC &&
+                        sfs.f_type != CGROUP2_SUPER_MAGIC;
+    return true;
+}
+
+bool NodeTable::Read(NodeId id, std::string *val)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (id >= mNodes.size())
+            return false;
+        path = mNodes[id].path;
+    }
+
+    if (!::android::base::ReadFileToString(path, val)) {
+        ALOGE("%s: Error reading %s: %s", __func__, path.c_str(), strerror(errno));
+        return false;
+    }
+
+    *val = ::android::base::Trim(*val);
+    return !val->empty();
+}
+
+bool NodeTable::Write(NodeId id, const char *val, size_t len)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (id >= mNodes.size())
+        return false;
+
+    Node& node = mNodes[id];
+    if (node.fd < 0 && !OpenLocked(node))
+        return false;
+
+    if (len == node.lastLen && !memcmp(val, node.last, len))
+        return true;
+
+    if (pwrite(node.fd, val, len, 0) < 0) {
+        ALOGE("%s: Write error %s: %s", __func__, node.path.c_str(), strerror(errno));
+        node.lastLen = 0;
+        return false;
+    }
+
+    if (node.truncate)
+        (void)ftruncate(node.fd, len);
+
+    if (len <= kMaxValueLen) {
+        memcpy(node.last, val, len);
+        node.lastLen = len;
+    } else {
+        node.lastLen = 0;
+    }
+
+    return true;
+}
+
+bool NodeTable::Write(NodeId id, uint32_t val)
+{
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%u", val);
+
+    return Write(id, buf, len);
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_0_NODETABLE_H
+#define ANDROID_HARDWARE_POWER_V1_0_NODETABLE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+typedef size_t NodeId;
+
+static constexpr NodeId kInvalidNode = static_cast<NodeId>(-1);
+
+/*
+ * Table of pre-opened sysfs/cgroup tunables. Every node is opened once
+ * when it is added and written with pwrite() on the cached fd afterwards,
+ * so the hint path costs a single syscall per changed value. Writes that
+ * repeat the last value written to a node are dropped. A node that could
+ * not be opened, e.g. because init had not handed it over yet, is opened
+ * again by the next write to it.
+ */
+class NodeTable
+{
+public:
+    NodeTable() = default;
+    ~NodeTable();
+
+    NodeTable(const NodeTable&) = delete;
+    NodeTable& operator=(const NodeTable&) = delete;
+
+    /* Returns the id of @path, opening it on first use */
+    NodeId Add(const std::string& path);
+
+    const std::string& GetPath(NodeId id) const { return mNodes[id].path; }
+
+    /* Reads the current content of @id, without trailing whitespace */
+    bool Read(NodeId id, std::string *val);
+
+    bool Write(NodeId id, const char *val, size_t len);
+    bool Write(NodeId id, const std::string& val) { return Write(id, val.data(), val.size()); }
+    bool Write(NodeId id, uint32_t val);
+
+private:
+    static constexpr size_t kMaxValueLen = 32;
+
+    struct Node {
+        std::string path;
+        int fd;
+        bool truncate;
+        bool openFailed;
+        size_t lastLen;                 /* 0 while the last value is unknown */
+        char last[kMaxValueLen];
+    };
+
+    /* Opens @node.path into @node.fd; called with mLock held */
+    static bool OpenLocked(Node& node);
+
+    std::mutex mLock;
+    std::vector<Node> mNodes;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_0_NODETABLE_H
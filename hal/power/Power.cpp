@@ -17,6 +17,9 @@
 #define LOG_TAG "PowerHAL"
 #include <log/log.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+#include <android-base/properties.h>
 
 #include "Power.h"
 
@@ -26,32 +29,79 @@ namespace power {
 namespace V1_0 {
 namespace implementation {
 
-Power::Power(void)
+static const char *kPowerHintPath = "/vendor/etc/powerhint.json";
+
+static const char * const kMetricNames[METRIC_COUNT] = {
+    "setInteractive",
+    "powerHint",
+    "setFeature",
+    "getPlatformLowPowerStats",
+};
+
+Power::Power(const std::string& root)
+    : mMetrics(kMetricNames, METRIC_COUNT), mStats(root)
 {
+    std::string error;
+
+    /* A board may ship its own powerhint.<ro.hardware>.json */
+    std::string path = root + "/vendor/etc/powerhint." +
+                       ::android::base::GetProperty("ro.hardware", "") + ".json";
+    if (access(path.c_str(), R_OK) != 0)
+        path = root + kPowerHintPath;
+
+    std::unique_ptr<PowerProfile> profile = PowerProfile::Load(path, root, mNodes, &error);
+    if (profile == nullptr) {
+        ALOGE("Power profile rejected, hints are disabled: %s", error.c_str());
+    }
 
+    mHints.reset(new HintManager(mNodes, std::move(profile)));
+    mSustained.reset(new SustainedPerfMode(*mHints));
 }
 
 // Methods from ::android::hardware::power::V1_0::IPower follow.
 Return<void> Power::setInteractive(bool interactive)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_SET_INTERACTIVE);
+
     ALOGD("%s: interactive=%d", __func__, interactive);
+
+    /* Screen off holds the NON_INTERACTIVE profile, screen on drops it in one go */
+    if (interactive)
+        mHints->EndHint(HINT_NON_INTERACTIVE);
+    else
+        mHints->DoHint(HINT_NON_INTERACTIVE, 0);
+
     return Void();
 }
 
 Return<void> Power::powerHint(power::V1_0::PowerHint hint, int32_t data)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_POWER_HINT);
+
     switch(hint) {
         case PowerHint::INTERACTION:
-            ALOGD("%s: INTERACTION 0x%08x", __func__, data);
+            ALOGV("%s: INTERACTION 0x%08x", __func__, data);
+            /* data is the requested boost duration in ms, 0 means profile default */
+            mHints->DoHint(HINT_INTERACTION, data > 0 ? data : 0);
             break;
+        /* For the mode hints data is 1 on enter and 0 on exit */
         case PowerHint::LOW_POWER:
             ALOGD("%s: LOW_POWER 0x%08x", __func__, data);
+            DoModeHint(HINT_LOW_POWER, data);
             break;
         case PowerHint::SUSTAINED_PERFORMANCE:
             ALOGD("%s: SUSTAINED_PERFORMANCE 0x%08x", __func__, data);
+            if (data) {
+                DoModeHint(HINT_SUSTAINED_PERFORMANCE, data);
+                mSustained->Start();
+            } else {
+                mSustained->Stop();
+                DoModeHint(HINT_SUSTAINED_PERFORMANCE, data);
+            }
             break;
         case PowerHint::LAUNCH:
-            ALOGD("%s: LAUNCH 0x%08x", __func__, data);
+            ALOGV("%s: LAUNCH 0x%08x", __func__, data);
+            DoModeHint(HINT_LAUNCH, data);
             break;
 
         case PowerHint::VSYNC:
@@ -65,6 +115,8 @@ Return<void> Power::powerHint(power::V1_0::PowerHint hint, int32_t data)
 
 Return<void> Power::setFeature(power::V1_0::Feature feature, bool /*activate*/)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_SET_FEATURE);
+
     if (feature == Feature::POWER_FEATURE_DOUBLE_TAP_TO_WAKE) {
         ALOGW("Double tap to wake is not supported");
     } else {
@@ -76,32 +128,40 @@ Return<void> Power::setFeature(power::V1_0::Feature feature, bool /*activate*/)
 
 Return<void> Power::getPlatformLowPowerStats(getPlatformLowPowerStats_cb _hidl_cb)
 {
+    HalMetrics::Scope scope(mMetrics, METRIC_GET_PLATFORM_LOW_POWER_STATS);
     hidl_vec<PowerStatePlatformSleepState> stats;
 
-    ALOGD("%s", __func__);
+    ALOGV("%s", __func__);
+    mStats.Get(&stats);
 
     _hidl_cb(stats, Status::SUCCESS);
     return Void();
 }
 
-void Power::SysfsWrite(const char *path, const char *val)
+void Power::DoModeHint(ProfileHint hint, int32_t data)
 {
-    int fd = open(path, O_WRONLY);
-    if (fd < 0) {
-        ALOGE("%s: Error opening %s: %s", __func__, path, strerror(errno));
-        return;
-    }
+    if (data)
+        mHints->DoHint(hint, 0);
+    else
+        mHints->EndHint(hint);
+}
 
-    int len = write(fd, val, strlen(val));
-    if (len < 0) {
-        ALOGE("%s: Write error %s: %s", __func__, path, strerror(errno));
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> Power::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args)
+{
+    if (fd.getNativeHandle() == nullptr || fd->numFds < 1)
+        return Void();
+
+    bool reset = false;
+    for (const auto& arg : args) {
+        if (arg == "--reset")
+            reset = true;
     }
 
-    close(fd);
+    mMetrics.Dump(fd->data[0], reset);
+    return Void();
 }
 
-// Methods from ::android::hidl::base::V1_0::IBase follow.
-
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace power
@@ -21,6 +21,15 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 
+#include <memory>
+
+#include <HalMetrics.h>
+
+#include "HintManager.h"
+#include "LowPowerStats.h"
+#include "NodeTable.h"
+#include "ThermalGovernor.h"
+
 namespace android {
 namespace hardware {
 namespace power {
@@ -35,11 +44,22 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 using ::android::sp;
 
+using ::android::hardware::hidl_handle;
+using ::android::hardware::rockchip::HalMetrics;
+
 using namespace android::hardware;
 
+enum PowerMetric {
+    METRIC_SET_INTERACTIVE = 0,
+    METRIC_POWER_HINT,
+    METRIC_SET_FEATURE,
+    METRIC_GET_PLATFORM_LOW_POWER_STATS,
+    METRIC_COUNT,
+};
+
 struct Power : public IPower
 {
-    Power(void);
+    explicit Power(const std::string& root = "");
 
     // Methods from ::android::hardware::power::V1_0::IPower follow.
     Return<void> setInteractive(bool interactive) override;
@@ -48,9 +68,16 @@ struct Power : public IPower
     Return<void> getPlatformLowPowerStats(getPlatformLowPowerStats_cb _hidl_cb) override;
 
     // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& args) override;
 
 private:
-    void SysfsWrite(const char *path, const char *val);
+    void DoModeHint(ProfileHint hint, int32_t data);
+
+    HalMetrics mMetrics;
+    NodeTable mNodes;
+    std::unique_ptr<HintManager> mHints;
+    std::unique_ptr<SustainedPerfMode> mSustained;
+    LowPowerStats mStats;
 };
 
 }  // namespace implementation
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHAL"
+#include <log/log.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+
+#include <json/reader.h>
+#include <json/value.h>
+
+#include "PowerProfile.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+using ::android::base::StringPrintf;
+
+static const char *kHintNames[HINT_COUNT] = {
+    "INTERACTION",
+    "LAUNCH",
+    "LOW_POWER",
+    "SUSTAINED_PERFORMANCE",
+    "NON_INTERACTIVE",
+};
+
+static constexpr size_t kMaxNodes = UINT16_MAX;
+static constexpr size_t kMaxValues = UINT16_MAX;
+
+static bool GetString(const Json::Value& obj, const char *key, std::string *out)
+{
+    if (!obj.isMember(key) || !obj[key].isString())
+        return false;
+    *out = obj[key].asString();
+    return !out->empty();
+}
+
+static int FindNode(const PowerProfile& profile, const std::string& name)
+{
+    for (size_t n = 0; n < profile.nodes.size(); n++) {
+        if (profile.nodes[n].name == name)
+            return n;
+    }
+    return -1;
+}
+
+static int FindHint(const std::string& name)
+{
+    for (int i = 0; i < HINT_COUNT; i++) {
+        if (name == kHintNames[i])
+            return i;
+    }
+    return -1;
+}
+
+static bool ParseThermal(const Json::Value& obj, const std::string& root,
+                         PowerProfile *profile, std::string *error)
+{
+    ProfileThermal& thermal = profile->thermal;
+
+    const Json::Value& zones = obj["ThermalZones"];
+    if (!zones.isArray() || zones.size() == 0) {
+        *error = "\"ThermalZones\" must be a non-empty array";
+        return false;
+    }
+    for (Json::ArrayIndex i = 0; i < zones.size(); i++) {
+        if (!zones[i].isString()) {
+            *error = StringPrintf("ThermalZones[%u] is not a string", i);
+            return false;
+        }
+        thermal.zones.push_back(root + zones[i].asString());
+    }
+
+    const Json::Value& nodes = obj["Nodes"];
+    if (!nodes.isArray() || nodes.size() == 0) {
+        *error = "\"Nodes\" must be a non-empty array";
+        return false;
+    }
+    thermal.maxStep = 0;
+    for (Json::ArrayIndex i = 0; i < nodes.size(); i++) {
+        int n = nodes[i].isString() ? FindNode(*profile, nodes[i].asString()) : -1;
+        if (n < 0) {
+            *error = StringPrintf("Nodes[%u]: unknown node", i);
+            return false;
+        }
+
+        /* The governor steps down from the value SUSTAINED_PERFORMANCE sets */
+        const ProfileAction *base = nullptr;
+        for (const auto& action : profile->actions[HINT_SUSTAINED_PERFORMANCE]) {
+            if (action.node == n)
+                base = &action;
+        }
+        if (base == nullptr) {
+            *error = StringPrintf("Nodes[%u]: \"%s\" has no SUSTAINED_PERFORMANCE action",
+                                  i, nodes[i].asCString());
+            return false;
+        }
+
+        thermal.nodes.push_back(n);
+        thermal.maxStep = std::max<uint32_t>(thermal.maxStep, base->value);
+    }
+
+    const Json::Value& target = obj["TargetTemp"];
+    const Json::Value& hysteresis = obj["Hysteresis"];
+    const Json::Value& period = obj["PeriodMs"];
+    const Json::Value& stepUp = obj["StepUpSamples"];
+    if (!target.isInt() || !hysteresis.isUInt() || !period.isUInt() || period.asUInt() == 0 ||
+        !stepUp.isUInt()) {
+        *error = "\"TargetTemp\", \"Hysteresis\", \"PeriodMs\" and \"StepUpSamples\" "
+                 "must be integers";
+        return false;
+    }
+    thermal.targetTemp = target.asInt();
+    thermal.hysteresis = hysteresis.asUInt();
+    thermal.periodMs = period.asUInt();
+    thermal.stepUpSamples = stepUp.asUInt();
+
+    return true;
+}
+
+std::unique_ptr<PowerProfile> PowerProfile::Load(const std::string& path, const std::string& root,
+                                                 NodeTable& table, std::string *error)
+{
+    std::string json;
+
+    if (!::android::base::ReadFileToString(path, &json)) {
+        *error = StringPrintf("%s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    std::unique_ptr<PowerProfile> profile = Parse(json, root, table, error);
+    if (profile == nullptr)
+        *error = path + ": " + *error;
+
+    return profile;
+}
+
+std::unique_ptr<PowerProfile> PowerProfile::Parse(const std::string& json, const std::string& root,
+                                                  NodeTable& table, std::string *error)
+{
+    Json::Value doc;
+    Json::Reader reader;
+
+    if (!reader.parse(json, doc)) {
+        *error = reader.getFormattedErrorMessages();
+        return nullptr;
+    }
+
+    const Json::Value& nodes = doc["Nodes"];
+    if (!nodes.isArray() || nodes.size() == 0 || nodes.size() > kMaxNodes) {
+        *error = "\"Nodes\" must be a non-empty array";
+        return nullptr;
+    }
+
+    std::unique_ptr<PowerProfile> profile(new PowerProfile());
+    std::vector<std::string> paths;
+
+    for (Json::ArrayIndex i = 0; i < nodes.size(); i++) {
+        const Json::Value& obj = nodes[i];
+        ProfileNode node;
+        std::string path, fallback;
+
+        if (!GetString(obj, "Name", &node.name) || !GetString(obj, "Path", &path)) {
+            *error = StringPrintf("Nodes[%u]: missing \"Name\" or \"Path\"", i);
+            return nullptr;
+        }
+
+        for (const auto& other : profile->nodes) {
+            if (other.name == node.name) {
+                *error = StringPrintf("Nodes[%u]: duplicate node \"%s\"", i, node.name.c_str());
+                return nullptr;
+            }
+        }
+
+        const Json::Value& values = obj["Values"];
+        if (!values.isArray() || values.size() == 0 || values.size() > kMaxValues) {
+            *error = StringPrintf("Node \"%s\": \"Values\" must be a non-empty array",
+                                  node.name.c_str());
+            return nullptr;
+        }
+
+        for (Json::ArrayIndex v = 0; v < values.size(); v++) {
+            if (!values[v].isString()) {
+                *error = StringPrintf("Node \"%s\": Values[%u] is not a string",
+                                      node.name.c_str(), v);
+                return nullptr;
+            }
+            node.values.push_back(values[v].asString());
+        }
+
+        const Json::Value& def = obj["DefaultIndex"];
+        if (def.isNull()) {
+            /* Placeholder for the value captured from the node at runtime */
+            node.values.push_back("");
+            node.defaultIndex = node.values.size() - 1;
+            node.captureDefault = true;
+        } else if (!def.isUInt() || def.asUInt() >= node.values.size()) {
+            *error = StringPrintf("Node \"%s\": \"DefaultIndex\" out of range", node.name.c_str());
+            return nullptr;
+        } else {
+            node.defaultIndex = def.asUInt();
+            node.captureDefault = false;
+        }
+        node.id = kInvalidNode;
+
+        if (obj.isMember("FallbackPath") && !GetString(obj, "FallbackPath", &fallback)) {
+            *error = StringPrintf("Node \"%s\": \"FallbackPath\" must be a non-empty string",
+                                  node.name.c_str());
+            return nullptr;
+        }
+        if (!fallback.empty() && access((root + path).c_str(), F_OK) != 0) {
+            ALOGI("%s: %s absent, using %s", node.name.c_str(), path.c_str(), fallback.c_str());
+            path = fallback;
+        }
+
+        profile->nodes.push_back(node);
+        paths.push_back(root + path);
+    }
+
+    const Json::Value& actions = doc["Actions"];
+    if (!actions.isArray()) {
+        *error = "\"Actions\" must be an array";
+        return nullptr;
+    }
+
+    for (Json::ArrayIndex i = 0; i < actions.size(); i++) {
+        const Json::Value& obj = actions[i];
+        std::string hintName, nodeName, value;
+
+        if (!GetString(obj, "PowerHint", &hintName) || !GetString(obj, "Node", &nodeName) ||
+            !obj.isMember("Value") || !obj["Value"].isString()) {
+            *error = StringPrintf("Actions[%u]: missing \"PowerHint\", \"Node\" or \"Value\"", i);
+            return nullptr;
+        }
+        value = obj["Value"].asString();
+        if (value.empty()) {
+            *error = StringPrintf("Actions[%u]: empty \"Value\"", i);
+            return nullptr;
+        }
+
+        int hint = FindHint(hintName);
+        if (hint < 0) {
+            *error = StringPrintf("Actions[%u]: unknown PowerHint \"%s\"", i, hintName.c_str());
+            return nullptr;
+        }
+
+        ProfileAction action;
+        int n = FindNode(*profile, nodeName);
+        if (n < 0) {
+            *error = StringPrintf("Actions[%u]: unknown node \"%s\"", i, nodeName.c_str());
+            return nullptr;
+        }
+        action.node = n;
+
+        const std::vector<std::string>& values = profile->nodes[n].values;
+        size_t v;
+        for (v = 0; v < values.size(); v++) {
+            if (values[v] == value)
+                break;
+        }
+        if (v == values.size()) {
+            *error = StringPrintf("Actions[%u]: value \"%s\" is not listed for node \"%s\"",
+                                  i, value.c_str(), nodeName.c_str());
+            return nullptr;
+        }
+        action.value = v;
+
+        const Json::Value& duration = obj["Duration"];
+        if (!duration.isNull() && !duration.isUInt()) {
+            *error = StringPrintf("Actions[%u]: \"Duration\" must be a non-negative integer", i);
+            return nullptr;
+        }
+        action.durationMs = duration.isNull() ? 0 : duration.asUInt();
+
+        for (const auto& other : profile->actions[hint]) {
+            if (other.node == action.node) {
+                *error = StringPrintf("Actions[%u]: %s already sets node \"%s\"",
+                                      i, hintName.c_str(), nodeName.c_str());
+                return nullptr;
+            }
+        }
+
+        profile->actions[hint].push_back(action);
+    }
+
+    if (doc.isMember("SustainedPerformance") &&
+        !ParseThermal(doc["SustainedPerformance"], root, profile.get(), error)) {
+        *error = "SustainedPerformance: " + *error;
+        return nullptr;
+    }
+
+    /* Only a fully validated profile gets to open its nodes */
+    for (size_t n = 0; n < profile->nodes.size(); n++)
+        profile->nodes[n].id = table.Add(paths[n]);
+
+    return profile;
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_0_POWERPROFILE_H
+#define ANDROID_HARDWARE_POWER_V1_0_POWERPROFILE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NodeTable.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+enum ProfileHint {
+    HINT_INTERACTION = 0,
+    HINT_LAUNCH,
+    HINT_LOW_POWER,
+    HINT_SUSTAINED_PERFORMANCE,
+    HINT_NON_INTERACTIVE,           /* held by setInteractive(false) */
+    HINT_COUNT,
+};
+
+struct ProfileNode {
+    std::string name;
+    NodeId id;
+    /* Ordered by priority: the lowest index requested by any active hint wins */
+    std::vector<std::string> values;
+    uint32_t defaultIndex;
+    /*
+     * Nodes without a "DefaultIndex" keep whatever init wrote to them: the
+     * current content is captured into values[defaultIndex] the first time
+     * a hint moves the node away from its default.
+     */
+    bool captureDefault;
+};
+
+struct ProfileAction {
+    uint16_t node;                  /* index into PowerProfile::nodes */
+    uint16_t value;                 /* index into ProfileNode::values */
+    uint32_t durationMs;            /* 0 holds the value until the hint ends */
+};
+
+/* Optional thermal control of the SUSTAINED_PERFORMANCE caps */
+struct ProfileThermal {
+    std::vector<std::string> zones;     /* thermal_zone temp files, hottest one is used */
+    std::vector<uint16_t> nodes;        /* nodes stepped down from their sustained value */
+    int32_t targetTemp;                 /* mC */
+    int32_t hysteresis;                 /* mC, half width of the dead band */
+    uint32_t periodMs;
+    uint32_t stepUpSamples;             /* cool samples required before raising the cap */
+    uint32_t maxStep;
+};
+
+/*
+ * Vendor power profile, e.g. /vendor/etc/powerhint.json:
+ *
+ * {
+ *   "Nodes": [
+ *     { "Name": "CPUBigClusterMinFreq",
+ *       "Path": "/sys/devices/system/cpu/cpufreq/policy4/scaling_min_freq",
+ *       "Values": [ "1800000", "1008000", "408000" ],
+ *       "DefaultIndex": 2 },
+ *     { "Name": "TopAppBoost", "Path": "/dev/stune/top-app/schedtune.boost",
+ *       "FallbackPath": "/dev/cpuctl/top-app/cpu.uclamp.min",
+ *       "Values": [ "50", "0" ], "DefaultIndex": 1 },
+ *     { "Name": "TopAppCpus", "Path": "/dev/cpuset/top-app/cpus",
+ *       "Values": [ "0-3" ] }
+ *   ],
+ *   "Actions": [
+ *     { "PowerHint": "LAUNCH", "Node": "CPUBigClusterMinFreq",
+ *       "Value": "1800000", "Duration": 5000 }
+ *   ],
+ *   "SustainedPerformance": {
+ *     "ThermalZones": [ "/sys/devices/virtual/thermal/thermal_zone0/temp" ],
+ *     "Nodes": [ "CPUBigClusterMaxFreq" ],
+ *     "TargetTemp": 75000, "Hysteresis": 3000,
+ *     "PeriodMs": 1000, "StepUpSamples": 10
+ *   }
+ * }
+ *
+ * A node whose "Path" does not exist is opened at its optional
+ * "FallbackPath" instead, e.g. uclamp.min on kernels without schedtune.
+ * An action's "Duration" is a default: a hint that carries its own, the
+ * INTERACTION boost length, runs timed actions for that long instead, up
+ * to HintManager::kMaxDurationMs.
+ *
+ * The file is parsed once into index-based tables, so dispatching a hint
+ * does not touch any strings.
+ */
+struct PowerProfile {
+    std::vector<ProfileNode> nodes;
+    std::vector<ProfileAction> actions[HINT_COUNT];
+    ProfileThermal thermal;
+
+    /* Returns nullptr and fills @error if the profile is malformed */
+    static std::unique_ptr<PowerProfile> Load(const std::string& path, const std::string& root,
+                                              NodeTable& table, std::string *error);
+    static std::unique_ptr<PowerProfile> Parse(const std::string& json, const std::string& root,
+                                               NodeTable& table, std::string *error);
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_0_POWERPROFILE_H
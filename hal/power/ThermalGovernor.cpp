@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PowerHAL"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ThermalGovernor.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+/* How far ahead, in samples, the temperature trend is projected */
+static constexpr int32_t kLookaheadSamples = 2;
+/* Samples to let the SoC react to a lowered cap before lowering it again */
+static constexpr uint32_t kSettleSamples = 2;
+
+ThermalGovernor::ThermalGovernor(const ProfileThermal& config)
+    : mConfig(config)
+{
+    Reset();
+}
+
+void ThermalGovernor::Reset()
+{
+    mStep = 0;
+    mCoolSamples = 0;
+    mSettleSamples = 0;
+    mLastTemp = 0;
+    mHaveLast = false;
+}
+
+uint32_t ThermalGovernor::Update(int32_t tempMilliC)
+{
+    const int32_t upper = mConfig.targetTemp + mConfig.hysteresis;
+    const int32_t lower = mConfig.targetTemp - mConfig.hysteresis;
+    const int32_t slope = mHaveLast ? tempMilliC - mLastTemp : 0;
+    const int32_t projected = tempMilliC + slope * kLookaheadSamples;
+
+    mLastTemp = tempMilliC;
+    mHaveLast = true;
+
+    if (mSettleSamples)
+        mSettleSamples--;
+
+    if (tempMilliC >= upper || projected >= upper) {
+        mCoolSamples = 0;
+        /* Give the last step time to act unless the SoC keeps heating up */
+        if (mStep < mConfig.maxStep && (mSettleSamples == 0 || slope > 0)) {
+            mStep++;
+            mSettleSamples = kSettleSamples;
+        }
+    } else if (tempMilliC <= lower && slope <= 0) {
+        if (mStep && ++mCoolSamples >= mConfig.stepUpSamples) {
+            mStep--;
+            mCoolSamples = 0;
+        }
+    } else {
+        mCoolSamples = 0;
+    }
+
+    return mStep;
+}
+
+SustainedPerfMode::SustainedPerfMode(HintManager& hints)
+    : mHints(hints),
+      mConfig(hints.GetProfile().thermal),
+      mGovernor(mConfig),
+      mRunning(false),
+      mExit(false)
+{
+    for (const auto& path : mConfig.zones) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ALOGE("%s: Error opening %s: %s", __func__, path.c_str(), strerror(errno));
+            continue;
+        }
+        mZoneFds.push_back(fd);
+    }
+
+    for (uint16_t node : mConfig.nodes) {
+        for (const auto& action : hints.GetProfile().actions[HINT_SUSTAINED_PERFORMANCE]) {
+            if (action.node == node)
+                mCaps.emplace_back(node, action.value);
+        }
+    }
+
+    if (!mZoneFds.empty() && !mCaps.empty())
+        mThread = std::thread(&SustainedPerfMode::ThreadLoop, this);
+}
+
+SustainedPerfMode::~SustainedPerfMode()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExit = true;
+    }
+    mCond.notify_one();
+    if (mThread.joinable())
+        mThread.join();
+
+    for (int fd : mZoneFds)
+        close(fd);
+}
+
+void SustainedPerfMode::Start()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+
+    if (mRunning)
+        return;
+
+    mGovernor.Reset();
+    mRunning = true;
+    mCond.notify_one();
+}
+
+void SustainedPerfMode::Stop()
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mRunning = false;
+}
+
+void SustainedPerfMode::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(mLock);
+
+    while (!mExit) {
+        if (!mRunning) {
+            mCond.wait(lock);
+            continue;
+        }
+
+        int32_t temp;
+        if (ReadTemp(&temp)) {
+            uint32_t step = mGovernor.GetStep();
+            if (mGovernor.Update(temp) != step) {
+                ALOGI("%s: %d mC, throttle step %u", __func__, temp, mGovernor.GetStep());
+                ApplyStep(mGovernor.GetStep());
+            }
+        }
+
+        mCond.wait_for(lock, std::chrono::milliseconds(mConfig.periodMs));
+    }
+}
+
+bool SustainedPerfMode::ReadTemp(int32_t *tempMilliC)
+{
+    bool valid = false;
+    char buf[16];
+
+    for (int fd : mZoneFds) {
+        ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (len <= 0)
+            continue;
+        buf[len] = '\0';
+
+        int32_t temp = strtol(buf, nullptr, 10);
+        if (!valid || temp > *tempMilliC)
+            *tempMilliC = temp;
+        valid = true;
+    }
+
+    return valid;
+}
+
+void SustainedPerfMode::ApplyStep(uint32_t step)
+{
+    for (const auto& cap : mCaps) {
+        uint16_t value = cap.second > step ? cap.second - step : 0;
+        mHints.SetHintValue(HINT_SUSTAINED_PERFORMANCE, cap.first, value);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
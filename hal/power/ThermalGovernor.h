@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_POWER_V1_0_THERMALGOVERNOR_H
+#define ANDROID_HARDWARE_POWER_V1_0_THERMALGOVERNOR_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "HintManager.h"
+#include "PowerProfile.h"
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_0 {
+namespace implementation {
+
+/*
+ * Throttle step controller for SUSTAINED_PERFORMANCE. Step 0 is the
+ * profile's sustained cap, every further step lowers the capped nodes by
+ * one OPP. The controller steps down as soon as the temperature (or its
+ * short-term projection) crosses the upper band, but only steps back up
+ * after the SoC has stayed below the lower band for a while, so the caps
+ * settle instead of oscillating with the A72 trip points.
+ *
+ * Update() is a pure function of the sample sequence, which makes the
+ * controller easy to drive from a synthetic temperature trace.
+ */
+class ThermalGovernor
+{
+public:
+    explicit ThermalGovernor(const ProfileThermal& config);
+
+    void Reset();
+    uint32_t Update(int32_t tempMilliC);
+    uint32_t GetStep() const { return mStep; }
+
+private:
+    const ProfileThermal& mConfig;
+    uint32_t mStep;
+    uint32_t mCoolSamples;
+    uint32_t mSettleSamples;
+    int32_t mLastTemp;
+    bool mHaveLast;
+};
+
+/*
+ * Runs the ThermalGovernor on a background thread while
+ * SUSTAINED_PERFORMANCE is active and feeds its step into HintManager
+ * as the value of the SUSTAINED_PERFORMANCE requests.
+ */
+class SustainedPerfMode
+{
+public:
+    explicit SustainedPerfMode(HintManager& hints);
+    ~SustainedPerfMode();
+
+    void Start();
+    void Stop();
+
+private:
+    void ThreadLoop();
+    bool ReadTemp(int32_t *tempMilliC);
+    void ApplyStep(uint32_t step);
+
+    HintManager& mHints;
+    const ProfileThermal& mConfig;
+    ThermalGovernor mGovernor;
+    std::vector<int> mZoneFds;
+    /* (node, SUSTAINED_PERFORMANCE value) pairs that are stepped down */
+    std::vector<std::pair<uint16_t, uint16_t>> mCaps;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mRunning;
+    bool mExit;
+    std::thread mThread;
+};
+
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_POWER_V1_0_THERMALGOVERNOR_H
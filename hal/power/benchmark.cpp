@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hint-to-sysfs latency of the power HAL, measured in process against
+ * the nodes of a power profile:
+ *
+ *   android.hardware.power@1.0-benchmark.rockchip [-n count] [-p profile] [-r root]
+ *
+ * Every node of @profile is written @count times through the old
+ * open/write/close path and through NodeTable, once with a changing and
+ * once with a repeated value, then the INTERACTION and LAUNCH actions
+ * are timed through HintManager from hint to the last node written.
+ * Nodes are resolved against @root, by default a scratch tree under
+ * /data/local/tmp that is created to match the profile; pass -r / as
+ * root to drive the live nodes instead.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "BenchUtil.h"
+#include "HintManager.h"
+#include "NodeTable.h"
+#include "PowerProfile.h"
+
+using namespace android::hardware::power::V1_0::implementation;
+using namespace android::hardware::rockchip;
+
+/* The write path every hint took before NodeTable */
+static bool LegacyWrite(const std::string& path, const char *val)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    bool ok = write(fd, val, strlen(val)) >= 0;
+    close(fd);
+    return ok;
+}
+
+/* Creates every node of @json under the scratch root, holding its default */
+static bool CreateTree(const std::string& json, const std::string& root)
+{
+    NodeTable scratch;
+    std::string error;
+
+    /* Parsing resolves fallbacks and paths; opening in the scratch table fails harmlessly */
+    std::unique_ptr<PowerProfile> profile = PowerProfile::Parse(json, root, scratch, &error);
+    if (profile == nullptr) {
+        fprintf(stderr, "profile rejected: %s\n", error.c_str());
+        return false;
+    }
+
+    for (const auto& node : profile->nodes) {
+        const std::string& path = scratch.GetPath(node.id);
+        const std::string& val = node.values[node.captureDefault ? 0 : node.defaultIndex];
+        if (!WriteScratchFile(path, val + "\n")) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void BenchWrites(const PowerProfile& profile, NodeTable& table, unsigned count)
+{
+    std::vector<double> legacy_us, changed_us, repeated_us;
+
+    for (const auto& node : profile.nodes) {
+        const std::string& path = table.GetPath(node.id);
+        const std::string& a = node.values.front();
+        /* Nodes that capture their default hold a placeholder there */
+        const std::string& b = node.captureDefault ? a : node.values[node.defaultIndex];
+
+        for (unsigned i = 0; i < count; i++) {
+            const std::string& val = (i & 1) ? a : b;
+            legacy_us.push_back(TimeUs([&] { LegacyWrite(path, val.c_str()); }));
+        }
+        /* Single-value nodes only ever see a repeated value */
+        for (unsigned i = 0; a != b && i < count; i++) {
+            const std::string& val = (i & 1) ? a : b;
+            changed_us.push_back(TimeUs([&] { table.Write(node.id, val); }));
+        }
+        for (unsigned i = 0; i < count; i++)
+            repeated_us.push_back(TimeUs([&] { table.Write(node.id, a); }));
+    }
+
+    Report("open/write/close", legacy_us, "us");
+    Report("pwrite, changed value", changed_us, "us");
+    Report("pwrite, repeated value", repeated_us, "us");
+}
+
+static void BenchHints(HintManager& hints, unsigned count)
+{
+    static const struct {
+        const char *name;
+        ProfileHint hint;
+    } kHints[] = {
+        { "INTERACTION", HINT_INTERACTION },
+        { "LAUNCH", HINT_LAUNCH },
+    };
+
+    for (const auto& h : kHints) {
+        if (hints.GetProfile().actions[h.hint].empty())
+            continue;
+
+        std::vector<double> on_us, off_us;
+        for (unsigned i = 0; i < count; i++) {
+            on_us.push_back(TimeUs([&] { hints.DoHint(h.hint, 0); }));
+            off_us.push_back(TimeUs([&] { hints.EndHint(h.hint); }));
+        }
+
+        std::string name = std::string(h.name) + " on";
+        Report(name.c_str(), on_us, "us");
+        name = std::string(h.name) + " off";
+        Report(name.c_str(), off_us, "us");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned count = 1000;
+    std::string profile_path = "/vendor/etc/powerhint.json";
+    const std::string scratch = ScratchRoot("power_benchmark");
+    std::string root = scratch;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:r:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = strtoul(optarg, nullptr, 10);
+            break;
+        case 'p':
+            profile_path = optarg;
+            break;
+        case 'r':
+            root = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n count] [-p profile] [-r root]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (count == 0)
+        count = 1;
+    if (root == "/")
+        root.clear();
+
+    std::string json;
+    if (!android::base::ReadFileToString(profile_path, &json)) {
+        fprintf(stderr, "%s: %s\n", profile_path.c_str(), strerror(errno));
+        return 1;
+    }
+
+    if (root == scratch && !CreateTree(json, root))
+        return 1;
+
+    NodeTable table;
+    std::string error;
+    std::unique_ptr<PowerProfile> profile = PowerProfile::Parse(json, root, table, &error);
+    if (profile == nullptr) {
+        fprintf(stderr, "profile rejected: %s\n", error.c_str());
+        return 1;
+    }
+
+    printf("%zu nodes under %s\n", profile->nodes.size(), root.empty() ? "/" : root.c_str());
+    BenchWrites(*profile, table, count);
+
+    HintManager hints(table, std::move(profile));
+    BenchHints(hints, count);
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ThermalGovernor driven by synthetic temperature traces:
+ *
+ *   android.hardware.power@1.0-thermal-trace-test.rockchip [-v]
+ *
+ * The governor runs with the thermal settings of powerhint.json and four
+ * steps. Each trace is fed one sample per period and the step after
+ * every sample is checked:
+ *
+ *   step       a jump over the upper band throttles at once, and a held
+ *              overshoot walks down to the last step, one step per
+ *              settle period, never past it
+ *   ramp       a steady climb throttles before it reaches the upper band
+ *   hysteresis an oscillation inside the dead band leaves the step alone,
+ *              and one across both bands never raises the cap
+ *   recovery   cooling raises the cap one step per StepUpSamples samples
+ *              only below the lower band, back to step 0
+ *
+ * -v prints every sample. Exits non-zero on any violation.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "ThermalGovernor.h"
+
+using namespace android::hardware::power::V1_0::implementation;
+
+static constexpr int32_t kTargetTemp = 75000;
+static constexpr int32_t kHysteresis = 3000;
+static constexpr int32_t kUpper = kTargetTemp + kHysteresis;
+static constexpr int32_t kLower = kTargetTemp - kHysteresis;
+static constexpr uint32_t kStepUpSamples = 10;
+static constexpr uint32_t kMaxStep = 4;
+static constexpr int32_t kCool = 60000;
+static constexpr int32_t kHot = 82000;
+
+static bool verbose = false;
+
+static ProfileThermal Config()
+{
+    ProfileThermal config;
+
+    config.targetTemp = kTargetTemp;
+    config.hysteresis = kHysteresis;
+    config.periodMs = 1000;
+    config.stepUpSamples = kStepUpSamples;
+    config.maxStep = kMaxStep;
+    return config;
+}
+
+/* Feeds @trace and returns the step after every sample */
+static std::vector<uint32_t> Run(ThermalGovernor& governor, const char *name,
+                                 const std::vector<int32_t>& trace)
+{
+    std::vector<uint32_t> steps;
+
+    for (int32_t temp : trace) {
+        steps.push_back(governor.Update(temp));
+        if (verbose)
+            printf("%-10s %3zu: %6d mC, step %u\n", name, steps.size() - 1, temp, steps.back());
+    }
+    return steps;
+}
+
+static void Hold(std::vector<int32_t> *trace, int32_t temp, size_t samples)
+{
+    trace->insert(trace->end(), samples, temp);
+}
+
+static void Ramp(std::vector<int32_t> *trace, int32_t from, int32_t to, int32_t delta)
+{
+    for (int32_t temp = from; delta > 0 ? temp <= to : temp >= to; temp += delta)
+        trace->push_back(temp);
+}
+
+static bool Check(bool ok, const char *trace, const char *what)
+{
+    printf("%-10s %s: %s\n", trace, what, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static unsigned TestStep(ThermalGovernor& governor)
+{
+    std::vector<int32_t> trace;
+    Hold(&trace, kCool, 10);
+    Hold(&trace, kHot, 30);
+
+    governor.Reset();
+    std::vector<uint32_t> steps = Run(governor, "step", trace);
+
+    bool quiet = true, monotonic = true, paced = true;
+    size_t last_change = 10;
+    for (size_t i = 0; i < steps.size(); i++) {
+        if (i < 10)
+            quiet &= steps[i] == 0;
+        if (i > 10 && steps[i] != steps[i - 1]) {
+            monotonic &= steps[i] == steps[i - 1] + 1;
+            /* Flat temperature: every step waits for the previous one to act */
+            paced &= i - last_change > 1;
+            last_change = i;
+        }
+    }
+
+    unsigned errors = 0;
+    errors += !Check(quiet, "step", "no throttling while cool");
+    errors += !Check(steps[10] == 1, "step", "first hot sample throttles");
+    errors += !Check(monotonic && paced, "step", "one step per settle period");
+    errors += !Check(steps.back() == kMaxStep, "step", "held overshoot ends at the last step");
+    return errors;
+}
+
+static unsigned TestRamp(ThermalGovernor& governor)
+{
+    std::vector<int32_t> trace;
+    Ramp(&trace, kCool, kHot, 500);
+
+    governor.Reset();
+    std::vector<uint32_t> steps = Run(governor, "ramp", trace);
+
+    size_t first = 0;
+    while (first < steps.size() && steps[first] == 0)
+        first++;
+
+    unsigned errors = 0;
+    errors += !Check(first < steps.size() && trace[first] < kUpper, "ramp",
+                     "throttles before the upper band");
+    errors += !Check(first < steps.size() && trace[first] > kTargetTemp, "ramp",
+                     "but not before the target");
+    return errors;
+}
+
+static unsigned TestHysteresis(ThermalGovernor& governor)
+{
+    unsigned errors = 0;
+
+    /* Throttle a little first, so both directions can be seen */
+    std::vector<int32_t> heat;
+    Hold(&heat, kHot, 3);
+    governor.Reset();
+    uint32_t start = Run(governor, "hysteresis", heat).back();
+
+    /* Slow enough that the projection stays inside the band as well */
+    std::vector<int32_t> inside;
+    for (int i = 0; i < 100; i++)
+        inside.push_back(kTargetTemp + lround(kHysteresis / 2 * sin(2 * M_PI * i / 20)));
+
+    bool steady = true;
+    for (uint32_t step : Run(governor, "hysteresis", inside))
+        steady &= step == start;
+    errors += !Check(start > 0 && steady, "hysteresis", "dead band oscillation keeps the step");
+
+    /* Swinging over both bands every sample: never cool for StepUpSamples in a row */
+    std::vector<int32_t> across;
+    for (int i = 0; i < 100; i++)
+        across.push_back(i % 2 ? kLower - 2000 : kUpper + 1000);
+
+    bool raised = false;
+    uint32_t last = governor.GetStep();
+    for (uint32_t step : Run(governor, "hysteresis", across)) {
+        raised |= step < last;
+        last = step;
+    }
+    errors += !Check(!raised, "hysteresis", "oscillation over both bands never raises the cap");
+    return errors;
+}
+
+static unsigned TestRecovery(ThermalGovernor& governor)
+{
+    std::vector<int32_t> trace;
+    Hold(&trace, kHot, 30);
+    const size_t cool = trace.size();
+    /* Into the dead band first: below the target is not yet cool */
+    Ramp(&trace, kHot, kLower + 500, -500);
+    const size_t below = trace.size();
+    Hold(&trace, kCool, kMaxStep * kStepUpSamples + 10);
+
+    governor.Reset();
+    std::vector<uint32_t> steps = Run(governor, "recovery", trace);
+
+    bool held = true, spaced = true;
+    for (size_t i = cool; i < below; i++)
+        held &= steps[i] == kMaxStep;
+
+    std::vector<size_t> raises;
+    for (size_t i = below; i < steps.size(); i++) {
+        if (steps[i] < steps[i - 1]) {
+            spaced &= steps[i] == steps[i - 1] - 1;
+            raises.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < raises.size(); i++) {
+        size_t since = i ? raises[i] - raises[i - 1] : raises[i] - below + 1;
+        spaced &= since == kStepUpSamples;
+    }
+
+    unsigned errors = 0;
+    errors += !Check(steps[cool - 1] == kMaxStep && held, "recovery",
+                     "no raise above the lower band");
+    errors += !Check(raises.size() == kMaxStep && spaced, "recovery",
+                     "one raise per StepUpSamples cool samples");
+    errors += !Check(steps.back() == 0, "recovery", "back to step 0");
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* The governor keeps a reference to its config */
+    const ProfileThermal config = Config();
+    ThermalGovernor governor(config);
+
+    unsigned errors = TestStep(governor);
+    errors += TestRamp(governor);
+    errors += TestHysteresis(governor);
+    errors += TestRecovery(governor);
+
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+    return errors == 0 ? 0 : 1;
+}